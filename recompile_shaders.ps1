@@ -1,4 +1,11 @@
 glslc src/shader/text.vert -o text-vert.spv
 glslc src/shader/text.frag -o text-frag.spv
+glslc src/shader/text_bindless.vert -o text-bindless-vert.spv
+glslc src/shader/text_bindless.frag -o text-bindless-frag.spv
 glslc src/shader/model.vert -o model-vert.spv
 glslc src/shader/model.frag -o model-frag.spv
+glslc src/shader/model_instanced.vert -o model-instanced-vert.spv
+glslc src/shader/model_push.vert -o model-push-vert.spv
+glslc src/shader/overdraw.frag -o overdraw-frag.spv
+glslc src/shader/hiz_reduce.comp -o hiz-reduce-comp.spv
+glslc src/shader/occlusion_cull.comp -o occlusion-cull-comp.spv
@@ -4,6 +4,7 @@
 #include "geometry/model.h"
 #include "gpu/buffer.h"
 #include "gpu/descriptor_pool.h"
+#include "math/frustum.h"
 #include "math/mat4.h"
 #include "mesh.h"
 #include "renderer.h"
@@ -11,9 +12,15 @@
 #include "ui/ui.h"
 #include "ui/widget.h"
 #include "util/assert.h"
+#include "util/trace.h"
 #include "window/keys.h" // IWYU pragma: export
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <exception>
 #include <fstream>
+#include <iostream>
+#include <numeric>
 #include <stdexcept>
 #include <string>
 
@@ -24,51 +31,68 @@ enum class vkad::State {
    CREATE_POLYGON_DEGREE,
    CREATE_POLYGON_RADIUS,
    EXTRUDE,
+   REPEAT,
 };
 
-App::App()
+App::App(
+    int frames_in_flight, bool visualize_overdraw, bool profile_gpu, bool late_latch_camera,
+    PresentProfile present_profile, bool gpu_cull
+)
     : vk_instance_(Window::vulkan_extensions()),
       window_(vk_instance_, "vkad"),
-      renderer_(vk_instance_, window_.surface(), window_.width(), window_.height()),
+      renderer_(
+          vk_instance_, window_.surface(), window_.width(), window_.height(), frames_in_flight,
+          visualize_overdraw, present_profile
+      ),
       last_width_(window_.width()),
       last_height_(window_.height()),
       was_left_clicking_(false),
       last_frame_time_(Clock::now()),
+      input_time_(std::chrono::steady_clock::now()),
+      camera_input_time_(input_time_),
+      held_mouse_x_(0),
+      held_mouse_y_(0),
       delta_(0),
       player_(*this),
       state_(State::STANDBY),
 
-      font_("res/arial.ttf", 64, renderer_.physical_device(), renderer_.device().handle()),
-      ui_uniforms_(renderer_.create_uniform_buffer<UiUniform>(3)),
-      ui_material_(renderer_.create_material<UiVertex>(
-          {"text-vert.spv", "text-frag.spv"},
-          {
-              DescriptorPool::uniform_buffer_dynamic(0),
-              DescriptorPool::combined_image_sampler(1),
-          }
-      )),
+      font_("res/arial.ttf", 64, renderer_.allocator()),
+      ui_material_(create_ui_material()),
+      gpu_overlay_countdown_(0),
+      font_texture_(0),
 
-      model_uniforms_(renderer_.create_uniform_buffer<ModelVertex>(1)),
       model_material_(renderer_.create_material<ModelVertex>(
-          {"model-vert.spv", "model-frag.spv"}, {DescriptorPool::uniform_buffer_dynamic(0)}
-      )) {
+          {"model-vert.spv", "model-frag.spv"}, {DescriptorPool::uniform_buffer_dynamic(0)},
+          kOpaqueOptions
+      )),
+      model_arena_(renderer_.create_geometry_arena<ModelVertex>(
+          kModelArenaVertices, kModelArenaIndices
+      )),
+      instanced_model_material_(renderer_.create_instanced_material<ModelVertex, ModelInstance>(
+          {"model-instanced-vert.spv", "model-frag.spv"},
+          {DescriptorPool::uniform_buffer_dynamic(0)}, kOpaqueOptions
+      )),
+      model_instances_(-1),
+      model_uniform_offset_(0),
+      gpu_cull_(gpu_cull) {
 
    renderer_.init_image(font_.image(), font_.image_data(), Font::kBitmapWidth * Font::kBitmapWidth);
 
-   renderer_.link_material(
-       ui_material_,
-       {
-           DescriptorPool::write_uniform_buffer_dynamic(ui_uniforms_),
-           DescriptorPool::write_combined_image_sampler(renderer_.image_sampler(), font_.image()),
-       }
-   );
-
-   renderer_.link_material(
-       model_material_,
-       {
-           DescriptorPool::write_uniform_buffer_dynamic(model_uniforms_),
-       }
-   );
+   if (renderer_.bindless()) {
+      font_texture_ = renderer_.add_bindless_image(font_.image());
+   } else {
+      renderer_.link_material(
+          ui_material_,
+          {
+              DescriptorPool::write_combined_image_sampler(
+                  renderer_.image_sampler(), font_.image()
+              ),
+          }
+      );
+      renderer_.link_uniform_ring<UiUniform>(ui_material_);
+   }
+   renderer_.link_uniform_ring<ModelUniform>(model_material_);
+   renderer_.link_uniform_ring<ModelUniform>(instanced_model_material_);
 
    if (FMOD_System_Create(&sound_system_, FMOD_VERSION) != FMOD_OK) {
       throw std::runtime_error("failed to create sound system");
@@ -85,15 +109,21 @@ App::App()
 
    window_.set_capture_mouse(true);
 
-   Mat4 mvp = perspective_matrix() * player_.view_matrix();
-   UiUniform u = {mvp, Vec3(1.0, 1.0, 1.0)};
-   ui_uniforms_.upload_memory(&u, sizeof(UiUniform), 0);
-
-   Widget text = font_.create_text("C - Create polygon\nE - Extrude\nP - Export");
+   Widget text = font_.create_text("C - Create polygon\nE - Extrude\nR - Repeat\nP - Export");
    text.set_position(30, 100);
    text.set_size(35);
    renderer_.init_mesh<UiVertex>(text);
    text_meshes_.emplace_back(std::move(text));
+
+   if (profile_gpu && !renderer_.enable_gpu_profiler()) {
+      std::cerr << "GPU profiling is not supported, the graphics queue has no timestamps\n";
+   }
+
+   renderer_.set_refresh_rate(static_cast<float>(window_.refresh_rate()));
+
+   if (late_latch_camera) {
+      renderer_.set_camera_source([this] { return sample_camera(); });
+   }
 }
 
 App::~App() {
@@ -101,36 +131,226 @@ App::~App() {
 }
 
 bool App::poll() {
-   last_width_ = window_.width();
-   last_height_ = window_.height();
+   VKAD_TRACE_FRAME();
+   VKAD_TRACE_ZONE("App::poll");
 
-   if (!window_.poll()) {
-      return false;
+   {
+      VKAD_TRACE_ZONE("input");
+      last_width_ = window_.width();
+      last_height_ = window_.height();
+
+      if (!window_.poll()) {
+         return false;
+      }
+      input_time_ = std::chrono::steady_clock::now();
+
+      bool window_resized = last_width_ != window_.width() || last_height_ != window_.height();
+      if (window_resized) {
+         handle_resize();
+      }
+
+      if (window_.is_key_down(VKAD_KEY_ESC)) {
+         window_.request_close();
+      }
+   }
+
+   update_state();
+
+   Clock::time_point now = Clock::now();
+   delta_ = now - last_frame_time_;
+   last_frame_time_ = now;
+
+   was_left_clicking_ = left_clicking();
+
+   {
+      VKAD_TRACE_ZONE("FMOD_System_Update");
+      if (FMOD_System_Update(sound_system_) != FMOD_OK) {
+         throw std::runtime_error("failed to poll fmod system");
+      }
    }
 
-   bool window_resized = last_width_ != window_.width() || last_height_ != window_.height();
-   if (window_resized) {
-      handle_resize();
+   renderer_.begin_frame();
+
+   update_gpu_overlay();
+   ui_widgets_.clear();
+   for (const Widget &text : text_meshes_) {
+      ui_widgets_.push_back(&text);
+   }
+   if (gpu_overlay_.has_value()) {
+      ui_widgets_.push_back(&*gpu_overlay_);
+   }
+
+   write_uniforms();
+   if (!renderer_.late_latching()) {
+      renderer_.set_input_time(camera_input_time_);
+   }
+
+   player_.update(delta_.count());
+   camera_input_time_ = input_time_;
+
+   // The uniforms were written with last frame's camera, and a late latched frame replaces the
+   // model matrix with the camera as of submission. The CPU culls with a frustum wide enough for
+   // any turn until then, the GPU culls with the camera as of submission. The front to back order
+   // only depends on the player's position, which the late latched camera doesn't move.
+   if (renderer_.late_latching()) {
+      model_view_proj_ = perspective_matrix() * player_.view_matrix();
+      model_cull_view_proj_ = late_latch_cull_matrix() * player_.view_matrix();
+      renderer_.late_latch(model_uniform_offset_ + offsetof(ModelUniform, mvp));
+   } else {
+      model_cull_view_proj_ = model_view_proj_;
+   }
+
+   return true;
+}
+
+CameraSample App::sample_camera() {
+   // Only the mouse turns the camera again. The movement keys move the player by the frame's whole
+   // delta, so applying them here as well would move it twice.
+   int seen_x = window_.delta_mouse_x();
+   int seen_y = window_.delta_mouse_y();
+   window_.poll_mouse();
+   camera_input_time_ = std::chrono::steady_clock::now();
+
+   // The frame was culled for turns of up to kMaxLateTurn, the rest of the movement waits. look()
+   // turns by half a radian per unit of movement and second.
+   int max_move = delta() > 0 ? static_cast<int>(2 * kMaxLateTurn / delta()) : 0;
+   int move_x = window_.delta_mouse_x() - seen_x + held_mouse_x_;
+   int move_y = window_.delta_mouse_y() - seen_y + held_mouse_y_;
+   int turn_x = std::clamp(move_x, -max_move, max_move);
+   int turn_y = std::clamp(move_y, -max_move, max_move);
+   held_mouse_x_ = move_x - turn_x;
+   held_mouse_y_ = move_y - turn_y;
+   player_.look(turn_x, turn_y, delta());
+
+   return CameraSample{
+       .view_proj = perspective_matrix() * player_.view_matrix(),
+       .input_time = camera_input_time_,
+   };
+}
+
+Mat4 App::late_latch_cull_matrix() const {
+   float aspect = static_cast<float>(window_.height()) / static_cast<float>(window_.width());
+   float half_fov_y = deg_to_rad(kFovDegrees) / 2;
+   float half_fov_x = atanf(tanf(half_fov_y) / aspect);
+
+   // Turning around both axes rotates the view by at most the sum of the turns. The corners of the
+   // frustum are the directions closest to the sides of a wider frustum: widening a side by m
+   // leaves a corner sin(m) / (cos(half fov) * corner length) away, as a sine of the angle. Each
+   // side is widened until that is at least the sine of the largest rotation.
+   auto corner_length = [](float half_x, float half_y) {
+      return sqrtf(1 + tanf(half_x) * tanf(half_x) + tanf(half_y) * tanf(half_y));
+   };
+   float reach = sinf(2 * kMaxLateTurn) * corner_length(half_fov_x, half_fov_y);
+   auto widen = [reach](float half_fov) {
+      return std::min(half_fov + asinf(std::min(reach * cosf(half_fov), 1.0f)), deg_to_rad(89));
+   };
+   float wide_x = widen(half_fov_x);
+   float wide_y = widen(half_fov_y);
+
+   // Points of the frustum are at most kFarPlane times the corner length away from the camera, and
+   // after turning their depth is at least their distance over the widened corner length
+   return Mat4::perspective(
+       tanf(wide_y) / tanf(wide_x), 2 * wide_y, kNearPlane / corner_length(wide_x, wide_y),
+       kFarPlane * corner_length(half_fov_x, half_fov_y)
+   );
+}
+
+void App::draw() {
+   VKAD_TRACE_ZONE("App::draw");
+   bool did_begin = renderer_.begin_draw();
+
+   if (!did_begin) {
+      renderer_.recreate_swapchain(window_.width(), window_.height(), window_.surface());
+
+      VKAD_ASSERT(
+          renderer_.begin_draw(), "failed to acquire next image after recreating swapchain"
+      );
+   }
+
+   renderer_.set_material(model_material_);
+   renderer_.set_uniform(model_material_, model_uniform_offset_);
+
+   // Only models inside the view frustum are drawn, front to back so the depth test rejects hidden
+   // fragments before they are shaded. The GPU culls from the sorted list of every model.
+   {
+      VKAD_TRACE_ZONE("cull and sort models");
+      Vec3 eye = player_.pos();
+      if (gpu_cull_) {
+         visible_models_.resize(models_.size());
+         std::iota(visible_models_.begin(), visible_models_.end(), 0);
+      } else {
+         model_bounds_.cull(Frustum::from_matrix(model_cull_view_proj_), visible_models_);
+      }
+      model_order_.resize(visible_models_.size());
+      for (int i = 0; i < visible_models_.size(); ++i) {
+         const Model &model = models_[visible_models_[i]];
+         Vec3 to_model = model.bounds().sphere.center - eye;
+         model_order_[i] = {.distance = to_model.dot(to_model), .mesh_id = model.id()};
+      }
+      std::sort(model_order_.begin(), model_order_.end(), [](const auto &a, const auto &b) {
+         return a.distance < b.distance;
+      });
+   }
+
+   std::vector<int> model_ids;
+   model_ids.reserve(model_order_.size());
+   for (const auto &entry : model_order_) {
+      model_ids.push_back(entry.mesh_id);
+   }
+   if (gpu_cull_) {
+      renderer_.draw_culled(model_ids, model_view_proj_);
+   } else {
+      renderer_.draw_indirect(model_ids);
    }
 
-   if (window_.is_key_down(VKAD_KEY_ESC)) {
-      window_.request_close();
+   if (model_instances_ != -1) {
+      renderer_.set_material(instanced_model_material_);
+      renderer_.set_uniform(instanced_model_material_, model_uniform_offset_);
+      renderer_.draw_instanced(models_.back().id(), model_instances_);
    }
 
+   if (renderer_.bindless()) {
+      // Text is the last thing drawn, so it can skip the render queue's layers
+      renderer_.set_material(ui_material_);
+      for (int i = 0; i < ui_widgets_.size(); ++i) {
+         renderer_.push_constants(ui_material_, ui_push_constants_[i]);
+         renderer_.draw(ui_widgets_[i]->id());
+      }
+   } else {
+      for (int i = 0; i < ui_widgets_.size(); ++i) {
+         DrawItem item = {
+             .material_id = ui_material_,
+             .uniform_offset = ui_uniform_offsets_[i],
+             .mesh_id = ui_widgets_[i]->id(),
+         };
+         renderer_.submit(item, 0, kUiLayer);
+      }
+      renderer_.draw_queue();
+   }
+
+   renderer_.end_draw();
+}
+
+void App::update_state() {
+   VKAD_TRACE_ZONE("state machine");
+
    switch (state_) {
    case State::STANDBY:
       if (window_.key_just_pressed(VKAD_KEY_C)) {
          state_ = State::CREATE_POLYGON_DEGREE;
-         add_prompt_text("Enter number of sides: ");
+         set_prompt_text("Enter number of sides: ");
       } else if (window_.key_just_pressed(VKAD_KEY_E)) {
          state_ = State::EXTRUDE;
-         add_prompt_text("Extrude: ");
+         set_prompt_text("Extrude: ");
+      } else if (window_.key_just_pressed(VKAD_KEY_R) && !models_.empty()) {
+         state_ = State::REPEAT;
+         set_prompt_text("Number of copies: ");
       } else if (window_.key_just_pressed(VKAD_KEY_P)) {
          std::vector<Triangle> tris = models_[0].to_stl_triangles();
          std::ofstream file("model.stl");
          write_stl("model", tris, file);
          export_sfx_.value().play();
-         add_prompt_text("Model saved.");
+         set_prompt_text("Model saved.");
       }
       break;
 
@@ -145,7 +365,7 @@ bool App::poll() {
             }
 
             state_ = State::CREATE_POLYGON_RADIUS;
-            add_prompt_text("Enter radius: ");
+            set_prompt_text("Enter radius: ");
          } catch (const std::exception &e) {
             state_ = State::STANDBY;
          }
@@ -167,8 +387,8 @@ bool App::poll() {
             Circle circle(create_radius_, create_sides_);
             shapes_.push_back(circle);
             Model mesh = circle.to_model();
-            renderer_.init_mesh(mesh);
-            models_.emplace_back(std::move(mesh));
+            renderer_.init_mesh(mesh, model_arena_);
+            add_model(std::move(mesh));
             create_sfx_.value().play();
          } catch (const std::exception &e) {
             state_ = State::STANDBY;
@@ -192,11 +412,13 @@ bool App::poll() {
                renderer_.delete_mesh(model);
             }
             models_.clear();
+            model_bounds_.clear();
+            clear_instances();
 
             Shape &shape = shapes_.back();
             Model mesh = shape.extrude(extrude_amount_);
-            renderer_.init_mesh(mesh);
-            models_.emplace_back(std::move(mesh));
+            renderer_.init_mesh(mesh, model_arena_);
+            add_model(std::move(mesh));
             shapes_.clear();
             extrude_sfx_.value().play();
          } catch (const std::exception &e) {
@@ -204,64 +426,73 @@ bool App::poll() {
          }
       }
       break;
-   }
 
-   Clock::time_point now = Clock::now();
-   delta_ = now - last_frame_time_;
-   last_frame_time_ = now;
+   case State::REPEAT:
+      if (process_input("Number of copies: ")) {
+         try {
+            repeat_count_ = std::stoi(input_);
+            input_.clear();
 
-   was_left_clicking_ = left_clicking();
+            if (repeat_count_ < 1) {
+               throw std::runtime_error("need at least 1 copy");
+            }
 
-   if (FMOD_System_Update(sound_system_) != FMOD_OK) {
-      throw std::runtime_error("failed to poll fmod system");
+            state_ = State::STANDBY;
+            repeat_last_model();
+            create_sfx_.value().play();
+         } catch (const std::exception &e) {
+            state_ = State::STANDBY;
+         }
+      }
+      break;
    }
+}
 
-   for (int i = 0; i < text_meshes_.size(); ++i) {
-      UiUniform u = {
-          .mvp = ortho_matrix() * text_meshes_[i].model_matrix(),
-          .color = Vec3(1.0, 1.0, 1.0),
-      };
-      ui_uniforms_.upload_memory(&u, sizeof(UiUniform), i);
+void App::write_uniforms() {
+   VKAD_TRACE_ZONE("uniform uploads");
+
+   if (renderer_.bindless()) {
+      ui_push_constants_.resize(ui_widgets_.size());
+      for (int i = 0; i < ui_widgets_.size(); ++i) {
+         ui_push_constants_[i] = {
+             .mvp = ortho_matrix() * ui_widgets_[i]->model_matrix(),
+             .color = Vec3(1.0, 1.0, 1.0),
+             .texture_index = font_texture_,
+         };
+      }
+   } else {
+      ui_uniform_offsets_.resize(ui_widgets_.size());
+      for (int i = 0; i < ui_widgets_.size(); ++i) {
+         UiUniform u = {
+             .mvp = ortho_matrix() * ui_widgets_[i]->model_matrix(),
+             .color = Vec3(1.0, 1.0, 1.0),
+         };
+         ui_uniform_offsets_[i] = renderer_.write_uniform(u);
+      }
    }
 
+   model_view_proj_ = perspective_matrix() * player_.view_matrix();
    ModelUniform u2 = {
-       .mvp = perspective_matrix() * player_.view_matrix(),
+       .mvp = model_view_proj_,
        .color = Vec3(0.1, 0.1, 0.8),
    };
-   model_uniforms_.upload_memory(&u2, sizeof(u2), 0);
-
-   player_.update(delta_.count());
-
-   return true;
+   model_uniform_offset_ = renderer_.write_uniform(u2);
 }
 
-void App::draw() {
-   bool did_begin = renderer_.begin_draw();
-
-   if (!did_begin) {
-      renderer_.recreate_swapchain(window_.width(), window_.height(), window_.surface());
-
-      VKAD_ASSERT(
-          renderer_.begin_draw(), "failed to acquire next image after recreating swapchain"
+int App::create_ui_material() {
+   if (renderer_.bindless()) {
+      return renderer_.create_bindless_material<UiVertex, UiPushConstants>(
+          {"text-bindless-vert.spv", "text-bindless-frag.spv"}
       );
    }
 
-   renderer_.set_material(model_material_);
-   renderer_.set_uniform(model_material_, 0);
-
-   for (const Model &model : models_) {
-      renderer_.draw(model.id());
-   }
-
-   renderer_.set_material(ui_material_);
-
-   for (int i = 0; i < text_meshes_.size(); ++i) {
-      Widget &widget = text_meshes_[i];
-      renderer_.set_uniform(ui_material_, i * ui_uniforms_.element_size());
-      renderer_.draw(widget.id());
-   }
-
-   renderer_.end_draw();
+   return renderer_.create_material<UiVertex>(
+       {"text-vert.spv", "text-frag.spv"},
+       {
+           DescriptorPool::uniform_buffer_dynamic(0),
+           DescriptorPool::combined_image_sampler(1),
+       }
+   );
 }
 
 void App::handle_resize() {
@@ -277,11 +508,6 @@ bool App::process_input(const std::string &message) {
 
    type_sfx_.value().play();
 
-   if (text_meshes_.size() >= 2) {
-      renderer_.delete_mesh(text_meshes_[1]);
-      text_meshes_.erase(text_meshes_.begin() + 1);
-   }
-
    for (char c : window_.typed_chars()) {
       switch (c) {
       case '\b':
@@ -291,6 +517,7 @@ bool App::process_input(const std::string &message) {
          break;
 
       case '\r':
+         clear_prompt_text();
          return true;
 
       default:
@@ -299,14 +526,90 @@ bool App::process_input(const std::string &message) {
       }
    }
 
-   add_prompt_text(message);
+   set_prompt_text(message);
    return false;
 }
 
-void App::add_prompt_text(const std::string &message) {
+void App::add_model(Model &&model) {
+   model_bounds_.push(model.bounds().box);
+   models_.emplace_back(std::move(model));
+}
+
+void App::repeat_last_model() {
+   clear_instances();
+
+   // Copies go in a row along x, one model width plus a gap apart
+   const std::vector<ModelVertex> &vertices = models_.back().vertices();
+   auto [min_it, max_it] = std::minmax_element(
+       vertices.begin(), vertices.end(),
+       [](const ModelVertex &a, const ModelVertex &b) { return a.pos.x < b.pos.x; }
+   );
+   float spacing = (max_it->pos.x - min_it->pos.x) * 1.5f;
+
+   std::vector<ModelInstance> instances;
+   instances.reserve(repeat_count_);
+   for (int i = 1; i <= repeat_count_; ++i) {
+      instances.push_back({
+          .model = Mat4::translate(Vec3(spacing * i, 0, 0)),
+          .color = Vec3(0.1, 0.1, 0.8),
+      });
+   }
+
+   model_instances_ = renderer_.init_instances(instances);
+}
+
+void App::clear_instances() {
+   if (model_instances_ != -1) {
+      renderer_.delete_instances(model_instances_);
+      model_instances_ = -1;
+   }
+}
+
+void App::set_prompt_text(const std::string &message) {
    Widget text = font_.create_text(message + input_);
    text.set_position(30, window_.height() - 50);
    text.set_size(35);
-   renderer_.init_mesh(text);
+
+   // The prompt changes with every typed character, so it stays a dynamic mesh that is updated
+   // in place rather than being deleted and created again
+   if (text_meshes_.size() >= 2) {
+      Widget &prompt = text_meshes_[1];
+      prompt.vertices() = std::move(text.vertices());
+      prompt.indices() = std::move(text.indices());
+      prompt.set_position(30, window_.height() - 50);
+      renderer_.update_mesh(prompt);
+      return;
+   }
+
+   renderer_.init_dynamic_mesh(text);
    text_meshes_.emplace_back(std::move(text));
 }
+
+void App::clear_prompt_text() {
+   if (text_meshes_.size() >= 2) {
+      renderer_.delete_mesh(text_meshes_[1]);
+      text_meshes_.erase(text_meshes_.begin() + 1);
+   }
+}
+
+void App::update_gpu_overlay() {
+   const GpuProfiler *profiler = renderer_.gpu_profiler();
+   if (profiler == nullptr || --gpu_overlay_countdown_ > 0) {
+      return;
+   }
+   gpu_overlay_countdown_ = kGpuOverlayInterval;
+
+   Widget text = font_.create_text(profiler->overlay_text());
+   text.set_position(30, 300);
+   text.set_size(20);
+
+   if (gpu_overlay_.has_value()) {
+      gpu_overlay_->vertices() = std::move(text.vertices());
+      gpu_overlay_->indices() = std::move(text.indices());
+      renderer_.update_mesh(*gpu_overlay_);
+      return;
+   }
+
+   renderer_.init_dynamic_mesh(text);
+   gpu_overlay_.emplace(std::move(text));
+}
@@ -9,10 +9,12 @@
 #include "gpu/buffer.h"
 #include "gpu/instance.h"
 #include "math/angle.h"
+#include "math/frustum.h"
 #include "math/mat4.h"
 #include "renderer.h"
 #include "sound.h"
 #include "ui/font.h"
+#include "ui/ui.h"
 #include "window/window.h" // IWYU pragma: export
 
 namespace vkad {
@@ -23,7 +25,16 @@ class App {
    using Clock = std::chrono::high_resolution_clock;
 
 public:
-   App();
+   /// With `profile_gpu`, GPU times of the frame's passes and materials are shown on screen if the
+   /// device supports timestamps. With `late_latch_camera`, the model matrices are rewritten with
+   /// the camera as of submission, see Renderer::set_camera_source(). With `gpu_cull`, models are
+   /// culled on the GPU against the view frustum and the previous frame's depth, see
+   /// Renderer::draw_culled(), instead of against the view frustum on the CPU.
+   explicit App(
+       int frames_in_flight = Renderer::kDefaultFramesInFlight, bool visualize_overdraw = false,
+       bool profile_gpu = false, bool late_latch_camera = true,
+       PresentProfile present_profile = PresentProfile::BALANCED, bool gpu_cull = false
+   );
 
    ~App();
 
@@ -89,7 +100,7 @@ public:
 
    inline Mat4 perspective_matrix() const {
       float aspect = static_cast<float>(window_.height()) / static_cast<float>(window_.width());
-      return Mat4::perspective(aspect, deg_to_rad(70), 0.01, 100);
+      return Mat4::perspective(aspect, deg_to_rad(kFovDegrees), kNearPlane, kFarPlane);
    }
 
    inline Font &font() {
@@ -97,23 +108,87 @@ public:
    }
 
 private:
+   /// Vertical field of view and clip planes of perspective_matrix()
+   static constexpr float kFovDegrees = 70;
+   static constexpr float kNearPlane = 0.01f;
+   static constexpr float kFarPlane = 100;
+   /// Most a late latched camera turns around each axis, in radians. Culling allows for this much,
+   /// and faster mouse movement turns the camera over the following frames.
+   static constexpr float kMaxLateTurn = 0.05f;
+   static constexpr uint32_t kModelArenaVertices = 1 << 20;
+   static constexpr uint32_t kModelArenaIndices = 1 << 21;
+   /// Render queue layer of the UI, drawn after the scene
+   static constexpr int kUiLayer = 1;
+   static constexpr PipelineOptions kOpaqueOptions = {.depth_test = true};
+   /// Frames between updates of the GPU profiler text, so it stays readable
+   static constexpr int kGpuOverlayInterval = 30;
+
+   struct ModelDistance {
+      float distance;
+      int mesh_id;
+   };
+
    void handle_resize();
+   /// Creates the text material, bindless when the renderer supports it
+   int create_ui_material();
+   /// Advances the create, extrude and repeat prompts with this frame's input
+   void update_state();
+   /// Writes this frame's UI and model uniforms, or the UI push constants when bindless
+   void write_uniforms();
+   /// Turns the player with the mouse input that arrived since poll(), for the late latched camera
+   CameraSample sample_camera();
+   /// A perspective matrix whose frustum holds what perspective_matrix() shows after turning by up
+   /// to kMaxLateTurn around each axis
+   Mat4 late_latch_cull_matrix() const;
    bool process_input(const std::string &message);
-   void add_prompt_text(const std::string &message);
+   /// Adds a model that was initialized in `model_arena_`
+   void add_model(Model &&model);
+   /// Shows `message` followed by the input typed so far at the bottom of the window
+   void set_prompt_text(const std::string &message);
+   void clear_prompt_text();
+   /// Refreshes the GPU profiler text every kGpuOverlayInterval frames while profiling
+   void update_gpu_overlay();
+   /// Places `repeat_count_` instanced copies of the last model next to it
+   void repeat_last_model();
+   void clear_instances();
 
    Instance vk_instance_;
    Window window_;
    Renderer renderer_;
 
    Font font_;
-   UniformBuffer ui_uniforms_;
    int ui_material_;
    std::vector<Widget> text_meshes_;
+   std::optional<Widget> gpu_overlay_;
+   int gpu_overlay_countdown_;
+   /// Text meshes and the GPU overlay, everything the UI draws this frame
+   std::vector<const Widget *> ui_widgets_;
+   /// Uniform ring offsets of this frame's text uniforms, one per text mesh
+   std::vector<uint32_t> ui_uniform_offsets_;
+   /// With a bindless text material, the font's bindless image and the per-draw data that replaces
+   /// the uniforms
+   uint32_t font_texture_;
+   std::vector<UiPushConstants> ui_push_constants_;
 
-   UniformBuffer model_uniforms_;
    int model_material_;
+   int model_arena_;
+   int instanced_model_material_;
+   /// Copies of the last model placed with the repeat command, or -1 if there are none
+   int model_instances_;
+   uint32_t model_uniform_offset_;
    std::vector<Shape> shapes_;
    std::vector<Model> models_;
+   /// Bounding box of each model in `models_`, in the same order
+   AabbBatch model_bounds_;
+   Mat4 model_view_proj_;
+   /// What the models are culled with: `model_view_proj_`, widened by late_latch_cull_matrix()
+   /// when late latching
+   Mat4 model_cull_view_proj_;
+   /// Reused every frame for the indices of the models in the view frustum, and to sort those
+   /// front to back
+   std::vector<uint32_t> visible_models_;
+   std::vector<ModelDistance> model_order_;
+   bool gpu_cull_;
 
    int last_width_;
    int last_height_;
@@ -125,12 +200,20 @@ private:
    std::optional<Sound> export_sfx_;
 
    Clock::time_point last_frame_time_;
+   /// When this frame's input was read, and when the input the player's camera was last updated
+   /// with was read
+   std::chrono::steady_clock::time_point input_time_;
+   std::chrono::steady_clock::time_point camera_input_time_;
+   /// Mouse movement the late latched camera hasn't turned by yet, see kMaxLateTurn
+   int held_mouse_x_;
+   int held_mouse_y_;
    std::chrono::duration<float> delta_;
    bool was_left_clicking_;
 
    Player player_;
    State state_;
    std::string input_;
+   int repeat_count_;
    int create_sides_;
    float create_radius_;
    float extrude_amount_;
@@ -0,0 +1,106 @@
+// Measures how long frustum culling takes on the CPU for growing numbers of boxes, with the SIMD
+// AabbBatch::cull() against testing every box with Frustum::intersects(). Boxes are scattered
+// around the camera so that roughly a fifth of them are visible.
+//
+// Usage: vkad_bench_cull [num_iterations]
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "math/angle.h"
+#include "math/bounds.h"
+#include "math/frustum.h"
+#include "math/mat4.h"
+#include "util/stats.h"
+
+using namespace vkad;
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr int kWarmupIterations = 10;
+
+void print_summary(const char *name, const std::vector<float> &times, size_t num_visible) {
+   TimingSummary summary = summarize_timings(times);
+   std::cout << std::format(
+       "  {:10}: mean {:7.4f} ms  p50 {:7.4f}  p95 {:7.4f}  max {:7.4f}  ({} visible)\n", name,
+       summary.mean, summary.p50, summary.p95, summary.max, num_visible
+   );
+}
+
+void run_bench(int num_boxes, int num_iterations) {
+   std::mt19937 rng(1);
+   std::uniform_real_distribution<float> coord(-50, 50);
+   std::uniform_real_distribution<float> size(0.1f, 1);
+
+   std::vector<Aabb> boxes;
+   AabbBatch batch;
+   boxes.reserve(num_boxes);
+   for (int i = 0; i < num_boxes; ++i) {
+      Vec3 center(coord(rng), coord(rng), coord(rng));
+      Vec3 half(size(rng), size(rng), size(rng));
+      boxes.push_back({.min = center - half, .max = center + half});
+      batch.push(boxes.back());
+   }
+
+   Frustum frustum = Frustum::from_matrix(
+       Mat4::perspective(9.0f / 16.0f, deg_to_rad(70), 0.01, 100) * Mat4::rotate_y(deg_to_rad(30))
+   );
+
+   std::vector<uint32_t> visible;
+   visible.reserve(num_boxes);
+   std::vector<float> batch_times;
+   std::vector<float> scalar_times;
+
+   for (int i = 0; i < kWarmupIterations + num_iterations; ++i) {
+      Clock::time_point start = Clock::now();
+      batch.cull(frustum, visible);
+      Clock::time_point end = Clock::now();
+      if (i >= kWarmupIterations) {
+         batch_times.push_back(std::chrono::duration<float, std::milli>(end - start).count());
+      }
+   }
+   size_t batch_visible = visible.size();
+
+   for (int i = 0; i < kWarmupIterations + num_iterations; ++i) {
+      Clock::time_point start = Clock::now();
+      visible.clear();
+      for (uint32_t b = 0; b < boxes.size(); ++b) {
+         if (frustum.intersects(boxes[b])) {
+            visible.push_back(b);
+         }
+      }
+      Clock::time_point end = Clock::now();
+      if (i >= kWarmupIterations) {
+         scalar_times.push_back(std::chrono::duration<float, std::milli>(end - start).count());
+      }
+   }
+
+   print_summary("AabbBatch", batch_times, batch_visible);
+   print_summary("per box", scalar_times, visible.size());
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+   try {
+      int num_iterations = argc > 1 ? std::stoi(argv[1]) : 200;
+
+      for (int num_boxes : {1000, 10000, 100000}) {
+         std::cout << std::format("{} boxes, {} iterations\n", num_boxes, num_iterations);
+         run_bench(num_boxes, num_iterations);
+      }
+   } catch (const std::exception &e) {
+      std::cerr << "Unhandled exception: " << e.what() << "\n";
+      return 1;
+   }
+
+   return 0;
+}
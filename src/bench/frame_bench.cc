@@ -0,0 +1,286 @@
+// Renders a grid of extruded models and reports frame times for different frames-in-flight
+// settings. The "idle" configuration reproduces the old behaviour of waiting for the device after
+// every frame. The "indirect" configuration places the models in a geometry arena with their grid
+// position baked into the vertices and draws them all with one indirect draw. The "queue"
+// configuration submits the models to the render queue, which sorts them and skips redundant binds.
+// Per-model transforms come from the uniform ring, except in the "push constants" configuration.
+// The "GPU culled" configuration draws the arena with depth testing through draw_culled(), which
+// also reports how many models the compute pass rejected.
+//
+// Usage: vkad_bench_frame [num_models] [num_frames]
+
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "geometry/circle.h"
+#include "geometry/geometry.h"
+#include "geometry/model.h"
+#include "gpu/command_pool.h"
+#include "gpu/descriptor_pool.h"
+#include "gpu/instance.h"
+#include "gpu/physical_device.h"
+#include "math/angle.h"
+#include "math/mat4.h"
+#include "renderer.h"
+#include "util/stats.h"
+#include "window/window.h" // IWYU pragma: export
+
+using namespace vkad;
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr int kWarmupFrames = 30;
+
+enum class DrawPath {
+   IMMEDIATE,
+   INDIRECT,
+   QUEUE,
+   PUSH_CONSTANTS,
+   GPU_CULLED,
+   /// Push constants with the shared bindless pipeline layout
+   BINDLESS,
+};
+
+struct BenchConfig {
+   const char *name;
+   int frames_in_flight;
+   bool wait_idle_every_frame;
+   DrawPath path;
+};
+
+Vec3 grid_position(int index, int num_models) {
+   int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(num_models))));
+   float x = (index % side - side / 2) * 0.3f;
+   float z = -(index / side) * 0.3f;
+   return Vec3(x, 0, z);
+}
+
+std::vector<float> run_bench(
+    Instance &instance, Window &window, const BenchConfig &config, int num_models, int num_frames
+) {
+   Renderer renderer(
+       instance, window.surface(), window.width(), window.height(), config.frames_in_flight
+   );
+
+   bool indirect = config.path == DrawPath::INDIRECT || config.path == DrawPath::GPU_CULLED;
+   int material;
+   bool push = config.path == DrawPath::PUSH_CONSTANTS || config.path == DrawPath::BINDLESS;
+   if (config.path == DrawPath::PUSH_CONSTANTS) {
+      material = renderer.create_push_constant_material<ModelVertex, ModelUniform>(
+          {"model-push-vert.spv", "model-frag.spv"}, {}
+      );
+   } else if (config.path == DrawPath::BINDLESS) {
+      material = renderer.create_bindless_material<ModelVertex, ModelUniform>(
+          {"model-push-vert.spv", "model-frag.spv"}
+      );
+   } else {
+      material = renderer.create_material<ModelVertex>(
+          {"model-vert.spv", "model-frag.spv"}, {DescriptorPool::uniform_buffer_dynamic(0)},
+          {.depth_test = config.path == DrawPath::GPU_CULLED}
+      );
+      renderer.link_uniform_ring<ModelUniform>(material);
+   }
+
+   int arena = -1;
+   if (indirect) {
+      arena = renderer.create_geometry_arena<ModelVertex>(1 << 20, 1 << 21);
+   }
+
+   std::vector<Model> models;
+   std::vector<int> model_ids;
+   models.reserve(num_models);
+   for (int i = 0; i < num_models; ++i) {
+      Model model = Circle(0.1f, 32).extrude(0.2f);
+      if (indirect) {
+         Vec3 position = grid_position(i, num_models);
+         for (ModelVertex &vertex : model.vertices()) {
+            vertex.pos.x += position.x;
+            vertex.pos.z += position.z;
+         }
+      }
+
+      renderer.init_mesh(model, arena);
+      model_ids.push_back(model.id());
+      models.emplace_back(std::move(model));
+   }
+
+   float aspect = static_cast<float>(window.height()) / static_cast<float>(window.width());
+   Mat4 view_proj = Mat4::perspective(aspect, deg_to_rad(70), 0.01, 100) *
+                    Mat4::rotate_x(deg_to_rad(30)) * Mat4::translate(Vec3(0, -2, -3));
+
+   std::vector<ModelUniform> model_uniforms(num_models);
+   std::vector<uint32_t> uniform_offsets(num_models);
+   std::vector<float> frame_times;
+   frame_times.reserve(num_frames);
+   Clock::time_point last_frame = Clock::now();
+
+   for (int frame = 0; frame < kWarmupFrames + num_frames; ++frame) {
+      if (!window.poll()) {
+         break;
+      }
+
+      renderer.begin_frame();
+
+      for (int i = 0; i < (indirect ? 1 : num_models); ++i) {
+         Mat4 model = indirect ? Mat4::identity() : Mat4::translate(grid_position(i, num_models));
+         model_uniforms[i] = {
+             .mvp = view_proj * model,
+             .color = Vec3(0.1, 0.1, 0.8),
+         };
+
+         if (!push) {
+            uniform_offsets[i] = renderer.write_uniform(model_uniforms[i]);
+         }
+      }
+
+      if (!renderer.begin_draw()) {
+         renderer.recreate_swapchain(window.width(), window.height(), window.surface());
+         continue;
+      }
+
+      switch (config.path) {
+      case DrawPath::IMMEDIATE:
+         renderer.set_material(material);
+         for (int i = 0; i < num_models; ++i) {
+            renderer.set_uniform(material, uniform_offsets[i]);
+            renderer.draw(models[i].id());
+         }
+         break;
+
+      case DrawPath::INDIRECT:
+         renderer.set_material(material);
+         renderer.set_uniform(material, uniform_offsets[0]);
+         renderer.draw_indirect(model_ids);
+         break;
+
+      case DrawPath::GPU_CULLED:
+         renderer.set_material(material);
+         renderer.set_uniform(material, uniform_offsets[0]);
+         renderer.draw_culled(model_ids, model_uniforms[0].mvp);
+         break;
+
+      case DrawPath::QUEUE:
+         for (int i = 0; i < num_models; ++i) {
+            DrawItem item = {
+                .material_id = material,
+                .uniform_offset = uniform_offsets[i],
+                .mesh_id = models[i].id(),
+            };
+            renderer.submit(item, -grid_position(i, num_models).z);
+         }
+         renderer.draw_queue();
+         break;
+
+      case DrawPath::PUSH_CONSTANTS:
+      case DrawPath::BINDLESS:
+         renderer.set_material(material);
+         for (int i = 0; i < num_models; ++i) {
+            renderer.push_constants(material, model_uniforms[i]);
+            renderer.draw(models[i].id());
+         }
+         break;
+      }
+
+      renderer.end_draw();
+
+      if (config.wait_idle_every_frame) {
+         renderer.wait_idle();
+      }
+
+      Clock::time_point now = Clock::now();
+      if (frame >= kWarmupFrames) {
+         frame_times.push_back(std::chrono::duration<float, std::milli>(now - last_frame).count());
+      }
+      last_frame = now;
+   }
+
+   MemoryStats mem = renderer.memory_stats();
+   std::cout << std::format(
+       "  {} allocations in {} device allocations, {:.1f} MiB reserved, fragmentation {:.0f}% "
+       "internal / {:.0f}% external\n",
+       mem.num_allocations, mem.num_device_allocations, mem.reserved_bytes / (1024.0 * 1024.0),
+       mem.internal_fragmentation * 100, mem.external_fragmentation * 100
+   );
+
+   const BindStats &binds = renderer.bind_stats();
+   std::cout << std::format(
+       "  last frame: {} draws, {} pipeline binds ({} saved), {} descriptor binds ({} saved), "
+       "{} vertex binds ({} saved), {} viewport sets saved\n",
+       binds.num_draws, binds.pipeline_binds, binds.pipeline_binds_saved, binds.descriptor_binds,
+       binds.descriptor_binds_saved, binds.vertex_binds, binds.vertex_binds_saved,
+       binds.viewport_binds_saved
+   );
+
+   CommandPoolStats pools = renderer.command_pool_stats();
+   std::cout << std::format(
+       "  {} command buffers allocated, {} live, {} reuses\n", pools.num_allocated,
+       pools.num_live, pools.num_reused
+   );
+
+   if (config.path == DrawPath::GPU_CULLED) {
+      const CullStats &cull = renderer.cull_stats();
+      std::cout << std::format(
+          "  last culled frame: {} indirect commands, {} tested, {} frustum culled, {} occlusion "
+          "culled\n",
+          binds.num_culled_commands, cull.num_tested, cull.num_frustum_culled,
+          cull.num_occlusion_culled
+      );
+   }
+
+   renderer.wait_idle();
+   return frame_times;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+   try {
+      int num_models = argc > 1 ? std::stoi(argv[1]) : 2000;
+      int num_frames = argc > 2 ? std::stoi(argv[2]) : 500;
+
+      Instance instance(Window::vulkan_extensions());
+      Window window(instance, "vkad frame benchmark");
+
+      const BenchConfig configs[] = {
+          {"1 frame in flight + idle", 1, true, DrawPath::IMMEDIATE},
+          {"1 frame in flight", 1, false, DrawPath::IMMEDIATE},
+          {"2 frames in flight", 2, false, DrawPath::IMMEDIATE},
+          {"3 frames in flight", 3, false, DrawPath::IMMEDIATE},
+          {"2 frames in flight, indirect", 2, false, DrawPath::INDIRECT},
+          {"2 frames in flight, render queue", 2, false, DrawPath::QUEUE},
+          {"2 frames in flight, push constants", 2, false, DrawPath::PUSH_CONSTANTS},
+          {"2 frames in flight, GPU culled", 2, false, DrawPath::GPU_CULLED},
+          {"2 frames in flight, bindless", 2, false, DrawPath::BINDLESS},
+      };
+
+      std::cout << std::format("{} models, {} frames\n", num_models, num_frames);
+
+      for (const BenchConfig &config : configs) {
+         std::cout << config.name << "\n";
+         if (config.path == DrawPath::BINDLESS &&
+             !PhysicalDevice(instance, window.surface()).descriptor_indexing_supported()) {
+            std::cout << "  skipped, descriptor indexing is not supported\n";
+            continue;
+         }
+         TimingSummary summary =
+             summarize_timings(run_bench(instance, window, config, num_models, num_frames));
+
+         std::cout << std::format(
+             "  mean {:7.3f} ms  p50 {:7.3f}  p95 {:7.3f}  p99 {:7.3f}  max {:7.3f}\n",
+             summary.mean, summary.p50, summary.p95, summary.p99, summary.max
+         );
+      }
+   } catch (const std::exception &e) {
+      std::cerr << "Unhandled exception: " << e.what() << "\n";
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,138 @@
+// Measures how long the CPU takes to record a frame's draws with Renderer::draw_parallel() for
+// growing numbers of models and recording threads. Only the recording is timed, not acquiring,
+// submitting or presenting.
+//
+// Usage: vkad_bench_record [max_threads] [num_frames]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <format>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "geometry/circle.h"
+#include "geometry/geometry.h"
+#include "geometry/model.h"
+#include "gpu/descriptor_pool.h"
+#include "gpu/instance.h"
+#include "math/angle.h"
+#include "math/mat4.h"
+#include "renderer.h"
+#include "util/stats.h"
+#include "window/window.h" // IWYU pragma: export
+
+using namespace vkad;
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr int kWarmupFrames = 30;
+
+Vec3 grid_position(int index, int num_models) {
+   int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(num_models))));
+   float x = (index % side - side / 2) * 0.3f;
+   float z = -(index / side) * 0.3f;
+   return Vec3(x, 0, z);
+}
+
+void run_bench(
+    Instance &instance, Window &window, int num_models, int max_threads, int num_frames
+) {
+   Renderer renderer(instance, window.surface(), window.width(), window.height());
+
+   UniformBuffer uniforms = renderer.create_uniform_buffer<ModelUniform>(num_models);
+   int material = renderer.create_material<ModelVertex>(
+       {"model-vert.spv", "model-frag.spv"}, {DescriptorPool::uniform_buffer_dynamic(0)}
+   );
+   renderer.link_material(material, {DescriptorPool::write_uniform_buffer_dynamic(uniforms)});
+
+   std::vector<Model> models;
+   models.reserve(num_models);
+   for (int i = 0; i < num_models; ++i) {
+      Model model = Circle(0.1f, 32).extrude(0.2f);
+      renderer.init_mesh(model);
+      models.emplace_back(std::move(model));
+   }
+
+   float aspect = static_cast<float>(window.height()) / static_cast<float>(window.width());
+   Mat4 view_proj = Mat4::perspective(aspect, deg_to_rad(70), 0.01, 100) *
+                    Mat4::rotate_x(deg_to_rad(30)) * Mat4::translate(Vec3(0, -2, -3));
+
+   for (int threads = 1; threads <= max_threads; threads *= 2) {
+      renderer.set_recording_threads(threads);
+
+      std::vector<float> record_times;
+      record_times.reserve(num_frames);
+
+      for (int frame = 0; frame < kWarmupFrames + num_frames; ++frame) {
+         if (!window.poll()) {
+            return;
+         }
+
+         renderer.begin_frame();
+         int slice = renderer.current_frame();
+
+         std::vector<DrawItem> items;
+         items.reserve(num_models);
+         for (int i = 0; i < num_models; ++i) {
+            ModelUniform u = {
+                .mvp = view_proj * Mat4::translate(grid_position(i, num_models)),
+                .color = Vec3(0.1, 0.1, 0.8),
+            };
+            uniforms.upload_memory(&u, sizeof(u), i, slice);
+            items.push_back({material, uniforms.dynamic_offset(i, slice), models[i].id()});
+         }
+
+         if (!renderer.begin_draw()) {
+            renderer.recreate_swapchain(window.width(), window.height(), window.surface());
+            continue;
+         }
+
+         Clock::time_point start = Clock::now();
+         renderer.draw_parallel(items);
+         Clock::time_point end = Clock::now();
+
+         renderer.end_draw();
+
+         if (frame >= kWarmupFrames) {
+            record_times.push_back(std::chrono::duration<float, std::milli>(end - start).count());
+         }
+      }
+
+      TimingSummary summary = summarize_timings(record_times);
+      std::cout << std::format(
+          "  {:2} threads: mean {:7.3f} ms  p50 {:7.3f}  p95 {:7.3f}  max {:7.3f}\n", threads,
+          summary.mean, summary.p50, summary.p95, summary.max
+      );
+   }
+
+   renderer.wait_idle();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+   try {
+      int hardware_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+      int max_threads = argc > 1 ? std::stoi(argv[1]) : hardware_threads;
+      int num_frames = argc > 2 ? std::stoi(argv[2]) : 300;
+
+      Instance instance(Window::vulkan_extensions());
+      Window window(instance, "vkad recording benchmark");
+
+      for (int num_models : {1000, 5000, 20000}) {
+         std::cout << std::format("{} models, {} frames\n", num_models, num_frames);
+         run_bench(instance, window, num_models, max_threads, num_frames);
+      }
+   } catch (const std::exception &e) {
+      std::cerr << "Unhandled exception: " << e.what() << "\n";
+      return 1;
+   }
+
+   return 0;
+}
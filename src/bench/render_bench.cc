@@ -0,0 +1,188 @@
+// Renders synthetic scenes of growing size with a headless renderer, so it runs without a window on
+// any Vulkan implementation including lavapipe. Each scene is a grid of extruded models drawn
+// through the render queue with depth testing. Reports percentiles of the whole frame, of the CPU
+// work after begin_frame() has waited for a free frame until end_draw() returns, and of the GPU
+// time of the frame when the device supports timestamps. Optionally writes the last frame of the
+// largest scene to a binary PPM image, for comparing against a known good render.
+//
+// Usage: vkad_bench_render [max_models] [num_frames] [dump.ppm]
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "geometry/circle.h"
+#include "geometry/geometry.h"
+#include "geometry/model.h"
+#include "gpu/descriptor_pool.h"
+#include "gpu/gpu_profiler.h"
+#include "gpu/instance.h"
+#include "math/angle.h"
+#include "math/mat4.h"
+#include "renderer.h"
+#include "util/stats.h"
+
+using namespace vkad;
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr int kWarmupFrames = 30;
+constexpr uint32_t kWidth = 1280;
+constexpr uint32_t kHeight = 720;
+
+struct SceneTimings {
+   std::vector<float> frame_ms;
+   std::vector<float> cpu_ms;
+   /// Empty if the device can't write timestamps
+   std::vector<float> gpu_ms;
+};
+
+Vec3 grid_position(int index, int num_models) {
+   int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(num_models))));
+   float x = (index % side - side / 2) * 0.3f;
+   float z = -(index / side) * 0.3f;
+   return Vec3(x, 0, z);
+}
+
+/// Drops the alpha channel of tightly packed RGBA8 rows
+void write_ppm(
+    const std::string &path, uint32_t width, uint32_t height, const std::vector<uint8_t> &rgba
+) {
+   std::ofstream file(path, std::ios::binary);
+   file << std::format("P6\n{} {}\n255\n", width, height);
+   for (size_t i = 0; i < rgba.size(); i += 4) {
+      file.write(reinterpret_cast<const char *>(&rgba[i]), 3);
+   }
+}
+
+SceneTimings run_scene(
+    Instance &instance, int num_models, int num_frames, const std::string &dump_path
+) {
+   Renderer renderer(instance, VK_NULL_HANDLE, kWidth, kHeight);
+   bool gpu_timed = renderer.enable_gpu_profiler();
+
+   int material = renderer.create_material<ModelVertex>(
+       {"model-vert.spv", "model-frag.spv"}, {DescriptorPool::uniform_buffer_dynamic(0)},
+       {.depth_test = true}
+   );
+   renderer.link_uniform_ring<ModelUniform>(material);
+
+   std::vector<Model> models;
+   models.reserve(num_models);
+   for (int i = 0; i < num_models; ++i) {
+      Model model = Circle(0.1f, 32).extrude(0.2f);
+      renderer.init_mesh(model);
+      models.emplace_back(std::move(model));
+   }
+
+   float aspect = static_cast<float>(kHeight) / static_cast<float>(kWidth);
+   Mat4 view_proj = Mat4::perspective(aspect, deg_to_rad(70), 0.01, 100) *
+                    Mat4::rotate_x(deg_to_rad(30)) * Mat4::translate(Vec3(0, -2, -3));
+
+   std::vector<uint32_t> uniform_offsets(num_models);
+   SceneTimings timings;
+   timings.frame_ms.reserve(num_frames);
+   timings.cpu_ms.reserve(num_frames);
+   Clock::time_point last_frame = Clock::now();
+
+   for (int frame = 0; frame < kWarmupFrames + num_frames; ++frame) {
+      renderer.begin_frame();
+      Clock::time_point cpu_start = Clock::now();
+
+      // begin_frame() read back the GPU timestamps of the frame that last used this frame's slot
+      if (gpu_timed && frame >= kWarmupFrames) {
+         float gpu_ms = renderer.gpu_profiler()->collected_ms("frame");
+         if (gpu_ms >= 0) {
+            timings.gpu_ms.push_back(gpu_ms);
+         }
+      }
+
+      for (int i = 0; i < num_models; ++i) {
+         ModelUniform uniform = {
+             .mvp = view_proj * Mat4::translate(grid_position(i, num_models)),
+             .color = Vec3(0.1, 0.1, 0.8),
+         };
+         uniform_offsets[i] = renderer.write_uniform(uniform);
+      }
+
+      renderer.begin_draw();
+      for (int i = 0; i < num_models; ++i) {
+         DrawItem item = {
+             .material_id = material,
+             .uniform_offset = uniform_offsets[i],
+             .mesh_id = models[i].id(),
+         };
+         renderer.submit(item, -grid_position(i, num_models).z);
+      }
+      renderer.end_draw();
+
+      Clock::time_point now = Clock::now();
+      if (frame >= kWarmupFrames) {
+         std::chrono::duration<float, std::milli> cpu_time = now - cpu_start;
+         std::chrono::duration<float, std::milli> frame_time = now - last_frame;
+         timings.cpu_ms.push_back(cpu_time.count());
+         timings.frame_ms.push_back(frame_time.count());
+      }
+      last_frame = now;
+   }
+
+   if (!dump_path.empty()) {
+      write_ppm(dump_path, kWidth, kHeight, renderer.read_pixels());
+      std::cout << std::format("  wrote the last frame to {}\n", dump_path);
+   }
+
+   renderer.wait_idle();
+   return timings;
+}
+
+void print_summary(const char *label, const std::vector<float> &samples) {
+   TimingSummary summary = summarize_timings(samples);
+   std::cout << std::format(
+       "  {:5} mean {:7.3f} ms  p50 {:7.3f}  p95 {:7.3f}  p99 {:7.3f}  max {:7.3f}\n", label,
+       summary.mean, summary.p50, summary.p95, summary.p99, summary.max
+   );
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+   try {
+      int max_models = argc > 1 ? std::stoi(argv[1]) : 10000;
+      int num_frames = argc > 2 ? std::stoi(argv[2]) : 300;
+      std::string dump_path = argc > 3 ? argv[3] : "";
+
+      // Headless rendering needs no instance extensions
+      Instance instance({});
+
+      std::cout << std::format("{}x{} offscreen, {} frames\n", kWidth, kHeight, num_frames);
+
+      for (int num_models = 100; num_models <= max_models; num_models *= 10) {
+         std::cout << std::format("{} models\n", num_models);
+
+         bool largest = num_models * 10 > max_models;
+         SceneTimings timings =
+             run_scene(instance, num_models, num_frames, largest ? dump_path : "");
+
+         print_summary("frame", timings.frame_ms);
+         print_summary("CPU", timings.cpu_ms);
+         if (timings.gpu_ms.empty()) {
+            std::cout << "  GPU   not measured, the graphics queue has no timestamps\n";
+         } else {
+            print_summary("GPU", timings.gpu_ms);
+         }
+      }
+   } catch (const std::exception &e) {
+      std::cerr << "Unhandled exception: " << e.what() << "\n";
+      return 1;
+   }
+
+   return 0;
+}
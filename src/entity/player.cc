@@ -4,6 +4,7 @@
 
 #include "app.h"
 #include "math/vec2.h"
+#include "util/trace.h"
 #include "window/keys.h" // IWYU pragma: export
 
 using namespace vkad;
@@ -11,6 +12,7 @@ using namespace vkad;
 Player::Player(App &app) : app_(app), pos_(0, 0, 1), pitch_(0), yaw_(0) {}
 
 void Player::update(float delta) {
+   VKAD_TRACE_ZONE("Player::update");
    Vec2 input;
 
    if (app_.is_key_down(VKAD_KEY_D)) {
@@ -37,11 +39,7 @@ void Player::update(float delta) {
       pos_.y -= delta;
    }
 
-   float delta_yaw = app_.delta_mouse_x() / 2.0f;
-   yaw_ -= delta_yaw * delta;
-
-   float delta_pitch = app_.delta_mouse_y() / 2.0f;
-   pitch_ -= delta_pitch * delta;
+   look(app_.delta_mouse_x(), app_.delta_mouse_y(), delta);
 
    if (input == Vec2(0, 0)) {
       return;
@@ -52,3 +50,11 @@ void Player::update(float delta) {
    pos_.x += move.x;
    pos_.z += move.y;
 }
+
+void Player::look(int delta_x, int delta_y, float delta) {
+   float delta_yaw = delta_x / 2.0f;
+   yaw_ -= delta_yaw * delta;
+
+   float delta_pitch = delta_y / 2.0f;
+   pitch_ -= delta_pitch * delta;
+}
@@ -30,6 +30,10 @@ public:
 
    void update(float delta);
 
+   /// Turns the camera by a mouse movement of `delta_x`, `delta_y`, as update() does for a frame
+   /// that took `delta` seconds
+   void look(int delta_x, int delta_y, float delta);
+
 private:
    App &app_;
 
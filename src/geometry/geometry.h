@@ -7,13 +7,15 @@
 
 #include "math/attributes.h"
 #include "math/mat4.h"
+#include "math/packed.h"
 #include "math/vec3.h"
 
 namespace vkad {
 
+/// 16 bytes, the normal is decoded by the vertex shader
 struct ModelVertex {
-   Vec3 pos;
-   Vec3 norm;
+   PackedVec3 pos;
+   OctNormal norm;
 
    static const std::array<VkVertexInputAttributeDescription, 2> kAttributes;
 };
@@ -23,6 +25,19 @@ inline constexpr decltype(ModelVertex::kAttributes) ModelVertex::kAttributes{
     VKAD_ATTRIBUTE(1, ModelVertex, norm),
 };
 
+/// Placement of one copy of a Model drawn with Renderer::draw_instanced()
+struct ModelInstance {
+   Mat4 model;
+   Vec3 color;
+
+   static const std::array<VkVertexInputAttributeDescription, 5> kAttributes;
+};
+
+inline constexpr decltype(ModelInstance::kAttributes) ModelInstance::kAttributes{
+    VKAD_INSTANCE_MAT4_ATTRIBUTES(2, ModelInstance, model),
+    VKAD_INSTANCE_ATTRIBUTE(6, ModelInstance, color),
+};
+
 struct ModelUniform {
    Mat4 mvp;
    Vec3 color;
@@ -0,0 +1,78 @@
+#include "meshlet.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "math/bounds.h"
+#include "math/vec3.h"
+#include "util/assert.h"
+
+using namespace vkad;
+
+namespace {
+
+struct Point {
+   Vec3 pos;
+};
+
+} // namespace
+
+MeshletSet vkad::build_meshlets(
+    const std::vector<Vec3> &positions, const std::vector<uint32_t> &indices,
+    uint32_t max_vertices, uint32_t max_triangles
+) {
+   VKAD_ASSERT(max_vertices >= 3 && max_vertices <= 256, "meshlet vertices are indexed by a byte");
+   VKAD_ASSERT(max_triangles >= 1, "meshlets need room for a triangle");
+
+   MeshletSet set;
+   // Index of each of the mesh's vertices in the meshlet being built, -1 if it isn't in it
+   std::vector<int> local(positions.size(), -1);
+   std::vector<Point> points;
+   Meshlet meshlet = {};
+
+   auto finish_meshlet = [&] {
+      if (meshlet.num_triangles == 0) {
+         return;
+      }
+
+      points.clear();
+      for (uint32_t i = meshlet.first_vertex; i < set.vertices.size(); ++i) {
+         points.push_back({.pos = positions[set.vertices[i]]});
+         local[set.vertices[i]] = -1;
+      }
+      meshlet.bounds = Bounds::of_vertices(points);
+      set.meshlets.push_back(meshlet);
+
+      meshlet = {
+          .first_vertex = static_cast<uint32_t>(set.vertices.size()),
+          .num_vertices = 0,
+          .first_triangle = static_cast<uint32_t>(set.triangles.size() / 3),
+          .num_triangles = 0,
+      };
+   };
+
+   for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+      const uint32_t corners[] = {indices[i], indices[i + 1], indices[i + 2]};
+      uint32_t new_vertices = 0;
+      for (const uint32_t corner : corners) {
+         new_vertices += local[corner] == -1 ? 1 : 0;
+      }
+
+      if (meshlet.num_vertices + new_vertices > max_vertices ||
+          meshlet.num_triangles == max_triangles) {
+         finish_meshlet();
+      }
+
+      for (const uint32_t corner : corners) {
+         if (local[corner] == -1) {
+            local[corner] = static_cast<int>(meshlet.num_vertices++);
+            set.vertices.push_back(corner);
+         }
+         set.triangles.push_back(static_cast<uint8_t>(local[corner]));
+      }
+      ++meshlet.num_triangles;
+   }
+   finish_meshlet();
+
+   return set;
+}
@@ -0,0 +1,45 @@
+#ifndef VKAD_GEOMETRY_MESHLET_H_
+#define VKAD_GEOMETRY_MESHLET_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "math/bounds.h"
+#include "math/vec3.h"
+
+namespace vkad {
+
+/// A cluster of a mesh's triangles that fits the post-transform vertex cache, and can be culled on
+/// its own
+struct Meshlet {
+   /// Range of MeshletSet::vertices
+   uint32_t first_vertex;
+   uint32_t num_vertices;
+   /// Range of the triangles in MeshletSet::triangles, each of which is three entries
+   uint32_t first_triangle;
+   uint32_t num_triangles;
+   Bounds bounds;
+};
+
+struct MeshletSet {
+   std::vector<Meshlet> meshlets;
+   /// Indices into the mesh's vertices, the vertices of each meshlet in turn
+   std::vector<uint32_t> vertices;
+   /// Corners of the triangles as indices into their meshlet's vertices
+   std::vector<uint8_t> triangles;
+};
+
+constexpr uint32_t kMaxMeshletVertices = 64;
+constexpr uint32_t kMaxMeshletTriangles = 124;
+
+/// Splits the triangles of a mesh into meshlets. Triangles are taken in index order, so meshes
+/// whose neighbouring triangles are close together in the index buffer give the tightest
+/// meshlets. `max_vertices` can't be more than 256.
+MeshletSet build_meshlets(
+    const std::vector<Vec3> &positions, const std::vector<uint32_t> &indices,
+    uint32_t max_vertices = kMaxMeshletVertices, uint32_t max_triangles = kMaxMeshletTriangles
+);
+
+} // namespace vkad
+
+#endif // !VKAD_GEOMETRY_MESHLET_H_
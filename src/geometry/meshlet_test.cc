@@ -0,0 +1,63 @@
+#include "meshlet.h"
+
+#include "vendor/doctest.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "math/vec3.h"
+
+using namespace vkad;
+
+TEST_CASE("build_meshlets keeps to the limits and covers every triangle") {
+   // A grid of quads with more vertices than 16-bit indices can address
+   constexpr uint32_t kSide = 300;
+   std::vector<Vec3> positions;
+   for (uint32_t z = 0; z < kSide; ++z) {
+      for (uint32_t x = 0; x < kSide; ++x) {
+         positions.emplace_back(static_cast<float>(x), 0.0f, static_cast<float>(z));
+      }
+   }
+
+   std::vector<uint32_t> indices;
+   for (uint32_t z = 0; z + 1 < kSide; ++z) {
+      for (uint32_t x = 0; x + 1 < kSide; ++x) {
+         uint32_t corner = z * kSide + x;
+         indices.insert(indices.end(), {corner, corner + kSide, corner + 1});
+         indices.insert(indices.end(), {corner + 1, corner + kSide, corner + kSide + 1});
+      }
+   }
+
+   MeshletSet set = build_meshlets(positions, indices);
+   REQUIRE(!set.meshlets.empty());
+
+   std::vector<uint32_t> rebuilt;
+   uint32_t next_triangle = 0;
+   bool within_limits = true;
+   bool within_bounds = true;
+   for (const Meshlet &meshlet : set.meshlets) {
+      within_limits &= meshlet.num_vertices <= kMaxMeshletVertices &&
+                       meshlet.num_triangles <= kMaxMeshletTriangles &&
+                       meshlet.first_triangle == next_triangle;
+      next_triangle += meshlet.num_triangles;
+
+      for (uint32_t i = 0; i < meshlet.num_triangles * 3; ++i) {
+         uint8_t local = set.triangles[meshlet.first_triangle * 3 + i];
+         within_limits &= local < meshlet.num_vertices;
+         uint32_t vertex = set.vertices[meshlet.first_vertex + local];
+         rebuilt.push_back(vertex);
+
+         const Vec3 &pos = positions[vertex];
+         const Aabb &box = meshlet.bounds.box;
+         within_bounds &= pos.x >= box.min.x && pos.x <= box.max.x && pos.z >= box.min.z &&
+                          pos.z <= box.max.z;
+      }
+   }
+   CHECK(within_limits);
+   CHECK(within_bounds);
+   CHECK(rebuilt == indices);
+}
+
+TEST_CASE("build_meshlets of no triangles") {
+   CHECK(build_meshlets({}, {}).meshlets.empty());
+}
@@ -1,4 +1,5 @@
 #include "model.h"
+#include "geometry/meshlet.h"
 #include "stl.h"
 
 using namespace vkad;
@@ -18,9 +19,32 @@ std::vector<Triangle> Model::to_stl_triangles() const {
                   swap_yz(vertices_[indices_[i + 1]].pos),
                   swap_yz(vertices_[indices_[i + 2]].pos),
               },
-          .normal = vertices_[indices_[i]].norm,
+          .normal = vertices_[indices_[i]].norm.decode(),
       });
    }
 
    return triangles;
 }
+
+std::vector<Model> Model::split_into_meshlets() const {
+   std::vector<Vec3> positions;
+   positions.reserve(vertices_.size());
+   for (const ModelVertex &vertex : vertices_) {
+      positions.push_back(vertex.pos);
+   }
+
+   MeshletSet set = build_meshlets(positions, indices_);
+   std::vector<Model> models;
+   models.reserve(set.meshlets.size());
+   for (const Meshlet &meshlet : set.meshlets) {
+      std::vector<ModelVertex> vertices;
+      for (uint32_t i = 0; i < meshlet.num_vertices; ++i) {
+         vertices.push_back(vertices_[set.vertices[meshlet.first_vertex + i]]);
+      }
+
+      auto first = set.triangles.begin() + meshlet.first_triangle * 3;
+      std::vector<VertexIndexBuffer::IndexType> indices(first, first + meshlet.num_triangles * 3);
+      models.emplace_back(std::move(vertices), std::move(indices));
+   }
+   return models;
+}
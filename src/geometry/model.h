@@ -14,6 +14,10 @@ public:
        : Mesh(std::move(vertices), std::move(indices)) {}
 
    std::vector<Triangle> to_stl_triangles() const;
+
+   /// One model per meshlet, see build_meshlets(). Each has few enough vertices for 16-bit
+   /// indices and its own bounds, so big models can be culled piece by piece.
+   std::vector<Model> split_into_meshlets() const;
 };
 
 } // namespace vkad
@@ -0,0 +1,150 @@
+#include "bindless_set.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/status.h"
+#include "util/memory.h"
+
+using namespace vkad;
+
+BindlessSet::BindlessSet(VkDevice device, uint32_t max_images, uint32_t max_buffers)
+    : device_(device),
+      layout_(VK_NULL_HANDLE),
+      pool_(VK_NULL_HANDLE),
+      set_(VK_NULL_HANDLE),
+      image_capacity_(std::min(max_images, kMaxImages)),
+      buffer_capacity_(std::min(max_buffers, kMaxBuffers)),
+      num_images_used_(0),
+      num_buffers_used_(0) {
+
+   VkShaderStageFlags stages =
+       VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+   VkDescriptorSetLayoutBinding bindings[] = {
+       {
+           .binding = kImageBinding,
+           .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+           .descriptorCount = image_capacity_,
+           .stageFlags = stages,
+       },
+       {
+           .binding = kBufferBinding,
+           .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+           .descriptorCount = buffer_capacity_,
+           .stageFlags = stages,
+       },
+   };
+
+   // Slots that were never written may not be read, but don't have to be valid either
+   VkDescriptorBindingFlagsEXT binding_flags[] = {
+       VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+           VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT,
+       VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+           VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT,
+   };
+   VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_create = {
+       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+       .bindingCount = VKAD_ARRAY_LEN(binding_flags),
+       .pBindingFlags = binding_flags,
+   };
+
+   VkDescriptorSetLayoutCreateInfo layout_create = {
+       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+       .pNext = &flags_create,
+       .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+       .bindingCount = VKAD_ARRAY_LEN(bindings),
+       .pBindings = bindings,
+   };
+   VKAD_VK(vkCreateDescriptorSetLayout(device_, &layout_create, nullptr, &layout_));
+
+   VkDescriptorPoolSize sizes[] = {
+       {.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = image_capacity_},
+       {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = buffer_capacity_},
+   };
+   VkDescriptorPoolCreateInfo pool_create = {
+       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+       .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,
+       .maxSets = 1,
+       .poolSizeCount = VKAD_ARRAY_LEN(sizes),
+       .pPoolSizes = sizes,
+   };
+   VKAD_VK(vkCreateDescriptorPool(device_, &pool_create, nullptr, &pool_));
+
+   VkDescriptorSetAllocateInfo alloc_info = {
+       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+       .descriptorPool = pool_,
+       .descriptorSetCount = 1,
+       .pSetLayouts = &layout_,
+   };
+   VKAD_VK(vkAllocateDescriptorSets(device_, &alloc_info, &set_));
+}
+
+BindlessSet::~BindlessSet() {
+   if (pool_ != VK_NULL_HANDLE) {
+      vkDestroyDescriptorPool(device_, pool_, nullptr);
+   }
+
+   if (layout_ != VK_NULL_HANDLE) {
+      vkDestroyDescriptorSetLayout(device_, layout_, nullptr);
+   }
+}
+
+uint32_t BindlessSet::take_slot(
+    std::vector<uint32_t> &free_slots, uint32_t &num_used, uint32_t capacity
+) {
+   if (!free_slots.empty()) {
+      uint32_t slot = free_slots.back();
+      free_slots.pop_back();
+      return slot;
+   }
+
+   if (num_used == capacity) {
+      throw std::runtime_error("bindless descriptor set is full");
+   }
+   return num_used++;
+}
+
+uint32_t BindlessSet::add_image(VkSampler sampler, const Image &image) {
+   uint32_t index = take_slot(free_images_, num_images_used_, image_capacity_);
+
+   VkDescriptorImageInfo image_info = {
+       .sampler = sampler,
+       .imageView = image.view(),
+       .imageLayout = image.layout(),
+   };
+   VkWriteDescriptorSet write = {
+       .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .dstSet = set_,
+       .dstBinding = kImageBinding,
+       .dstArrayElement = index,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+       .pImageInfo = &image_info,
+   };
+   vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+   return index;
+}
+
+uint32_t BindlessSet::add_storage_buffer(const Buffer &buffer) {
+   uint32_t index = take_slot(free_buffers_, num_buffers_used_, buffer_capacity_);
+
+   VkDescriptorBufferInfo buffer_info = {
+       .buffer = buffer.buffer(),
+       .offset = 0,
+       .range = VK_WHOLE_SIZE,
+   };
+   VkWriteDescriptorSet write = {
+       .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+       .dstSet = set_,
+       .dstBinding = kBufferBinding,
+       .dstArrayElement = index,
+       .descriptorCount = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .pBufferInfo = &buffer_info,
+   };
+   vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+   return index;
+}
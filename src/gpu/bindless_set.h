@@ -0,0 +1,81 @@
+#ifndef VKAD_GPU_BINDLESS_SET_H_
+#define VKAD_GPU_BINDLESS_SET_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/buffer.h"
+#include "gpu/image.h"
+
+namespace vkad {
+
+/// One large descriptor set holding every sampled image and storage buffer that shaders may use,
+/// bound once per command buffer. Shaders pick a resource by its index into the array at binding
+/// kImageBinding or kBufferBinding, usually passed in push constants. Needs
+/// PhysicalDevice::descriptor_indexing_supported().
+///
+/// Descriptors are written with update-after-bind, so resources can be added while command
+/// buffers that use the set are pending, as long as those command buffers don't use the slot.
+class BindlessSet {
+public:
+   static constexpr uint32_t kImageBinding = 0;
+   static constexpr uint32_t kBufferBinding = 1;
+   static constexpr uint32_t kMaxImages = 4096;
+   static constexpr uint32_t kMaxBuffers = 1024;
+
+   /// Capacities are clamped to what the device supports
+   explicit BindlessSet(VkDevice device, uint32_t max_images, uint32_t max_buffers);
+
+   BindlessSet(const BindlessSet &other) = delete;
+
+   ~BindlessSet();
+
+   BindlessSet &operator=(const BindlessSet &other) = delete;
+
+   /// Writes `image` with `sampler` to a free slot and returns its index. The image must already be
+   /// in the layout shaders read it in.
+   uint32_t add_image(VkSampler sampler, const Image &image);
+
+   uint32_t add_storage_buffer(const Buffer &buffer);
+
+   /// Frees the slot for reuse. Command buffers that use it must have completed.
+   inline void remove_image(uint32_t index) {
+      free_images_.push_back(index);
+   }
+
+   inline void remove_storage_buffer(uint32_t index) {
+      free_buffers_.push_back(index);
+   }
+
+   inline VkDescriptorSetLayout layout() const {
+      return layout_;
+   }
+
+   inline VkDescriptorSet set() const {
+      return set_;
+   }
+
+private:
+   /// Pops a free slot, or the next never used one below `capacity`
+   static uint32_t take_slot(
+       std::vector<uint32_t> &free_slots, uint32_t &num_used, uint32_t capacity
+   );
+
+   VkDevice device_;
+   VkDescriptorSetLayout layout_;
+   VkDescriptorPool pool_;
+   VkDescriptorSet set_;
+   uint32_t image_capacity_;
+   uint32_t buffer_capacity_;
+   /// Slots below these were handed out at some point, the free ones are in the free lists
+   uint32_t num_images_used_;
+   uint32_t num_buffers_used_;
+   std::vector<uint32_t> free_images_;
+   std::vector<uint32_t> free_buffers_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_GPU_BINDLESS_SET_H_
@@ -1,91 +1,119 @@
 #include "buffer.h"
 
+#include <algorithm>
 #include <cstring>
+#include <vector>
 #include <vulkan/vulkan_core.h>
 
-#include "physical_device.h"
+#include "memory_allocator.h"
 #include "status.h"
+#include "util/assert.h"
 #include "util/memory.h"
 
 using namespace vkad;
 
+void vkad::write_indices(const std::vector<uint32_t> &indices, VkIndexType type, void *dst) {
+   if (type == VK_INDEX_TYPE_UINT32) {
+      std::memcpy(dst, indices.data(), indices.size() * sizeof(uint32_t));
+      return;
+   }
+
+#ifdef VKAD_DEBUG
+   VKAD_ASSERT(
+       indices.empty() || *std::max_element(indices.begin(), indices.end()) <= UINT16_MAX,
+       "index doesn't fit in 16 bits"
+   );
+#endif
+   std::transform(
+       indices.begin(), indices.end(), static_cast<uint16_t *>(dst),
+       [](uint32_t index) { return static_cast<uint16_t>(index); }
+   );
+}
+
 Buffer::Buffer(
-    size_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlagBits memory_properties,
-    VkDevice device, const PhysicalDevice &physical_device
+    size_t size, VkBufferUsageFlags usage, MemoryUsage memory_usage, MemoryAllocator &allocator,
+    const std::vector<uint32_t> &queue_families
 )
-    : buffer_(VK_NULL_HANDLE), device_(device) {
+    : buffer_(VK_NULL_HANDLE), allocator_(&allocator), device_(allocator.device()) {
+   std::vector<uint32_t> families = queue_families;
+   std::sort(families.begin(), families.end());
+   families.erase(std::unique(families.begin(), families.end()), families.end());
+   concurrent_ = families.size() > 1;
+
    VkBufferCreateInfo create_info = {
        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
        .size = size,
        .usage = usage,
-       .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+       .sharingMode = concurrent_ ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+       .queueFamilyIndexCount = concurrent_ ? static_cast<uint32_t>(families.size()) : 0,
+       .pQueueFamilyIndices = concurrent_ ? families.data() : nullptr,
    };
-   VKAD_VK(vkCreateBuffer(device, &create_info, nullptr, &buffer_));
+   VKAD_VK(vkCreateBuffer(device_, &create_info, nullptr, &buffer_));
 
    VkMemoryRequirements requirements;
-   vkGetBufferMemoryRequirements(device, buffer_, &requirements);
+   vkGetBufferMemoryRequirements(device_, buffer_, &requirements);
 
-   VkMemoryAllocateInfo alloc_info = {
-       .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-       .allocationSize = requirements.size,
-       .memoryTypeIndex =
-           physical_device.find_memory_type_index(requirements.memoryTypeBits, memory_properties),
-   };
-
-   VKAD_VK(vkAllocateMemory(device, &alloc_info, nullptr, &allocation_));
-   VKAD_VK(vkBindBufferMemory(device, buffer_, allocation_, 0));
+   allocation_ = allocator.allocate(requirements, memory_usage, true);
+   VKAD_VK(vkBindBufferMemory(device_, buffer_, allocation_.memory, allocation_.offset));
 }
 
 Buffer &Buffer::operator=(Buffer &&other) {
    vkDestroyBuffer(device_, buffer_, nullptr);
-   vkFreeMemory(device_, allocation_, nullptr);
+   allocator_->free(allocation_);
 
    buffer_ = other.buffer_;
    allocation_ = other.allocation_;
+   allocator_ = other.allocator_;
    device_ = other.device_;
+   concurrent_ = other.concurrent_;
    other.buffer_ = VK_NULL_HANDLE;
-   other.allocation_ = VK_NULL_HANDLE;
+   other.allocation_.memory = VK_NULL_HANDLE;
    other.device_ = VK_NULL_HANDLE;
    return *this;
 }
 
-StagingBuffer::StagingBuffer(
-    VkDeviceSize capacity, VkDevice device, const PhysicalDevice &physical_device
-)
+StagingBuffer::StagingBuffer(VkDeviceSize capacity, MemoryAllocator &allocator)
     : Buffer(
           capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-          static_cast<VkMemoryPropertyFlagBits>(
-              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-          ),
-          device, physical_device
+          MemoryUsage::UPLOAD, allocator
       ),
-      capacity_(capacity), size_(0) {
-   vkMapMemory(device, allocation_, 0, capacity, 0, &mem_map_);
-}
+      ring_(capacity), mem_map_(allocation_.mapped) {}
 
-void StagingBuffer::upload_mesh(
-    void *vertices, size_t vertices_size, VertexIndexBuffer::IndexType *indices,
-    VertexIndexBuffer::IndexType num_indices
-) {
-   VkDeviceSize indices_size = num_indices * sizeof(VertexIndexBuffer::IndexType);
-   VkDeviceSize total_size = vertices_size + indices_size;
-   size_ = total_size;
+UniformRing::UniformRing(
+    VkDeviceSize frame_capacity, int num_frames, MemoryAllocator &allocator
+)
+    : Buffer(
+          frame_capacity * num_frames, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+          MemoryUsage::DYNAMIC, allocator
+      ),
+      frame_capacity_(frame_capacity),
+      alignment_(allocator.physical_device().min_uniform_alignment()), frame_(0), used_(0),
+      mem_map_(allocation_.mapped) {}
 
-   std::memcpy(mem_map_, vertices, vertices_size);
-   std::memcpy(reinterpret_cast<uint8_t *>(mem_map_) + vertices_size, indices, indices_size);
+void UniformRing::copy_current_frame(const UniformRing &other) {
+   frame_ = other.frame_;
+   used_ = other.used_;
+   std::memcpy(
+       reinterpret_cast<uint8_t *>(mem_map_) + frame_base(frame_),
+       reinterpret_cast<const uint8_t *>(other.mem_map_) + other.frame_base(frame_), used_
+   );
 }
 
+IndirectBuffer::IndirectBuffer(uint32_t capacity, MemoryAllocator &allocator)
+    : Buffer(
+          capacity * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+          MemoryUsage::DYNAMIC, allocator
+      ),
+      capacity_(capacity), mem_map_(allocation_.mapped) {}
+
 UniformBuffer::UniformBuffer(
-    VkDeviceSize element_size, VkDeviceSize num_elements, VkDevice device,
-    const PhysicalDevice &physical_device
+    VkDeviceSize element_size, VkDeviceSize num_elements, VkDeviceSize num_frames,
+    MemoryAllocator &allocator
 )
     : Buffer(
-          align_to(element_size, physical_device.min_uniform_alignment()) * num_elements,
-          VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-          static_cast<VkMemoryPropertyFlagBits>(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT), device,
-          physical_device
+          align_to(element_size, allocator.physical_device().min_uniform_alignment()) *
+              num_elements * num_frames,
+          VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, MemoryUsage::DYNAMIC, allocator
       ),
-      element_size_(align_to(element_size, physical_device.min_uniform_alignment())) {
-
-   vkMapMemory(device, allocation_, 0, element_size_ * num_elements, 0, &mem_map_);
-}
+      element_size_(align_to(element_size, allocator.physical_device().min_uniform_alignment())),
+      frame_size_(element_size_ * num_elements), mem_map_(allocation_.mapped) {}
@@ -1,23 +1,29 @@
 #ifndef VKAD_GPU_BUFFER_H_
 #define VKAD_GPU_BUFFER_H_
 
-#include "gpu/physical_device.h"
+#include "gpu/memory_allocator.h"
+#include "util/memory.h"
+#include "util/ring_allocator.h"
 #include "vulkan/vulkan_core.h"
 #include <cstring>
+#include <vector>
 
 namespace vkad {
 
 class Buffer {
 public:
+   /// Passing more than one distinct queue family in `queue_families` creates the buffer with
+   /// VK_SHARING_MODE_CONCURRENT, so those queues can use it without ownership transfers.
    explicit Buffer(
-       size_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlagBits memory_properties,
-       VkDevice device, const PhysicalDevice &physical_device
+       size_t size, VkBufferUsageFlags usage, MemoryUsage memory_usage, MemoryAllocator &allocator,
+       const std::vector<uint32_t> &queue_families = {}
    );
 
    explicit Buffer(Buffer &&other)
-       : allocation_(other.allocation_), device_(other.device_), buffer_(other.buffer_) {
+       : allocation_(other.allocation_), allocator_(other.allocator_), device_(other.device_),
+         buffer_(other.buffer_), concurrent_(other.concurrent_) {
 
-      other.allocation_ = VK_NULL_HANDLE;
+      other.allocation_.memory = VK_NULL_HANDLE;
       other.buffer_ = VK_NULL_HANDLE;
    }
 
@@ -26,9 +32,7 @@ public:
          vkDestroyBuffer(device_, buffer_, nullptr);
       }
 
-      if (allocation_ != VK_NULL_HANDLE) {
-         vkFreeMemory(device_, allocation_, nullptr);
-      }
+      allocator_->free(allocation_);
    }
 
    Buffer &operator=(const Buffer &other) = delete;
@@ -39,91 +43,249 @@ public:
       return buffer_;
    }
 
+   inline bool concurrent() const {
+      return concurrent_;
+   }
+
+   /// Start of the buffer in host memory, or nullptr if it isn't host visible
+   inline void *mapped() const {
+      return allocation_.mapped;
+   }
+
+   inline bool host_visible() const {
+      return allocation_.mapped != nullptr;
+   }
+
+   /// Makes host writes to the given range visible to the device, needed for non-coherent memory
+   inline void flush(VkDeviceSize offset, VkDeviceSize size) {
+      allocator_->flush(allocation_, offset, size);
+   }
+
+   /// Makes device writes to the given range visible to mapped(), needed for non-coherent memory
+   inline void invalidate(VkDeviceSize offset, VkDeviceSize size) {
+      allocator_->invalidate(allocation_, offset, size);
+   }
+
 protected:
-   VkDeviceMemory allocation_;
+   Allocation allocation_;
+   MemoryAllocator *allocator_;
    VkDevice device_;
 
 private:
    VkBuffer buffer_;
+   bool concurrent_;
 };
 
+/// 16-bit indices wherever they can address every vertex, they take half the memory and bandwidth
+inline VkIndexType index_type_for(size_t num_vertices) {
+   return num_vertices <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+inline uint32_t index_size(VkIndexType type) {
+   return type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+/// Writes `indices` to `dst` as `type`. 16-bit indices are only chosen by index_type_for(), so
+/// narrowing them never loses bits, which only debug builds check.
+void write_indices(const std::vector<uint32_t> &indices, VkIndexType type, void *dst);
+
 class VertexIndexBuffer : public Buffer {
 public:
-   using IndexType = uint16_t;
+   /// Meshes keep 32-bit indices on the CPU, on the GPU they are as wide as index_type()
+   using IndexType = uint32_t;
 
+   /// With MemoryUsage::DYNAMIC the buffer may be host visible, in which case it's written through
+   /// mapped() rather than a staging copy
    explicit inline VertexIndexBuffer(
-       size_t num_vertices, size_t vertex_size, IndexType num_indices, VkDevice device,
-       const PhysicalDevice &physical_device
+       size_t num_vertices, size_t vertex_size, uint32_t num_indices, MemoryAllocator &allocator,
+       MemoryUsage memory_usage = MemoryUsage::GPU_ONLY
    )
        : Buffer(
-             num_vertices * vertex_size + num_indices * sizeof(IndexType),
+             num_vertices * vertex_size + num_indices * index_size(index_type_for(num_vertices)),
              VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
                  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-             static_cast<VkMemoryPropertyFlagBits>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), device,
-             physical_device
+             memory_usage, allocator
          ),
-         num_vertices_(num_vertices * vertex_size), num_indices_(num_indices) {}
+         num_vertices_(num_vertices * vertex_size),
+         num_indices_(num_indices),
+         index_type_(index_type_for(num_vertices)) {}
 
    inline size_t num_vertices() const {
       return num_vertices_;
    }
 
-   inline IndexType num_indices() const {
+   inline uint32_t num_indices() const {
       return num_indices_;
    }
 
+   inline VkIndexType index_type() const {
+      return index_type_;
+   }
+
    inline VkDeviceSize index_offset() const {
       return num_vertices_;
    }
 
 private:
    size_t num_vertices_;
-   IndexType num_indices_;
+   uint32_t num_indices_;
+   VkIndexType index_type_;
 };
 
+/// Persistently mapped upload memory used as a ring. Writes go to the head of the ring, and their
+/// space is handed back once the batch of copies that read them has completed on the GPU.
 class StagingBuffer : public Buffer {
 public:
-   explicit StagingBuffer(
-       VkDeviceSize capacity, VkDevice device, const PhysicalDevice &physical_device
-   );
+   explicit StagingBuffer(VkDeviceSize capacity, MemoryAllocator &allocator);
 
-   inline void upload_raw(void *data, size_t size) const {
-      std::memcpy(mem_map_, data, size);
+   /// Copies `data` into the ring and returns its offset, or RingAllocator::kInvalidOffset if the
+   /// ring is too full.
+   inline VkDeviceSize write(const void *data, size_t size, VkDeviceSize alignment) {
+      VkDeviceSize offset = ring_.allocate(size, alignment);
+      if (offset != RingAllocator::kInvalidOffset) {
+         std::memcpy(reinterpret_cast<uint8_t *>(mem_map_) + offset, data, size);
+         flush(offset, size);
+      }
+      return offset;
    }
 
-   void upload_mesh(
-       void *vertices, size_t vertices_size, VertexIndexBuffer::IndexType *indices,
-       VertexIndexBuffer::IndexType num_indices
-   );
+   inline void close_batch(uint64_t serial) {
+      ring_.close_batch(serial);
+   }
+
+   inline void release_until(uint64_t serial) {
+      ring_.release_until(serial);
+   }
 
    inline VkDeviceSize capacity() const {
+      return ring_.capacity();
+   }
+
+   inline VkDeviceSize used() const {
+      return ring_.used();
+   }
+
+private:
+   RingAllocator ring_;
+   void *mem_map_;
+};
+
+/// Device-local per-instance vertex data for instanced draws, filled with Renderer::upload_buffer()
+class InstanceBuffer : public Buffer {
+public:
+   explicit inline InstanceBuffer(
+       uint32_t num_instances, size_t instance_size, MemoryAllocator &allocator
+   )
+       : Buffer(
+             num_instances * instance_size,
+             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+             MemoryUsage::GPU_ONLY, allocator
+         ),
+         num_instances_(num_instances) {}
+
+   inline uint32_t num_instances() const {
+      return num_instances_;
+   }
+
+private:
+   uint32_t num_instances_;
+};
+
+/// Host-visible draw commands for vkCmdDrawIndexedIndirect, rewritten by the CPU every frame
+class IndirectBuffer : public Buffer {
+public:
+   explicit IndirectBuffer(uint32_t capacity, MemoryAllocator &allocator);
+
+   inline VkDrawIndexedIndirectCommand *commands() {
+      return reinterpret_cast<VkDrawIndexedIndirectCommand *>(mem_map_);
+   }
+
+   inline uint32_t capacity() const {
       return capacity_;
    }
 
-   inline VkDeviceSize size() const {
-      return size_;
+private:
+   uint32_t capacity_;
+   void *mem_map_;
+};
+
+/// Uniform data written once per frame, with one slice per frame in flight. Allocations are bumped
+/// from the slice of the frame being prepared, whose previous contents the GPU is done with.
+/// Offsets are relative to that slice, so they stay valid when the data moves to a bigger ring.
+class UniformRing : public Buffer {
+public:
+   static constexpr uint32_t kInvalidOffset = UINT32_MAX;
+
+   explicit UniformRing(VkDeviceSize frame_capacity, int num_frames, MemoryAllocator &allocator);
+
+   /// Starts allocating from `frame`'s slice, discarding everything allocated in it before
+   inline void reset(int frame) {
+      frame_ = frame;
+      used_ = 0;
+   }
+
+   /// Returns the offset of `size` bytes in the current slice, or kInvalidOffset if it's full
+   inline uint32_t allocate(VkDeviceSize size) {
+      VkDeviceSize offset = align_to(used_, alignment_);
+      if (offset + size > frame_capacity_) {
+         return kInvalidOffset;
+      }
+
+      used_ = offset + size;
+      return static_cast<uint32_t>(offset);
+   }
+
+   inline void write(uint32_t offset, const void *data, size_t size) {
+      uint8_t *start = reinterpret_cast<uint8_t *>(mem_map_) + frame_base(frame_) + offset;
+      std::memcpy(start, data, size);
+   }
+
+   /// Flushes what was written to the current slice so far
+   inline void flush_current_frame() {
+      flush(frame_base(frame_), used_);
+   }
+
+   /// Takes over the current slice of `other`, which must be no bigger than this ring's slices
+   void copy_current_frame(const UniformRing &other);
+
+   inline VkDeviceSize frame_base(int frame) const {
+      return frame * frame_capacity_;
+   }
+
+   inline VkDeviceSize frame_capacity() const {
+      return frame_capacity_;
+   }
+
+   /// Bytes allocated in the current slice
+   inline VkDeviceSize used() const {
+      return used_;
    }
 
 private:
-   VkDeviceSize capacity_;
-   VkDeviceSize size_;
+   VkDeviceSize frame_capacity_;
+   VkDeviceSize alignment_;
+   int frame_;
+   VkDeviceSize used_;
    void *mem_map_;
 };
 
+/// Holds one slice of `num_elements` per frame in flight so the CPU can fill in the next frame's
+/// uniforms while the GPU still reads the previous ones.
 class UniformBuffer : public Buffer {
 public:
    explicit UniformBuffer(
-       VkDeviceSize element_size, VkDeviceSize num_elements, VkDevice device,
-       const PhysicalDevice &physical_device
+       VkDeviceSize element_size, VkDeviceSize num_elements, VkDeviceSize num_frames,
+       MemoryAllocator &allocator
    );
 
-   inline ~UniformBuffer() {
-      vkUnmapMemory(device_, allocation_);
+   inline void upload_memory(void *data, size_t size, size_t element_index, int frame) {
+      uint32_t offset = dynamic_offset(element_index, frame);
+      std::memcpy(reinterpret_cast<uint8_t *>(mem_map_) + offset, data, size);
+      flush(offset, size);
    }
 
-   inline void upload_memory(void *data, size_t size, size_t element_index) {
-      uint8_t *start = reinterpret_cast<uint8_t *>(mem_map_) + element_index * element_size_;
-      std::memcpy(start, data, size);
+   inline uint32_t dynamic_offset(size_t element_index, int frame) const {
+      return static_cast<uint32_t>(frame * frame_size_ + element_index * element_size_);
    }
 
    inline VkDeviceSize element_size() const {
@@ -132,6 +294,7 @@ public:
 
 private:
    VkDeviceSize element_size_;
+   VkDeviceSize frame_size_;
    void *mem_map_;
 };
 
@@ -6,13 +6,15 @@
 
 using namespace vkad;
 
-void CommandPool::init(VkDevice device, uint32_t graphics_queue_family) {
+void CommandPool::init(VkDevice device, uint32_t queue_family, VkCommandBufferLevel level) {
    device_ = device;
+   level_ = level;
 
+   // Buffers are re-recorded after every reset and never individually reset
    VkCommandPoolCreateInfo create_info = {
        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-       .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-       .queueFamilyIndex = graphics_queue_family,
+       .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+       .queueFamilyIndex = queue_family,
    };
    VKAD_VK(vkCreateCommandPool(device, &create_info, nullptr, &command_pool_));
 }
@@ -20,19 +22,39 @@ void CommandPool::init(VkDevice device, uint32_t graphics_queue_family) {
 void CommandPool::deinit() {
    if (command_pool_ != VK_NULL_HANDLE) {
       vkDestroyCommandPool(device_, command_pool_, nullptr);
+      command_pool_ = VK_NULL_HANDLE;
    }
+
+   buffers_.clear();
+   num_live_ = 0;
 }
 
-VkCommandBuffer CommandPool::allocate() {
+VkCommandBuffer CommandPool::acquire() {
+   if (num_live_ < buffers_.size()) {
+      ++num_reused_;
+      return buffers_[num_live_++];
+   }
+
    VkCommandBufferAllocateInfo alloc_info = {
        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
        .commandPool = command_pool_,
-       .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+       .level = level_,
        .commandBufferCount = 1,
    };
 
    VkCommandBuffer result;
    VKAD_VK(vkAllocateCommandBuffers(device_, &alloc_info, &result));
 
+   buffers_.push_back(result);
+   ++num_live_;
    return result;
 }
+
+void CommandPool::reset() {
+   if (num_live_ == 0) {
+      return;
+   }
+
+   VKAD_VK(vkResetCommandPool(device_, command_pool_, 0));
+   num_live_ = 0;
+}
@@ -2,24 +2,63 @@
 #define VKAD_GPU_COMMAND_POOL_H_
 
 #include <cstdint>
+#include <vector>
 
 #include <vulkan/vulkan_core.h>
 
 namespace vkad {
 
+struct CommandPoolStats {
+   /// Command buffers allocated from the driver over the pools' lifetime
+   uint32_t num_allocated;
+   /// Command buffers handed out since the last reset
+   uint32_t num_live;
+   /// Times acquire() was served by a buffer recycled from an earlier reset
+   uint64_t num_reused;
+
+   CommandPoolStats &operator+=(const CommandPoolStats &other) {
+      num_allocated += other.num_allocated;
+      num_live += other.num_live;
+      num_reused += other.num_reused;
+      return *this;
+   }
+};
+
+/// Hands out command buffers of one level that are all recycled at once by reset(), which must only
+/// be called once every submission using them has completed. Like the VkCommandPool it wraps, a
+/// pool may only be used by one thread at a time, so threads that record need a pool each.
 class CommandPool {
 public:
-   CommandPool() : command_pool_(VK_NULL_HANDLE) {}
+   CommandPool() : command_pool_(VK_NULL_HANDLE), num_live_(0), num_reused_(0) {}
 
-   void init(VkDevice device, uint32_t graphics_queue_family);
+   void init(
+       VkDevice device, uint32_t queue_family,
+       VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY
+   );
 
    void deinit();
 
-   VkCommandBuffer allocate();
+   /// Returns a command buffer in the initial state that stays valid until the next reset()
+   VkCommandBuffer acquire();
+
+   void reset();
+
+   inline CommandPoolStats stats() const {
+      return CommandPoolStats{
+          .num_allocated = static_cast<uint32_t>(buffers_.size()),
+          .num_live = num_live_,
+          .num_reused = num_reused_,
+      };
+   }
 
 private:
    VkDevice device_;
    VkCommandPool command_pool_;
+   VkCommandBufferLevel level_;
+   /// Every buffer allocated from the pool, the first `num_live_` of which are handed out
+   std::vector<VkCommandBuffer> buffers_;
+   uint32_t num_live_;
+   uint64_t num_reused_;
 };
 
 } // namespace vkad
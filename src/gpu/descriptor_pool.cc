@@ -39,6 +39,13 @@ void DescriptorPool::write(VkDescriptorSet set, const std::vector<DescriptorWrit
    for (int i = 0; i < writes.size(); ++i) {
       write_commands[i] = writes[i].write;
       write_commands[i].dstSet = set;
+
+      // The info pointers were taken before the DescriptorWrite was copied into `writes`
+      if (write_commands[i].pBufferInfo != nullptr) {
+         write_commands[i].pBufferInfo = &writes[i].buffer_info;
+      } else if (write_commands[i].pImageInfo != nullptr) {
+         write_commands[i].pImageInfo = &writes[i].image_info;
+      }
    }
 
    vkUpdateDescriptorSets(
@@ -41,6 +41,21 @@ public:
 
    VkDescriptorSet allocate(VkDescriptorSetLayout layout);
 
+   /// Pool sizes that fit `num_sets` sets with `bindings`
+   inline static std::vector<VkDescriptorPoolSize> pool_sizes(
+       const std::vector<VkDescriptorSetLayoutBinding> &bindings, uint32_t num_sets = 1
+   ) {
+      std::vector<VkDescriptorPoolSize> sizes;
+      sizes.reserve(bindings.size());
+      for (const auto &binding : bindings) {
+         sizes.push_back({
+             .type = binding.descriptorType,
+             .descriptorCount = binding.descriptorCount * num_sets,
+         });
+      }
+      return sizes;
+   }
+
    void write(VkDescriptorSet set, const std::vector<DescriptorWrite> &writes);
 
    inline static VkDescriptorSetLayoutBinding uniform_buffer_dynamic(uint32_t binding) {
@@ -52,12 +67,36 @@ public:
       };
    }
 
-   inline static VkDescriptorSetLayoutBinding combined_image_sampler(uint32_t binding) {
+   inline static VkDescriptorSetLayoutBinding combined_image_sampler(
+       uint32_t binding, VkShaderStageFlags stages = VK_SHADER_STAGE_FRAGMENT_BIT
+   ) {
       return VkDescriptorSetLayoutBinding{
           .binding = binding,
           .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
           .descriptorCount = 1,
-          .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .stageFlags = stages,
+      };
+   }
+
+   inline static VkDescriptorSetLayoutBinding storage_buffer(
+       uint32_t binding, VkShaderStageFlags stages = VK_SHADER_STAGE_COMPUTE_BIT
+   ) {
+      return VkDescriptorSetLayoutBinding{
+          .binding = binding,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount = 1,
+          .stageFlags = stages,
+      };
+   }
+
+   inline static VkDescriptorSetLayoutBinding storage_image(
+       uint32_t binding, VkShaderStageFlags stages = VK_SHADER_STAGE_COMPUTE_BIT
+   ) {
+      return VkDescriptorSetLayoutBinding{
+          .binding = binding,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+          .descriptorCount = 1,
+          .stageFlags = stages,
       };
    }
 
@@ -81,6 +120,27 @@ public:
       return write;
    }
 
+   /// `range` is the size of the uniforms one draw reads from the ring
+   inline static DescriptorWrite write_uniform_ring(const UniformRing &ring, uint32_t range) {
+      DescriptorWrite write = {
+          .buffer_info =
+              {
+                  .buffer = ring.buffer(),
+                  .offset = 0,
+                  .range = range,
+              },
+          .write =
+              {
+                  .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                  .dstBinding = 0,
+                  .descriptorCount = 1,
+                  .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                  .pBufferInfo = &write.buffer_info,
+              },
+      };
+      return write;
+   }
+
    inline static DescriptorWrite
    write_combined_image_sampler(VkSampler sampler, const Image &image) {
       DescriptorWrite write = {
@@ -102,6 +162,70 @@ public:
       return write;
    }
 
+   /// Like write_combined_image_sampler(), for a view other than Image::view() at any binding
+   inline static DescriptorWrite write_image_view(
+       uint32_t binding, VkSampler sampler, VkImageView view, VkImageLayout layout
+   ) {
+      DescriptorWrite write = {
+          .image_info =
+              {
+                  .sampler = sampler,
+                  .imageView = view,
+                  .imageLayout = layout,
+              },
+          .write =
+              {
+                  .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                  .dstBinding = binding,
+                  .descriptorCount = 1,
+                  .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                  .pImageInfo = &write.image_info,
+              },
+      };
+      return write;
+   }
+
+   /// Storage images are always accessed in VK_IMAGE_LAYOUT_GENERAL
+   inline static DescriptorWrite write_storage_image(uint32_t binding, VkImageView view) {
+      DescriptorWrite write = {
+          .image_info =
+              {
+                  .sampler = VK_NULL_HANDLE,
+                  .imageView = view,
+                  .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+              },
+          .write =
+              {
+                  .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                  .dstBinding = binding,
+                  .descriptorCount = 1,
+                  .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                  .pImageInfo = &write.image_info,
+              },
+      };
+      return write;
+   }
+
+   inline static DescriptorWrite write_storage_buffer(uint32_t binding, const Buffer &buf) {
+      DescriptorWrite write = {
+          .buffer_info =
+              {
+                  .buffer = buf.buffer(),
+                  .offset = 0,
+                  .range = VK_WHOLE_SIZE,
+              },
+          .write =
+              {
+                  .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                  .dstBinding = binding,
+                  .descriptorCount = 1,
+                  .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                  .pBufferInfo = &write.buffer_info,
+              },
+      };
+      return write;
+   }
+
 private:
    VkDevice device_;
    VkDescriptorPool descriptor_pool_;
@@ -1,6 +1,7 @@
 #include "device.h"
 
 #include <set>
+#include <vector>
 
 #include "instance.h"
 #include "status.h"
@@ -11,7 +12,9 @@ using namespace vkad;
 
 Device::Device(const PhysicalDevice &physical_device) {
    std::set<uint32_t> unique_queue_families = {
-       physical_device.graphics_queue(), physical_device.present_queue()
+       physical_device.graphics_queue(),
+       physical_device.present_queue(),
+       physical_device.transfer_queue(),
    };
 
    std::vector<VkDeviceQueueCreateInfo> create_queues;
@@ -27,25 +30,60 @@ Device::Device(const PhysicalDevice &physical_device) {
       });
    }
 
-   VkPhysicalDeviceFeatures physical_device_features = {};
+   // Optional features, the renderer checks PhysicalDevice::features() before relying on them
+   VkPhysicalDeviceFeatures physical_device_features = {
+       .multiDrawIndirect = physical_device.features().multiDrawIndirect,
+   };
+
+   std::vector<const char *> extensions;
+   if (!physical_device.headless()) {
+      extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+   }
+   if (physical_device.memory_budget_supported()) {
+      extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+   }
+   if (physical_device.draw_indirect_count_supported()) {
+      extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+   }
+
+   // Only what bindless descriptor sets use, see PhysicalDevice::descriptor_indexing_supported()
+   VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features = {
+       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+   };
+   if (physical_device.descriptor_indexing_supported()) {
+      extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+      indexing_features.runtimeDescriptorArray = VK_TRUE;
+      indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+      indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+      indexing_features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+   }
 
-   static const char *swapchain_extension = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
    VkDeviceCreateInfo create_info = {
        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+       .pNext = physical_device.descriptor_indexing_supported() ? &indexing_features : nullptr,
        .queueCreateInfoCount = static_cast<uint32_t>(create_queues.size()),
        .pQueueCreateInfos = create_queues.data(),
 #ifdef VKAD_DEBUG
        .enabledLayerCount = VKAD_ARRAY_LEN(kValidationLayers),
        .ppEnabledLayerNames = kValidationLayers,
 #endif
-       .enabledExtensionCount = 1,
-       .ppEnabledExtensionNames = &swapchain_extension,
+       .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
+       .ppEnabledExtensionNames = extensions.data(),
        .pEnabledFeatures = &physical_device_features,
    };
    VKAD_VK(vkCreateDevice(physical_device.handle(), &create_info, nullptr, &device_));
 
    vkGetDeviceQueue(device_, physical_device.graphics_queue(), 0, &graphics_queue_);
    vkGetDeviceQueue(device_, physical_device.present_queue(), 0, &present_queue_);
+   vkGetDeviceQueue(device_, physical_device.transfer_queue(), 0, &transfer_queue_);
+
+   // Extension commands aren't exported by the loader
+   draw_indexed_indirect_count_ = nullptr;
+   if (physical_device.draw_indirect_count_supported()) {
+      draw_indexed_indirect_count_ = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+          vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR")
+      );
+   }
 }
 
 Device::~Device() {
@@ -24,14 +24,26 @@ public:
       return present_queue_;
    }
 
+   inline VkQueue transfer_queue() const {
+      return transfer_queue_;
+   }
+
    inline void wait_idle() const {
       vkDeviceWaitIdle(device_);
    }
 
+   /// vkCmdDrawIndexedIndirectCountKHR, or nullptr unless
+   /// PhysicalDevice::draw_indirect_count_supported()
+   inline PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count() const {
+      return draw_indexed_indirect_count_;
+   }
+
 private:
    VkDevice device_;
    VkQueue graphics_queue_;
    VkQueue present_queue_;
+   VkQueue transfer_queue_;
+   PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count_;
 };
 
 } // namespace vkad
@@ -0,0 +1,65 @@
+#include "geometry_arena.h"
+
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/buffer.h"
+
+using namespace vkad;
+
+namespace {
+
+constexpr VkBufferUsageFlags kArenaUsage =
+    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+    VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+} // namespace
+
+GeometryArena::GeometryArena(
+    uint32_t vertex_size, uint32_t max_vertices, uint32_t max_indices,
+    const std::vector<uint32_t> &queue_families, MemoryAllocator &allocator
+)
+    : vertex_size_(vertex_size),
+      vertices_(
+          std::bit_ceil(max_vertices) * static_cast<VkDeviceSize>(vertex_size), kArenaUsage,
+          MemoryUsage::GPU_ONLY, allocator, queue_families
+      ),
+      indices_(
+          std::bit_ceil(max_indices) * static_cast<VkDeviceSize>(index_size(kIndexType)),
+          kArenaUsage, MemoryUsage::GPU_ONLY, allocator, queue_families
+      ),
+      vertex_space_(std::bit_ceil(max_vertices), kMinBlockElements),
+      index_space_(std::bit_ceil(max_indices), kMinBlockElements) {}
+
+bool GeometryArena::allocate(uint32_t num_vertices, uint32_t num_indices, ArenaRange *range) {
+   if (index_type_for(num_vertices) != kIndexType) {
+      return false;
+   }
+
+   uint64_t first_vertex = vertex_space_.allocate(num_vertices, 1);
+   if (first_vertex == BuddyAllocator::kInvalidOffset) {
+      return false;
+   }
+
+   uint64_t first_index = index_space_.allocate(num_indices, 1);
+   if (first_index == BuddyAllocator::kInvalidOffset) {
+      vertex_space_.free(first_vertex);
+      return false;
+   }
+
+   *range = ArenaRange{
+       .first_vertex = static_cast<uint32_t>(first_vertex),
+       .num_vertices = num_vertices,
+       .first_index = static_cast<uint32_t>(first_index),
+       .num_indices = num_indices,
+   };
+   return true;
+}
+
+void GeometryArena::free(const ArenaRange &range) {
+   vertex_space_.free(range.first_vertex);
+   index_space_.free(range.first_index);
+}
@@ -0,0 +1,68 @@
+#ifndef VKAD_GPU_GEOMETRY_ARENA_H_
+#define VKAD_GPU_GEOMETRY_ARENA_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/buffer.h"
+#include "gpu/memory_allocator.h"
+#include "util/buddy_allocator.h"
+
+namespace vkad {
+
+/// Where a mesh's vertices and indices live inside a GeometryArena, in elements rather than bytes
+/// so the values can go straight into a draw command.
+struct ArenaRange {
+   uint32_t first_vertex;
+   uint32_t num_vertices;
+   uint32_t first_index;
+   uint32_t num_indices;
+};
+
+/// One device-local vertex buffer and one index buffer shared by many meshes with the same vertex
+/// layout. Meshes in the same arena can be drawn with a single indirect draw because nothing has
+/// to be rebound between them.
+///
+/// Indices are relative to the mesh's first vertex and always 16-bit, so meshes with more than
+/// 65536 vertices don't fit and get a buffer of their own instead.
+class GeometryArena {
+public:
+   static constexpr uint64_t kMinBlockElements = 64;
+   static constexpr VkIndexType kIndexType = VK_INDEX_TYPE_UINT16;
+
+   explicit GeometryArena(
+       uint32_t vertex_size, uint32_t max_vertices, uint32_t max_indices,
+       const std::vector<uint32_t> &queue_families, MemoryAllocator &allocator
+   );
+
+   /// Returns false if there isn't enough contiguous space left for the mesh, or if its indices
+   /// don't fit in kIndexType
+   bool allocate(uint32_t num_vertices, uint32_t num_indices, ArenaRange *range);
+
+   void free(const ArenaRange &range);
+
+   inline uint32_t vertex_size() const {
+      return vertex_size_;
+   }
+
+   inline Buffer &vertex_buffer() {
+      return vertices_;
+   }
+
+   inline Buffer &index_buffer() {
+      return indices_;
+   }
+
+private:
+   uint32_t vertex_size_;
+   Buffer vertices_;
+   Buffer indices_;
+   BuddyAllocator vertex_space_;
+   BuddyAllocator index_space_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_GPU_GEOMETRY_ARENA_H_
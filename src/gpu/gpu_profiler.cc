@@ -0,0 +1,185 @@
+#include "gpu_profiler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/physical_device.h"
+#include "status.h"
+#include "util/assert.h"
+#include "util/stats.h"
+
+using namespace vkad;
+
+GpuProfiler::GpuProfiler(VkDevice device, const PhysicalDevice &physical_device, int num_frames)
+    : device_(device),
+      ns_per_tick_(physical_device.properties().limits.timestampPeriod),
+      timestamp_mask_(
+          physical_device.timestamp_valid_bits() >= 64
+              ? UINT64_MAX
+              : (uint64_t(1) << physical_device.timestamp_valid_bits()) - 1
+      ),
+      frames_(num_frames),
+      current_frame_(0),
+      open_scopes_(0) {
+   VKAD_ASSERT(supported(physical_device), "the graphics queue can't write timestamps");
+
+   VkQueryPoolCreateInfo pool_create = {
+       .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+       .queryType = VK_QUERY_TYPE_TIMESTAMP,
+       .queryCount = kMaxScopesPerFrame * 2,
+   };
+   for (Frame &frame : frames_) {
+      VKAD_VK(vkCreateQueryPool(device_, &pool_create, nullptr, &frame.pool));
+      frame.num_queries = 0;
+   }
+}
+
+GpuProfiler::~GpuProfiler() {
+   for (const Frame &frame : frames_) {
+      vkDestroyQueryPool(device_, frame.pool, nullptr);
+   }
+}
+
+void GpuProfiler::collect(int frame_index) {
+   // The last frame's totals stay readable until another frame's results are read
+   Frame &frame = frames_[frame_index];
+   if (frame.scopes.empty()) {
+      return;
+   }
+
+   timestamps_.resize(frame.num_queries);
+   VkResult result = vkGetQueryPoolResults(
+       device_, frame.pool, 0, frame.num_queries, timestamps_.size() * sizeof(uint64_t),
+       timestamps_.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT
+   );
+   if (result == VK_NOT_READY) {
+      // Only happens if the frame was never submitted, its scopes are dropped
+      frame.scopes.clear();
+      return;
+   }
+   VKAD_VK(result);
+
+   frame_totals_.assign(stats_.size(), -1.0f);
+   for (const Scope &scope : frame.scopes) {
+      if (scope.end_query == UINT32_MAX) {
+         continue;
+      }
+
+      // Timestamps only count up in their valid bits, and may wrap around between the two
+      uint64_t ticks =
+          (timestamps_[scope.end_query] - timestamps_[scope.begin_query]) & timestamp_mask_;
+      float ms = static_cast<float>(ticks) * ns_per_tick_ / 1e6f;
+      frame_totals_[scope.name] = std::max(frame_totals_[scope.name], 0.0f) + ms;
+      stats_[scope.name].depth = scope.depth;
+   }
+
+   for (int i = 0; i < frame_totals_.size(); ++i) {
+      if (frame_totals_[i] >= 0) {
+         stats_[i].ms.push(frame_totals_[i]);
+      }
+   }
+   frame.scopes.clear();
+}
+
+void GpuProfiler::begin_frame(VkCommandBuffer cmd_buf, int frame_index) {
+   VKAD_ASSERT(open_scopes_ == 0, "the previous frame left scopes open");
+   current_frame_ = frame_index;
+
+   Frame &frame = frames_[frame_index];
+   frame.scopes.clear();
+   frame.num_queries = 0;
+   vkCmdResetQueryPool(cmd_buf, frame.pool, 0, kMaxScopesPerFrame * 2);
+}
+
+int GpuProfiler::begin_scope(VkCommandBuffer cmd_buf, const std::string &name) {
+   Frame &frame = frames_[current_frame_];
+   if (frame.num_queries + 2 > kMaxScopesPerFrame * 2) {
+      return -1;
+   }
+   ++open_scopes_;
+
+   uint32_t query = frame.num_queries;
+   frame.num_queries += 2;
+   vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.pool, query);
+   frame.scopes.push_back({
+       .name = intern(name),
+       .depth = open_scopes_ - 1,
+       .begin_query = query,
+       .end_query = UINT32_MAX,
+   });
+   return static_cast<int>(frame.scopes.size()) - 1;
+}
+
+void GpuProfiler::end_scope(VkCommandBuffer cmd_buf, int scope_index) {
+   if (scope_index == -1) {
+      return;
+   }
+   VKAD_ASSERT(open_scopes_ > 0, "end_scope() without begin_scope()");
+   --open_scopes_;
+
+   Frame &frame = frames_[current_frame_];
+   Scope &scope = frame.scopes[scope_index];
+   // Everything recorded before has to finish, not merely start
+   scope.end_query = scope.begin_query + 1;
+   vkCmdWriteTimestamp(
+       cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.pool, scope.end_query
+   );
+}
+
+float GpuProfiler::collected_ms(const std::string &name) const {
+   auto it = name_ids_.find(name);
+   if (it == name_ids_.end() || it->second >= frame_totals_.size()) {
+      return -1;
+   }
+   return frame_totals_[it->second];
+}
+
+std::vector<GpuScopeStats> GpuProfiler::stats() const {
+   std::vector<GpuScopeStats> result;
+   for (const NamedStats &named : stats_) {
+      result.push_back({
+          .name = named.name,
+          .depth = named.depth,
+          .last_ms = named.ms.last(),
+          .min_ms = named.ms.min(),
+          .mean_ms = named.ms.mean(),
+          .max_ms = named.ms.max(),
+      });
+   }
+   return result;
+}
+
+std::string GpuProfiler::overlay_text() const {
+   std::string text = "GPU ms: last / min / avg / max\n";
+   for (const GpuScopeStats &scope : stats()) {
+      text += std::format(
+          "{}{}: {:.2f} / {:.2f} / {:.2f} / {:.2f}\n", std::string(scope.depth * 2, ' '),
+          scope.name, scope.last_ms, scope.min_ms, scope.mean_ms, scope.max_ms
+      );
+   }
+   return text;
+}
+
+std::string GpuProfiler::dump_csv() const {
+   std::string csv = "scope,depth,last_ms,min_ms,mean_ms,max_ms\n";
+   for (const GpuScopeStats &scope : stats()) {
+      csv += std::format(
+          "{},{},{:.4f},{:.4f},{:.4f},{:.4f}\n", scope.name, scope.depth, scope.last_ms,
+          scope.min_ms, scope.mean_ms, scope.max_ms
+      );
+   }
+   return csv;
+}
+
+int GpuProfiler::intern(const std::string &name) {
+   auto [it, inserted] = name_ids_.try_emplace(name, static_cast<int>(stats_.size()));
+   if (inserted) {
+      stats_.push_back({.name = name, .depth = 0, .ms = RollingStats(kHistory)});
+   }
+   return it->second;
+}
@@ -0,0 +1,124 @@
+#ifndef VKAD_GPU_GPU_PROFILER_H_
+#define VKAD_GPU_GPU_PROFILER_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/physical_device.h"
+#include "util/stats.h"
+
+namespace vkad {
+
+/// GPU time of one named scope over the last GpuProfiler::kHistory frames that recorded it
+struct GpuScopeStats {
+   std::string name;
+   /// Nesting depth of the scope when it was last recorded, 0 for outermost scopes
+   int depth;
+   float last_ms;
+   float min_ms;
+   float mean_ms;
+   float max_ms;
+};
+
+/// Measures how long named scopes of command buffers take on the GPU with timestamp queries. Each
+/// frame in flight has its own query pool that is only read back once the frame's fence has
+/// signalled, so reading results never waits for the GPU. Scopes with the same name in one frame
+/// add up, so a material drawn in several batches reports its total.
+///
+/// Timestamps inside a render pass are only as precise as the GPU allows, tiled GPUs may report
+/// the time of a whole render pass for the scopes in it.
+class GpuProfiler {
+public:
+   static constexpr uint32_t kMaxScopesPerFrame = 256;
+   static constexpr int kHistory = 120;
+
+   /// The graphics queue family must support timestamps, see supported()
+   explicit GpuProfiler(VkDevice device, const PhysicalDevice &physical_device, int num_frames);
+
+   GpuProfiler(const GpuProfiler &other) = delete;
+
+   ~GpuProfiler();
+
+   GpuProfiler &operator=(const GpuProfiler &other) = delete;
+
+   static inline bool supported(const PhysicalDevice &physical_device) {
+      return physical_device.timestamp_valid_bits() != 0 &&
+             physical_device.properties().limits.timestampPeriod > 0;
+   }
+
+   /// Adds the results of `frame`'s previous submission to the statistics, and makes them what
+   /// collected_ms() returns. Does nothing if that submission recorded no scopes. The frame's fence
+   /// must have signalled.
+   void collect(int frame);
+
+   /// Resets the queries of `frame` for recording into `cmd_buf`. Must be recorded outside of a
+   /// render pass before the frame's first scope.
+   void begin_frame(VkCommandBuffer cmd_buf, int frame);
+
+   /// Starts a scope and returns the handle that ends it. Scopes must be ended in the reverse order
+   /// they were begun. Once a frame runs out of queries, further scopes are not measured and get
+   /// the handle -1, which end_scope() ignores.
+   int begin_scope(VkCommandBuffer cmd_buf, const std::string &name);
+
+   void end_scope(VkCommandBuffer cmd_buf, int scope);
+
+   /// Milliseconds the scopes named `name` took in the frame the last collect() read, or a negative
+   /// number if that frame didn't record any. Lets callers keep every sample rather than the last
+   /// kHistory.
+   float collected_ms(const std::string &name) const;
+
+   /// Every scope seen so far, in the order they were first recorded
+   std::vector<GpuScopeStats> stats() const;
+
+   /// One line per scope for the screen: name, last, min, mean and max milliseconds, indented by
+   /// nesting depth
+   std::string overlay_text() const;
+
+   /// stats() as CSV with a header line, for scripts
+   std::string dump_csv() const;
+
+private:
+   struct Scope {
+      int name;
+      int depth;
+      uint32_t begin_query;
+      /// Query of the end timestamp, UINT32_MAX while the scope is open
+      uint32_t end_query;
+   };
+
+   struct Frame {
+      VkQueryPool pool;
+      std::vector<Scope> scopes;
+      uint32_t num_queries;
+   };
+
+   struct NamedStats {
+      std::string name;
+      int depth;
+      RollingStats ms;
+   };
+
+   int intern(const std::string &name);
+
+   VkDevice device_;
+   float ns_per_tick_;
+   uint64_t timestamp_mask_;
+   std::vector<Frame> frames_;
+   /// Frame being recorded
+   int current_frame_;
+   int open_scopes_;
+   std::unordered_map<std::string, int> name_ids_;
+   std::vector<NamedStats> stats_;
+   /// Scratch space for collect()
+   std::vector<uint64_t> timestamps_;
+   /// Milliseconds per name in the last collected frame, -1 for names it didn't record
+   std::vector<float> frame_totals_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_GPU_GPU_PROFILER_H_
@@ -6,21 +6,22 @@
 #include "vendor/stb_image.h"
 
 #include "status.h"
+#include "util/assert.h"
 
 using namespace vkad;
 
 Image::Image(
-    const PhysicalDevice &physical_device, VkDevice device, VkImageUsageFlags usage,
-    VkFormat format, uint32_t width, uint32_t height
+    MemoryAllocator &allocator, VkImageUsageFlags usage, VkFormat format, uint32_t width,
+    uint32_t height, uint32_t mip_levels, MemoryUsage memory_usage
 )
-    : view_(VK_NULL_HANDLE), format_(format), device_(device), layout_(VK_IMAGE_LAYOUT_UNDEFINED),
-      width_(width), height_(height) {
+    : view_(VK_NULL_HANDLE), format_(format), allocator_(&allocator), device_(allocator.device()),
+      layout_(VK_IMAGE_LAYOUT_UNDEFINED), width_(width), height_(height), mip_levels_(mip_levels) {
    VkImageCreateInfo image_create = {
        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
        .imageType = VK_IMAGE_TYPE_2D,
        .format = format,
        .extent = {width, height, 1},
-       .mipLevels = 1,
+       .mipLevels = mip_levels,
        .arrayLayers = 1,
        .samples = VK_SAMPLE_COUNT_1_BIT,
        .tiling = VK_IMAGE_TILING_OPTIMAL,
@@ -28,21 +29,34 @@ Image::Image(
        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
    };
-   VKAD_VK(vkCreateImage(device, &image_create, nullptr, &image_));
+   VKAD_VK(vkCreateImage(device_, &image_create, nullptr, &image_));
 
    VkMemoryRequirements img_mem;
-   vkGetImageMemoryRequirements(device, image_, &img_mem);
-
-   VkMemoryAllocateInfo alloc = {
-       .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-       .allocationSize = img_mem.size,
-       .memoryTypeIndex = physical_device.find_memory_type_index(
-           img_mem.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-       ),
-   };
+   vkGetImageMemoryRequirements(device_, image_, &img_mem);
 
-   VKAD_VK(vkAllocateMemory(device, &alloc, nullptr, &allocation_));
-   VKAD_VK(vkBindImageMemory(device, image_, allocation_, 0));
+   allocation_ = allocator.allocate(img_mem, memory_usage, false);
+   VKAD_VK(vkBindImageMemory(device_, image_, allocation_.memory, allocation_.offset));
+}
+
+Image::Image(
+    VkDevice device, VkImageUsageFlags usage, VkFormat format, uint32_t width, uint32_t height
+)
+    : view_(VK_NULL_HANDLE), format_(format), allocation_(), allocator_(nullptr), width_(width),
+      height_(height), mip_levels_(1), device_(device), layout_(VK_IMAGE_LAYOUT_UNDEFINED) {
+   VkImageCreateInfo image_create = {
+       .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+       .imageType = VK_IMAGE_TYPE_2D,
+       .format = format,
+       .extent = {width, height, 1},
+       .mipLevels = 1,
+       .arrayLayers = 1,
+       .samples = VK_SAMPLE_COUNT_1_BIT,
+       .tiling = VK_IMAGE_TILING_OPTIMAL,
+       .usage = usage,
+       .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+       .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+   };
+   VKAD_VK(vkCreateImage(device_, &image_create, nullptr, &image_));
 }
 
 Image::~Image() {
@@ -51,7 +65,20 @@ Image::~Image() {
    }
 
    vkDestroyImage(device_, image_, nullptr);
-   vkFreeMemory(device_, allocation_, nullptr);
+   if (allocator_ != nullptr) {
+      allocator_->free(allocation_);
+   }
+}
+
+VkMemoryRequirements Image::memory_requirements() const {
+   VkMemoryRequirements requirements;
+   vkGetImageMemoryRequirements(device_, image_, &requirements);
+   return requirements;
+}
+
+void Image::bind_memory(VkDeviceMemory memory, VkDeviceSize offset) {
+   VKAD_ASSERT(allocator_ == nullptr, "the image already has memory of its own");
+   VKAD_VK(vkBindImageMemory(device_, image_, memory, offset));
 }
 
 void Image::init_view() {
@@ -62,9 +89,9 @@ void Image::init_view() {
        .format = format_,
        .subresourceRange =
            {
-               .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+               .aspectMask = aspect(),
                .baseMipLevel = 0,
-               .levelCount = 1,
+               .levelCount = mip_levels_,
                .baseArrayLayer = 0,
                .layerCount = 1,
            },
@@ -72,6 +99,28 @@ void Image::init_view() {
    VKAD_VK(vkCreateImageView(device_, &view_create, nullptr, &view_));
 }
 
+VkImageView Image::create_mip_view(uint32_t level) const {
+   VkImageViewCreateInfo view_create = {
+       .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+       .image = image_,
+       .viewType = VK_IMAGE_VIEW_TYPE_2D,
+       .format = format_,
+       .subresourceRange =
+           {
+               // Shaders can only read one aspect through a view
+               .aspectMask = aspect() & ~VK_IMAGE_ASPECT_STENCIL_BIT,
+               .baseMipLevel = level,
+               .levelCount = 1,
+               .baseArrayLayer = 0,
+               .layerCount = 1,
+           },
+   };
+
+   VkImageView view;
+   VKAD_VK(vkCreateImageView(device_, &view_create, nullptr, &view));
+   return view;
+}
+
 void Image::queue_transfer_layout(VkImageLayout layout, VkCommandBuffer cmd_buf) {
    VkImageMemoryBarrier barrier = {
        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -82,9 +131,9 @@ void Image::queue_transfer_layout(VkImageLayout layout, VkCommandBuffer cmd_buf)
        .image = image_,
        .subresourceRange =
            {
-               .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+               .aspectMask = aspect(),
                .baseMipLevel = 0,
-               .levelCount = 1,
+               .levelCount = mip_levels_,
                .baseArrayLayer = 0,
                .layerCount = 1,
            },
@@ -124,3 +173,36 @@ void Image::queue_transfer_layout(VkImageLayout layout, VkCommandBuffer cmd_buf)
    layout_ = layout;
    vkCmdPipelineBarrier(cmd_buf, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 }
+
+VkImageMemoryBarrier Image::queue_release(
+    VkImageLayout layout, uint32_t src_family, uint32_t dst_family, VkCommandBuffer cmd_buf
+) {
+   VkImageMemoryBarrier barrier = {
+       .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+       .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+       .dstAccessMask = 0,
+       .oldLayout = layout_,
+       .newLayout = layout,
+       .srcQueueFamilyIndex = src_family,
+       .dstQueueFamilyIndex = dst_family,
+       .image = image_,
+       .subresourceRange =
+           {
+               .aspectMask = aspect(),
+               .baseMipLevel = 0,
+               .levelCount = mip_levels_,
+               .baseArrayLayer = 0,
+               .layerCount = 1,
+           },
+   };
+   vkCmdPipelineBarrier(
+       cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+       0, nullptr, 1, &barrier
+   );
+
+   layout_ = layout;
+
+   barrier.srcAccessMask = 0;
+   barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+   return barrier;
+}
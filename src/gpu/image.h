@@ -1,7 +1,7 @@
 #ifndef VKAD_GPU_IMAGE_H_
 #define VKAD_GPU_IMAGE_H_
 
-#include "gpu/physical_device.h"
+#include "gpu/memory_allocator.h"
 #include <vulkan/vulkan_core.h>
 
 namespace vkad {
@@ -9,16 +9,36 @@ namespace vkad {
 class Image {
 public:
    Image(
-       const PhysicalDevice &physical_device, VkDevice device, VkImageUsageFlags usage,
-       VkFormat format, uint32_t width, uint32_t height
+       MemoryAllocator &allocator, VkImageUsageFlags usage, VkFormat format, uint32_t width,
+       uint32_t height, uint32_t mip_levels = 1, MemoryUsage memory_usage = MemoryUsage::GPU_ONLY
    );
 
+   /// Creates the image without memory. bind_memory() places it in memory the caller owns, which
+   /// lets images that are never used at the same time share memory.
+   Image(VkDevice device, VkImageUsageFlags usage, VkFormat format, uint32_t width, uint32_t height);
+
    ~Image();
 
+   /// Creates view(), which covers every mip level
    void init_view();
 
+   /// Creates a view of mip `level` alone for shaders to read or write. The caller destroys it.
+   VkImageView create_mip_view(uint32_t level) const;
+
+   VkMemoryRequirements memory_requirements() const;
+
+   /// Binds the memory of an image created without any. `memory` must outlive the image.
+   void bind_memory(VkDeviceMemory memory, VkDeviceSize offset);
+
    void queue_transfer_layout(VkImageLayout layout, VkCommandBuffer cmd_buf);
 
+   /// Records the release half of a queue family ownership transfer that also moves the image from
+   /// VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL to `layout`. Returns the barrier that a queue of
+   /// `dst_family` must record to acquire the image before sampling it.
+   VkImageMemoryBarrier queue_release(
+       VkImageLayout layout, uint32_t src_family, uint32_t dst_family, VkCommandBuffer cmd_buf
+   );
+
    inline VkImage handle() const {
       return image_;
    }
@@ -39,13 +59,37 @@ public:
       return height_;
    }
 
+   inline uint32_t mip_levels() const {
+      return mip_levels_;
+   }
+
+   static inline VkImageAspectFlags aspect_of(VkFormat format) {
+      switch (format) {
+      case VK_FORMAT_D32_SFLOAT:
+      case VK_FORMAT_D16_UNORM:
+         return VK_IMAGE_ASPECT_DEPTH_BIT;
+      case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      case VK_FORMAT_D24_UNORM_S8_UINT:
+         return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+      default:
+         return VK_IMAGE_ASPECT_COLOR_BIT;
+      }
+   }
+
 private:
+   inline VkImageAspectFlags aspect() const {
+      return aspect_of(format_);
+   }
+
    VkImage image_;
    VkImageView view_;
    VkFormat format_;
-   VkDeviceMemory allocation_;
+   Allocation allocation_;
+   /// nullptr if the caller owns the image's memory
+   MemoryAllocator *allocator_;
    uint32_t width_;
    uint32_t height_;
+   uint32_t mip_levels_;
    VkDevice device_;
    VkImageLayout layout_;
 };
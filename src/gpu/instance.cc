@@ -46,7 +46,7 @@ Instance::Instance(const std::vector<const char *> extensions) {
        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
        .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
        .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-       .apiVersion = VK_API_VERSION_1_0,
+       .apiVersion = VK_API_VERSION_1_1,
    };
 
    VkInstanceCreateInfo create_info = {
@@ -0,0 +1,308 @@
+#include "memory_allocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <stdexcept>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/memory_type.h"
+#include "status.h"
+#include "util/memory.h"
+
+using namespace vkad;
+
+MemoryAllocator::MemoryAllocator(VkDevice device, const PhysicalDevice &physical_device)
+    : device_(device), physical_device_(physical_device),
+      mem_properties_(physical_device.memory_properties()),
+      max_device_allocations_(physical_device.properties().limits.maxMemoryAllocationCount),
+      num_device_allocations_(0), num_dedicated_allocations_(0), dedicated_bytes_(0),
+      non_coherent_atom_size_(physical_device.properties().limits.nonCoherentAtomSize),
+      heap_usage_(mem_properties_.memoryHeapCount, 0),
+      pools_(mem_properties_.memoryTypeCount * 2) {
+   update_heap_budgets();
+
+   for (uint32_t type = 0; type < mem_properties_.memoryTypeCount; ++type) {
+      uint32_t heap = mem_properties_.memoryTypes[type].heapIndex;
+      // Small heaps (e.g. the 256 MiB device-local host-visible one) get smaller blocks so a
+      // single block can't take up most of the heap
+      VkDeviceSize heap_share = std::bit_floor(mem_properties_.memoryHeaps[heap].size / 8);
+      VkDeviceSize block_size = std::clamp(heap_share, kMinAllocationSize, kDefaultBlockSize);
+
+      pool_for(type, false).block_size = block_size;
+      pool_for(type, true).block_size = block_size;
+   }
+}
+
+MemoryAllocator::~MemoryAllocator() {
+   for (int i = 0; i < pools_.size(); ++i) {
+      for (std::unique_ptr<Block> &block : pools_[i].blocks) {
+         if (block != nullptr) {
+            free_device_memory(block->memory, i / 2, pools_[i].block_size, block->mapped);
+         }
+      }
+   }
+}
+
+Allocation MemoryAllocator::allocate(
+    const VkMemoryRequirements &requirements, MemoryUsage usage, bool linear
+) {
+   int selected = select_memory_type(
+       mem_properties_, requirements.memoryTypeBits, usage, requirements.size, heap_budgets_
+   );
+   if (selected == -1) {
+      throw std::runtime_error(std::format(
+          "no suitable memory type for bits {} and usage {}", requirements.memoryTypeBits,
+          static_cast<int>(usage)
+      ));
+   }
+
+   uint32_t memory_type = selected;
+   VkMemoryPropertyFlags flags = mem_properties_.memoryTypes[memory_type].propertyFlags;
+   bool coherent = (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+   Pool &pool = pool_for(memory_type, linear);
+
+   // Flushes are rounded out to nonCoherentAtomSize, which must not reach into other allocations
+   VkDeviceSize alignment = requirements.alignment;
+   if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0 && !coherent) {
+      alignment = std::max(alignment, non_coherent_atom_size_);
+   }
+
+   // Anything that would take up most of a block isn't worth sub-allocating
+   if (requirements.size > pool.block_size / 2) {
+      void *mapped;
+      VkDeviceMemory memory = allocate_device_memory(requirements.size, memory_type, &mapped);
+      ++num_dedicated_allocations_;
+      dedicated_bytes_ += requirements.size;
+
+      return Allocation{
+          .memory = memory,
+          .offset = 0,
+          .size = requirements.size,
+          .mapped = mapped,
+          .memory_type = memory_type,
+          .block = -1,
+          .linear = linear,
+          .coherent = coherent,
+      };
+   }
+
+   int block_index = -1;
+   uint64_t offset = BuddyAllocator::kInvalidOffset;
+
+   for (int i = 0; i < pool.blocks.size(); ++i) {
+      if (pool.blocks[i] == nullptr) {
+         continue;
+      }
+
+      offset = pool.blocks[i]->buddy.allocate(requirements.size, alignment);
+      if (offset != BuddyAllocator::kInvalidOffset) {
+         block_index = i;
+         break;
+      }
+   }
+
+   if (block_index == -1) {
+      void *mapped;
+      VkDeviceMemory memory = allocate_device_memory(pool.block_size, memory_type, &mapped);
+      auto block = std::make_unique<Block>(Block{
+          .memory = memory,
+          .mapped = mapped,
+          .buddy = BuddyAllocator(pool.block_size, kMinAllocationSize),
+      });
+
+      auto empty_slot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+      block_index = empty_slot - pool.blocks.begin();
+      if (empty_slot == pool.blocks.end()) {
+         pool.blocks.emplace_back(std::move(block));
+      } else {
+         *empty_slot = std::move(block);
+      }
+
+      offset = pool.blocks[block_index]->buddy.allocate(requirements.size, alignment);
+   }
+
+   Block &block = *pool.blocks[block_index];
+   return Allocation{
+       .memory = block.memory,
+       .offset = offset,
+       .size = requirements.size,
+       .mapped =
+           block.mapped != nullptr ? reinterpret_cast<uint8_t *>(block.mapped) + offset : nullptr,
+       .memory_type = memory_type,
+       .block = block_index,
+       .linear = linear,
+       .coherent = coherent,
+   };
+}
+
+void MemoryAllocator::free(const Allocation &allocation) {
+   if (allocation.memory == VK_NULL_HANDLE) {
+      return;
+   }
+
+   if (allocation.block == -1) {
+      free_device_memory(
+          allocation.memory, allocation.memory_type, allocation.size, allocation.mapped
+      );
+      --num_dedicated_allocations_;
+      dedicated_bytes_ -= allocation.size;
+      return;
+   }
+
+   Pool &pool = pool_for(allocation.memory_type, allocation.linear);
+   std::unique_ptr<Block> &block = pool.blocks[allocation.block];
+   block->buddy.free(allocation.offset);
+
+   if (!block->buddy.empty()) {
+      return;
+   }
+
+   // Keep one empty block around so allocating and freeing a single resource doesn't thrash
+   int live_blocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const auto &b) {
+      return b != nullptr;
+   });
+
+   if (live_blocks > 1) {
+      free_device_memory(block->memory, allocation.memory_type, pool.block_size, block->mapped);
+      block.reset();
+   }
+}
+
+void MemoryAllocator::flush(const Allocation &allocation, VkDeviceSize offset, VkDeviceSize size) {
+   if (allocation.coherent || allocation.mapped == nullptr || size == 0) {
+      return;
+   }
+
+   VkMappedMemoryRange range = atom_aligned_range(allocation, offset, size);
+   VKAD_VK(vkFlushMappedMemoryRanges(device_, 1, &range));
+}
+
+void MemoryAllocator::invalidate(
+    const Allocation &allocation, VkDeviceSize offset, VkDeviceSize size
+) {
+   if (allocation.coherent || allocation.mapped == nullptr || size == 0) {
+      return;
+   }
+
+   VkMappedMemoryRange range = atom_aligned_range(allocation, offset, size);
+   VKAD_VK(vkInvalidateMappedMemoryRanges(device_, 1, &range));
+}
+
+VkMappedMemoryRange MemoryAllocator::atom_aligned_range(
+    const Allocation &allocation, VkDeviceSize offset, VkDeviceSize size
+) {
+   VkDeviceSize memory_size = allocation.block == -1
+                                  ? allocation.size
+                                  : pool_for(allocation.memory_type, allocation.linear).block_size;
+   VkDeviceSize start = allocation.offset + offset;
+   VkDeviceSize aligned_start = start / non_coherent_atom_size_ * non_coherent_atom_size_;
+   VkDeviceSize aligned_end = align_to(start + size, non_coherent_atom_size_);
+
+   return VkMappedMemoryRange{
+       .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+       .memory = allocation.memory,
+       .offset = aligned_start,
+       // The end of the memory doesn't have to be aligned, VK_WHOLE_SIZE covers it
+       .size = aligned_end >= memory_size ? VK_WHOLE_SIZE : aligned_end - aligned_start,
+   };
+}
+
+MemoryStats MemoryAllocator::stats() const {
+   MemoryStats stats = {
+       .num_device_allocations = num_device_allocations_,
+       .num_allocations = num_dedicated_allocations_,
+       .reserved_bytes = dedicated_bytes_,
+       .allocated_bytes = dedicated_bytes_,
+       .requested_bytes = dedicated_bytes_,
+   };
+
+   VkDeviceSize free_bytes = 0;
+   VkDeviceSize largest_free = 0;
+
+   for (const Pool &pool : pools_) {
+      for (const std::unique_ptr<Block> &block : pool.blocks) {
+         if (block == nullptr) {
+            continue;
+         }
+
+         stats.num_allocations += block->buddy.num_allocations();
+         stats.reserved_bytes += block->buddy.capacity();
+         stats.allocated_bytes += block->buddy.allocated_bytes();
+         stats.requested_bytes += block->buddy.requested_bytes();
+         free_bytes += block->buddy.free_bytes();
+         largest_free = std::max(largest_free, block->buddy.largest_free_block());
+      }
+   }
+
+   if (stats.allocated_bytes > 0) {
+      stats.internal_fragmentation =
+          1.0f - static_cast<float>(stats.requested_bytes) / stats.allocated_bytes;
+   }
+
+   if (free_bytes > 0) {
+      stats.external_fragmentation = 1.0f - static_cast<float>(largest_free) / free_bytes;
+   }
+
+   return stats;
+}
+
+VkDeviceMemory
+MemoryAllocator::allocate_device_memory(VkDeviceSize size, uint32_t memory_type, void **mapped) {
+   if (num_device_allocations_ >= max_device_allocations_) {
+      throw std::runtime_error(
+          std::format("reached maxMemoryAllocationCount ({})", max_device_allocations_)
+      );
+   }
+
+   VkMemoryAllocateInfo alloc_info = {
+       .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+       .allocationSize = size,
+       .memoryTypeIndex = memory_type,
+   };
+
+   VkDeviceMemory memory;
+   VKAD_VK(vkAllocateMemory(device_, &alloc_info, nullptr, &memory));
+   ++num_device_allocations_;
+   heap_usage_[mem_properties_.memoryTypes[memory_type].heapIndex] += size;
+   update_heap_budgets();
+
+   *mapped = nullptr;
+   VkMemoryPropertyFlags flags = mem_properties_.memoryTypes[memory_type].propertyFlags;
+   if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) {
+      // Memory can only be mapped once, so host-visible blocks stay mapped for their lifetime
+      VKAD_VK(vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, mapped));
+   }
+
+   return memory;
+}
+
+void MemoryAllocator::free_device_memory(
+    VkDeviceMemory memory, uint32_t memory_type, VkDeviceSize size, void *mapped
+) {
+   if (mapped != nullptr) {
+      vkUnmapMemory(device_, memory);
+   }
+
+   vkFreeMemory(device_, memory, nullptr);
+   --num_device_allocations_;
+   heap_usage_[mem_properties_.memoryTypes[memory_type].heapIndex] -= size;
+   update_heap_budgets();
+}
+
+void MemoryAllocator::update_heap_budgets() {
+   heap_budgets_ = physical_device_.heap_budgets();
+   if (!heap_budgets_.empty()) {
+      return;
+   }
+
+   // Without VK_EXT_memory_budget, assume the process may use most of each heap
+   heap_budgets_.resize(mem_properties_.memoryHeapCount);
+   for (uint32_t heap = 0; heap < mem_properties_.memoryHeapCount; ++heap) {
+      VkDeviceSize budget = mem_properties_.memoryHeaps[heap].size / 10 * 8;
+      heap_budgets_[heap] = budget > heap_usage_[heap] ? budget - heap_usage_[heap] : 0;
+   }
+}
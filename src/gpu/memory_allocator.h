@@ -0,0 +1,127 @@
+#ifndef VKAD_GPU_MEMORY_ALLOCATOR_H_
+#define VKAD_GPU_MEMORY_ALLOCATOR_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/memory_type.h"
+#include "gpu/physical_device.h"
+#include "util/buddy_allocator.h"
+
+namespace vkad {
+
+struct Allocation {
+   VkDeviceMemory memory;
+   VkDeviceSize offset;
+   VkDeviceSize size;
+   /// Start of this allocation in host memory, or nullptr if it isn't host visible
+   void *mapped;
+   uint32_t memory_type;
+   /// Index of the block in its pool, or -1 if the allocation has its own VkDeviceMemory
+   int block;
+   bool linear;
+   /// Whether host writes are visible to the device without MemoryAllocator::flush()
+   bool coherent;
+};
+
+struct MemoryStats {
+   /// Live vkAllocateMemory allocations, blocks and dedicated allocations combined
+   uint32_t num_device_allocations;
+   uint32_t num_allocations;
+   VkDeviceSize reserved_bytes;
+   VkDeviceSize allocated_bytes;
+   VkDeviceSize requested_bytes;
+   /// Fraction of allocated bytes lost to rounding allocations up to a power of two
+   float internal_fragmentation;
+   /// 1 - (largest free range / total free bytes) over all blocks
+   float external_fragmentation;
+};
+
+/// Sub-allocates buffers and images out of large VkDeviceMemory blocks so that creating a resource
+/// doesn't cost a driver allocation. Each memory type has two pools because linear (buffer) and
+/// optimal-tiling (image) resources may not share a page within `bufferImageGranularity`.
+class MemoryAllocator {
+public:
+   static constexpr VkDeviceSize kDefaultBlockSize = 64 * 1024 * 1024;
+   static constexpr VkDeviceSize kMinAllocationSize = 256;
+
+   explicit MemoryAllocator(VkDevice device, const PhysicalDevice &physical_device);
+
+   MemoryAllocator(const MemoryAllocator &other) = delete;
+
+   ~MemoryAllocator();
+
+   MemoryAllocator &operator=(const MemoryAllocator &other) = delete;
+
+   Allocation allocate(const VkMemoryRequirements &requirements, MemoryUsage usage, bool linear);
+
+   void free(const Allocation &allocation);
+
+   /// Makes host writes to `size` bytes at `offset` in a mapped allocation visible to the device.
+   /// Does nothing for coherent memory.
+   void flush(const Allocation &allocation, VkDeviceSize offset, VkDeviceSize size);
+
+   /// Makes device writes to `size` bytes at `offset` in a mapped allocation visible to the host.
+   /// Does nothing for coherent memory.
+   void invalidate(const Allocation &allocation, VkDeviceSize offset, VkDeviceSize size);
+
+   MemoryStats stats() const;
+
+   inline VkDevice device() const {
+      return device_;
+   }
+
+   inline const PhysicalDevice &physical_device() const {
+      return physical_device_;
+   }
+
+private:
+   struct Block {
+      VkDeviceMemory memory;
+      void *mapped;
+      BuddyAllocator buddy;
+   };
+
+   struct Pool {
+      VkDeviceSize block_size;
+      std::vector<std::unique_ptr<Block>> blocks;
+   };
+
+   inline Pool &pool_for(uint32_t memory_type, bool linear) {
+      return pools_[memory_type * 2 + (linear ? 1 : 0)];
+   }
+
+   VkDeviceMemory allocate_device_memory(VkDeviceSize size, uint32_t memory_type, void **mapped);
+
+   void free_device_memory(
+       VkDeviceMemory memory, uint32_t memory_type, VkDeviceSize size, void *mapped
+   );
+
+   /// Widens a range of `allocation` to whole nonCoherentAtomSize atoms of its memory
+   VkMappedMemoryRange atom_aligned_range(
+       const Allocation &allocation, VkDeviceSize offset, VkDeviceSize size
+   );
+
+   /// Refreshes heap_budgets_, called whenever device memory is allocated or freed
+   void update_heap_budgets();
+
+   VkDevice device_;
+   const PhysicalDevice &physical_device_;
+   VkPhysicalDeviceMemoryProperties mem_properties_;
+   uint32_t max_device_allocations_;
+   uint32_t num_device_allocations_;
+   uint32_t num_dedicated_allocations_;
+   VkDeviceSize dedicated_bytes_;
+   VkDeviceSize non_coherent_atom_size_;
+   /// Bytes of device memory allocated from each heap
+   std::vector<VkDeviceSize> heap_usage_;
+   std::vector<VkDeviceSize> heap_budgets_;
+   std::vector<Pool> pools_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_GPU_MEMORY_ALLOCATOR_H_
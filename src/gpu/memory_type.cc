@@ -0,0 +1,91 @@
+#include "memory_type.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+using namespace vkad;
+
+namespace {
+
+constexpr int kUnusable = INT32_MIN;
+constexpr int kOverBudgetPenalty = 1000;
+
+int score_memory_type(VkMemoryPropertyFlags flags, MemoryUsage usage) {
+   if ((flags & VK_MEMORY_PROPERTY_PROTECTED_BIT) != 0) {
+      return kUnusable;
+   }
+
+   bool device_local = (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+   bool host_visible = (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+   bool coherent = (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+   bool cached = (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
+   bool lazy = (flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+
+   // Lazily allocated memory only works for transient attachments
+   if (usage == MemoryUsage::LAZY) {
+      return (lazy ? 200 : 0) + (device_local ? 100 : 0) - (host_visible ? 10 : 0);
+   }
+
+   if (lazy) {
+      return kUnusable;
+   }
+
+   if (usage == MemoryUsage::GPU_ONLY) {
+      // Leave mappable device-local memory to DYNAMIC resources, on discrete GPUs there is little
+      return (device_local ? 100 : 0) - (host_visible ? 10 : 0);
+   }
+
+   if (!host_visible) {
+      return kUnusable;
+   }
+
+   // Flushing is cheap but not free. Uncached (write-combined) memory is fastest for the
+   // sequential writes of uploads, while reads from it are extremely slow.
+   int score = 50 + (coherent ? 10 : 0);
+
+   switch (usage) {
+   case MemoryUsage::UPLOAD:
+      return score - (device_local ? 20 : 0) - (cached ? 5 : 0);
+   case MemoryUsage::DYNAMIC:
+      return score + (device_local ? 40 : 0) - (cached ? 5 : 0);
+   case MemoryUsage::READBACK:
+      return score + (cached ? 40 : 0) - (device_local ? 10 : 0);
+   default:
+      return score;
+   }
+}
+
+} // namespace
+
+int vkad::select_memory_type(
+    const VkPhysicalDeviceMemoryProperties &properties, uint32_t type_bits, MemoryUsage usage,
+    VkDeviceSize size, const std::vector<VkDeviceSize> &heap_budgets
+) {
+   int best_type = -1;
+   int best_score = kUnusable;
+
+   for (uint32_t i = 0; i < properties.memoryTypeCount; ++i) {
+      if ((type_bits & (1u << i)) == 0) {
+         continue;
+      }
+
+      const VkMemoryType &type = properties.memoryTypes[i];
+      int score = score_memory_type(type.propertyFlags, usage);
+      if (score == kUnusable) {
+         continue;
+      }
+
+      if (!heap_budgets.empty() && heap_budgets[type.heapIndex] < size) {
+         score -= kOverBudgetPenalty;
+      }
+
+      if (best_type == -1 || score > best_score) {
+         best_type = static_cast<int>(i);
+         best_score = score;
+      }
+   }
+
+   return best_type;
+}
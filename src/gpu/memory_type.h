@@ -0,0 +1,37 @@
+#ifndef VKAD_GPU_MEMORY_TYPE_H_
+#define VKAD_GPU_MEMORY_TYPE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace vkad {
+
+/// How a resource's memory is accessed, which decides the memory type it is allocated from
+enum class MemoryUsage {
+   /// Only the GPU accesses it, the CPU fills it through staging copies
+   GPU_ONLY,
+   /// Written sequentially by the CPU once and read by the GPU once, like staging memory
+   UPLOAD,
+   /// Rewritten by the CPU often and read by the GPU every frame. Goes to device-local memory the
+   /// CPU can map (resizable BAR, or any memory on integrated GPUs) when there is some.
+   DYNAMIC,
+   /// Written by the GPU and read by the CPU
+   READBACK,
+   /// Attachments whose contents never leave a render pass. Goes to lazily allocated memory where
+   /// there is some, which tile-based GPUs may never back since the attachment stays on chip.
+   LAZY,
+};
+
+/// Returns the memory type in `type_bits` best suited for `usage`, or -1 if there is none. Unless
+/// `heap_budgets` is empty it holds the bytes each heap can still take before going over budget,
+/// and heaps too full for `size` are only picked if nothing else fits.
+int select_memory_type(
+    const VkPhysicalDeviceMemoryProperties &properties, uint32_t type_bits, MemoryUsage usage,
+    VkDeviceSize size, const std::vector<VkDeviceSize> &heap_budgets
+);
+
+} // namespace vkad
+
+#endif // !VKAD_GPU_MEMORY_TYPE_H_
@@ -0,0 +1,94 @@
+#include "memory_type.h"
+
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "vendor/doctest.h"
+
+using namespace vkad;
+
+namespace {
+
+constexpr VkMemoryPropertyFlags kDeviceLocal = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+constexpr VkMemoryPropertyFlags kHostCoherent =
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+constexpr VkMemoryPropertyFlags kHostCached = kHostCoherent | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+constexpr uint32_t kAllTypes = ~0u;
+
+/// Heap 0 is video memory, heap 1 system memory and heap 2 the resizable BAR window
+VkPhysicalDeviceMemoryProperties
+make_properties(std::initializer_list<std::pair<VkMemoryPropertyFlags, uint32_t>> types) {
+   VkPhysicalDeviceMemoryProperties properties = {};
+   for (const auto &[flags, heap] : types) {
+      properties.memoryTypes[properties.memoryTypeCount++] = {
+          .propertyFlags = flags,
+          .heapIndex = heap,
+      };
+   }
+   properties.memoryHeapCount = 3;
+   return properties;
+}
+
+} // namespace
+
+TEST_CASE("select_memory_type on a discrete GPU without resizable BAR") {
+   VkPhysicalDeviceMemoryProperties properties =
+       make_properties({{kDeviceLocal, 0}, {kHostCoherent, 1}, {kHostCached, 1}});
+
+   CHECK(select_memory_type(properties, kAllTypes, MemoryUsage::GPU_ONLY, 64, {}) == 0);
+   CHECK(select_memory_type(properties, kAllTypes, MemoryUsage::UPLOAD, 64, {}) == 1);
+   CHECK(select_memory_type(properties, kAllTypes, MemoryUsage::DYNAMIC, 64, {}) == 1);
+   CHECK(select_memory_type(properties, kAllTypes, MemoryUsage::READBACK, 64, {}) == 2);
+}
+
+TEST_CASE("select_memory_type puts dynamic data in resizable BAR memory") {
+   VkPhysicalDeviceMemoryProperties properties = make_properties(
+       {{kDeviceLocal, 0}, {kHostCoherent, 1}, {kHostCached, 1}, {kDeviceLocal | kHostCoherent, 2}}
+   );
+
+   CHECK(select_memory_type(properties, kAllTypes, MemoryUsage::GPU_ONLY, 64, {}) == 0);
+   CHECK(select_memory_type(properties, kAllTypes, MemoryUsage::UPLOAD, 64, {}) == 1);
+   CHECK(select_memory_type(properties, kAllTypes, MemoryUsage::DYNAMIC, 64, {}) == 3);
+
+   // Once the BAR heap is out of budget dynamic data falls back to system memory
+   std::vector<VkDeviceSize> budgets = {1 << 30, 1 << 30, 32};
+   CHECK(select_memory_type(properties, kAllTypes, MemoryUsage::DYNAMIC, 64, budgets) == 1);
+
+   // ...unless nothing else is allowed
+   CHECK(select_memory_type(properties, 1u << 3, MemoryUsage::DYNAMIC, 64, budgets) == 3);
+}
+
+TEST_CASE("select_memory_type respects the allowed types") {
+   VkPhysicalDeviceMemoryProperties properties =
+       make_properties({{kDeviceLocal, 0}, {kHostCoherent, 1}});
+
+   CHECK(select_memory_type(properties, 1u << 1, MemoryUsage::GPU_ONLY, 64, {}) == 1);
+   CHECK(select_memory_type(properties, 1u << 0, MemoryUsage::UPLOAD, 64, {}) == -1);
+   CHECK(select_memory_type(properties, 0, MemoryUsage::GPU_ONLY, 64, {}) == -1);
+}
+
+TEST_CASE("select_memory_type prefers coherent memory for host access") {
+   VkPhysicalDeviceMemoryProperties properties = make_properties(
+       {{VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 1},
+        {kHostCached, 1}}
+   );
+
+   CHECK(select_memory_type(properties, kAllTypes, MemoryUsage::READBACK, 64, {}) == 1);
+}
+
+TEST_CASE("select_memory_type keeps lazily allocated memory for transient attachments") {
+   constexpr VkMemoryPropertyFlags kLazy = kDeviceLocal | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+   VkPhysicalDeviceMemoryProperties properties =
+       make_properties({{kDeviceLocal, 0}, {kLazy, 0}, {kHostCoherent, 1}});
+
+   CHECK(select_memory_type(properties, kAllTypes, MemoryUsage::LAZY, 64, {}) == 1);
+   CHECK(select_memory_type(properties, kAllTypes, MemoryUsage::GPU_ONLY, 64, {}) == 0);
+   CHECK(select_memory_type(properties, 1u << 1, MemoryUsage::GPU_ONLY, 64, {}) == -1);
+
+   // Without any, transient attachments live in ordinary device memory
+   properties = make_properties({{kDeviceLocal, 0}, {kHostCoherent, 1}});
+   CHECK(select_memory_type(properties, kAllTypes, MemoryUsage::LAZY, 64, {}) == 0);
+}
@@ -0,0 +1,356 @@
+#include "occlusion_culler.h"
+
+#include <algorithm>
+#include <bit>
+#include <optional>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/buffer.h"
+#include "gpu/descriptor_pool.h"
+#include "gpu/image.h"
+#include "gpu/status.h"
+#include "util/assert.h"
+
+using namespace vkad;
+
+namespace {
+
+VkDescriptorSetLayout create_set_layout(
+    VkDevice device, const std::vector<VkDescriptorSetLayoutBinding> &bindings
+) {
+   VkDescriptorSetLayoutCreateInfo layout_create = {
+       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+       .bindingCount = static_cast<uint32_t>(bindings.size()),
+       .pBindings = bindings.data(),
+   };
+   VkDescriptorSetLayout layout;
+   VKAD_VK(vkCreateDescriptorSetLayout(device, &layout_create, nullptr, &layout));
+   return layout;
+}
+
+const std::vector<VkDescriptorSetLayoutBinding> kHiZBindings = {
+    DescriptorPool::combined_image_sampler(0, VK_SHADER_STAGE_COMPUTE_BIT),
+    DescriptorPool::storage_image(1),
+};
+
+const std::vector<VkDescriptorSetLayoutBinding> kCullBindings = {
+    DescriptorPool::storage_buffer(0),
+    DescriptorPool::storage_buffer(1),
+    DescriptorPool::storage_buffer(2),
+    DescriptorPool::combined_image_sampler(3, VK_SHADER_STAGE_COMPUTE_BIT),
+};
+
+} // namespace
+
+OcclusionCuller::OcclusionCuller(
+    MemoryAllocator &allocator, VkPipelineCache cache, const Shader &hiz_shader,
+    const Shader &cull_shader, const Image &depth_image, int num_frames
+)
+    : allocator_(allocator),
+      device_(allocator.device()),
+      sampler_(VK_NULL_HANDLE),
+      hiz_layout_(create_set_layout(device_, kHiZBindings)),
+      cull_layout_(create_set_layout(device_, kCullBindings)),
+      hiz_pipeline_(device_, hiz_shader, hiz_layout_, cache),
+      cull_pipeline_(device_, cull_shader, cull_layout_, cache, sizeof(PushConstants)),
+      cull_descriptor_pool_(
+          device_, cull_layout_, DescriptorPool::pool_sizes(kCullBindings, num_frames), num_frames
+      ),
+      frames_(num_frames),
+      depth_view_(VK_NULL_HANDLE),
+      hiz_view_(VK_NULL_HANDLE),
+      hiz_initialized_(false),
+      hiz_built_(false) {
+
+   // Levels are read with texelFetch(), the sampler only has to exist
+   VkSamplerCreateInfo sampler_create = {
+       .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+       .magFilter = VK_FILTER_NEAREST,
+       .minFilter = VK_FILTER_NEAREST,
+       .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+       .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+       .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+       .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+       .maxLod = VK_LOD_CLAMP_NONE,
+   };
+   VKAD_VK(vkCreateSampler(device_, &sampler_create, nullptr, &sampler_));
+
+   resize(depth_image);
+
+   for (Frame &frame : frames_) {
+      frame.descriptor_set = cull_descriptor_pool_.allocate(cull_layout_);
+      frame.culled = false;
+      create_frame_buffers(frame, kInitialCapacity);
+   }
+}
+
+OcclusionCuller::~OcclusionCuller() {
+   destroy_hiz_views();
+   vkDestroySampler(device_, sampler_, nullptr);
+   vkDestroyDescriptorSetLayout(device_, hiz_layout_, nullptr);
+   vkDestroyDescriptorSetLayout(device_, cull_layout_, nullptr);
+}
+
+void OcclusionCuller::destroy_hiz_views() {
+   for (const VkImageView view : hiz_level_views_) {
+      vkDestroyImageView(device_, view, nullptr);
+   }
+   hiz_level_views_.clear();
+
+   if (depth_view_ != VK_NULL_HANDLE) {
+      vkDestroyImageView(device_, depth_view_, nullptr);
+      depth_view_ = VK_NULL_HANDLE;
+   }
+}
+
+void OcclusionCuller::resize(const Image &depth_image) {
+   destroy_hiz_views();
+   hiz_descriptor_sets_.clear();
+   hiz_descriptor_pool_.reset();
+   hiz_.reset();
+
+   // Level 0 is half the depth image, so that building it already reduces 2x2 texels. A mip chain
+   // down to 1x1 has one level per bit of the largest side.
+   uint32_t width = std::max(depth_image.width() / 2, 1u);
+   uint32_t height = std::max(depth_image.height() / 2, 1u);
+   uint32_t num_levels = std::bit_width(std::max(width, height));
+
+   hiz_.emplace(
+       allocator_, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_FORMAT_R32_SFLOAT,
+       width, height, num_levels
+   );
+   hiz_->init_view();
+   hiz_view_ = hiz_->view();
+   depth_view_ = depth_image.create_mip_view(0);
+
+   hiz_descriptor_pool_.emplace(
+       device_, hiz_layout_, DescriptorPool::pool_sizes(kHiZBindings, num_levels), num_levels
+   );
+   for (uint32_t level = 0; level < num_levels; ++level) {
+      hiz_level_views_.push_back(hiz_->create_mip_view(level));
+
+      VkImageView src_view = level == 0 ? depth_view_ : hiz_level_views_[level - 1];
+      VkImageLayout src_layout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                            : VK_IMAGE_LAYOUT_GENERAL;
+      VkDescriptorSet set = hiz_descriptor_pool_->allocate(hiz_layout_);
+      hiz_descriptor_pool_->write(
+          set, {
+                   DescriptorPool::write_image_view(0, sampler_, src_view, src_layout),
+                   DescriptorPool::write_storage_image(1, hiz_level_views_[level]),
+               }
+      );
+      hiz_descriptor_sets_.push_back(set);
+   }
+
+   hiz_initialized_ = false;
+   hiz_built_ = false;
+
+   for (Frame &frame : frames_) {
+      if (frame.objects.has_value()) {
+         write_frame_descriptors(frame);
+      }
+   }
+}
+
+void OcclusionCuller::create_frame_buffers(Frame &frame, uint32_t capacity) {
+   frame.objects.reset();
+   frame.commands.reset();
+   frame.objects.emplace(
+       capacity * sizeof(Object), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryUsage::DYNAMIC,
+       allocator_
+   );
+   frame.commands.emplace(
+       capacity * sizeof(VkDrawIndexedIndirectCommand),
+       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+           VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+       MemoryUsage::GPU_ONLY, allocator_
+   );
+   if (!frame.stats.has_value()) {
+      frame.stats.emplace(
+          sizeof(GpuStats),
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+          MemoryUsage::READBACK, allocator_
+      );
+   }
+   frame.capacity = capacity;
+   write_frame_descriptors(frame);
+}
+
+void OcclusionCuller::write_frame_descriptors(Frame &frame) {
+   cull_descriptor_pool_.write(
+       frame.descriptor_set,
+       {
+           DescriptorPool::write_storage_buffer(0, *frame.objects),
+           DescriptorPool::write_storage_buffer(1, *frame.commands),
+           DescriptorPool::write_storage_buffer(2, *frame.stats),
+           DescriptorPool::write_image_view(3, sampler_, hiz_view_, VK_IMAGE_LAYOUT_GENERAL),
+       }
+   );
+}
+
+OcclusionCuller::Object *OcclusionCuller::objects(int frame_index, uint32_t count) {
+   Frame &frame = frames_[frame_index];
+   if (count > frame.capacity) {
+      // The frame's previous submission is done with the old buffers
+      create_frame_buffers(frame, std::bit_ceil(count));
+   }
+   return reinterpret_cast<Object *>(frame.objects->mapped());
+}
+
+void OcclusionCuller::record_cull(
+    VkCommandBuffer cmd_buf, int frame_index, uint32_t count, const Mat4 &view_proj,
+    bool count_draws
+) {
+   Frame &frame = frames_[frame_index];
+   VKAD_ASSERT(count <= frame.capacity, "more objects than objects() made room for");
+   frame.objects->flush(0, count * sizeof(Object));
+   frame.culled = true;
+
+   // The pyramid is read before the first build_hiz() fills it in, so it needs a valid layout
+   if (!hiz_initialized_) {
+      VkImageMemoryBarrier barrier = {
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+          .srcAccessMask = 0,
+          .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+          .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+          .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image = hiz_->handle(),
+          .subresourceRange =
+              {
+                  .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                  .baseMipLevel = 0,
+                  .levelCount = hiz_->mip_levels(),
+                  .baseArrayLayer = 0,
+                  .layerCount = 1,
+              },
+      };
+      vkCmdPipelineBarrier(
+          cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+          nullptr, 0, nullptr, 1, &barrier
+      );
+      hiz_initialized_ = true;
+   }
+
+   // Without a draw count, commands past the visible ones keep an instance count of 0 and draw
+   // nothing
+   if (!count_draws) {
+      vkCmdFillBuffer(
+          cmd_buf, frame.commands->buffer(), 0, count * sizeof(VkDrawIndexedIndirectCommand), 0
+      );
+   }
+   vkCmdFillBuffer(cmd_buf, frame.stats->buffer(), 0, sizeof(GpuStats), 0);
+
+   // The shader writes over the cleared commands and adds to the cleared stats
+   VkMemoryBarrier clear_barrier = {
+       .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+       .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+       .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+   };
+   vkCmdPipelineBarrier(
+       cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+       &clear_barrier, 0, nullptr, 0, nullptr
+   );
+
+   PushConstants push_constants = {
+       .view_proj = view_proj,
+       .num_objects = count,
+       .use_hiz = hiz_built_ ? 1u : 0u,
+   };
+   vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline_.handle());
+   vkCmdBindDescriptorSets(
+       cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline_.layout(), 0, 1,
+       &frame.descriptor_set, 0, nullptr
+   );
+   vkCmdPushConstants(
+       cmd_buf, cull_pipeline_.layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+       &push_constants
+   );
+   vkCmdDispatch(cmd_buf, (count + kCullGroupSize - 1) / kCullGroupSize, 1, 1);
+
+   VkMemoryBarrier cull_barrier = {
+       .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+       .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+       .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT,
+   };
+   vkCmdPipelineBarrier(
+       cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &cull_barrier, 0,
+       nullptr, 0, nullptr
+   );
+}
+
+void OcclusionCuller::build_hiz(VkCommandBuffer cmd_buf) {
+   // Culls recorded before may still read the pyramid that is about to be overwritten
+   VkImageMemoryBarrier barrier = {
+       .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+       .srcAccessMask = 0,
+       .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+       .oldLayout = hiz_initialized_ ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED,
+       .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+       .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+       .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+       .image = hiz_->handle(),
+       .subresourceRange =
+           {
+               .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+               .baseMipLevel = 0,
+               .levelCount = hiz_->mip_levels(),
+               .baseArrayLayer = 0,
+               .layerCount = 1,
+           },
+   };
+   vkCmdPipelineBarrier(
+       cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+       nullptr, 0, nullptr, 1, &barrier
+   );
+   hiz_initialized_ = true;
+
+   vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, hiz_pipeline_.handle());
+
+   // Each level reads the one before it, and the last one is read by the next frame's cull
+   VkMemoryBarrier level_barrier = {
+       .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+       .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+       .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+   };
+   for (uint32_t level = 0; level < hiz_->mip_levels(); ++level) {
+      uint32_t width = std::max(hiz_->width() >> level, 1u);
+      uint32_t height = std::max(hiz_->height() >> level, 1u);
+
+      vkCmdBindDescriptorSets(
+          cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, hiz_pipeline_.layout(), 0, 1,
+          &hiz_descriptor_sets_[level], 0, nullptr
+      );
+      vkCmdDispatch(
+          cmd_buf, (width + kHiZGroupSize - 1) / kHiZGroupSize,
+          (height + kHiZGroupSize - 1) / kHiZGroupSize, 1
+      );
+      vkCmdPipelineBarrier(
+          cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+          1, &level_barrier, 0, nullptr, 0, nullptr
+      );
+   }
+
+   hiz_built_ = true;
+}
+
+std::optional<CullStats> OcclusionCuller::read_stats(int frame_index) {
+   Frame &frame = frames_[frame_index];
+   if (!frame.culled) {
+      return std::nullopt;
+   }
+
+   frame.culled = false;
+   frame.stats->invalidate(0, sizeof(GpuStats));
+   const GpuStats *stats = reinterpret_cast<const GpuStats *>(frame.stats->mapped());
+   return CullStats{
+       .num_tested = stats->num_tested,
+       .num_frustum_culled = stats->num_frustum_culled,
+       .num_occlusion_culled = stats->num_occlusion_culled,
+   };
+}
@@ -0,0 +1,154 @@
+#ifndef VKAD_GPU_OCCLUSION_CULLER_H_
+#define VKAD_GPU_OCCLUSION_CULLER_H_
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/buffer.h"
+#include "gpu/descriptor_pool.h"
+#include "gpu/image.h"
+#include "gpu/memory_allocator.h"
+#include "gpu/pipeline.h"
+#include "math/mat4.h"
+
+namespace vkad {
+
+/// What the cull shader did with the objects of one frame
+struct CullStats {
+   uint32_t num_tested;
+   uint32_t num_frustum_culled;
+   uint32_t num_occlusion_culled;
+};
+
+/// Decides on the GPU which objects of a draw list are visible and writes draw commands for only
+/// those. Objects are tested against the view frustum and against a hierarchical depth (Hi-Z)
+/// pyramid holding the furthest depth of the previous frame in every texel, so objects hidden
+/// behind what was drawn last frame are skipped. The pyramid lags a frame behind, so an object
+/// that comes out from behind another can be missing for one frame.
+class OcclusionCuller {
+public:
+   static constexpr const char *kHiZShaderPath = "hiz-reduce-comp.spv";
+   static constexpr const char *kCullShaderPath = "occlusion-cull-comp.spv";
+
+   /// One object as the cull shader reads it: its bounding box and where its mesh is in the
+   /// geometry arena
+   struct Object {
+      float box_min[4];
+      float box_max[4];
+      uint32_t index_count;
+      uint32_t first_index;
+      int32_t vertex_offset;
+      uint32_t padding;
+   };
+
+   explicit OcclusionCuller(
+       MemoryAllocator &allocator, VkPipelineCache cache, const Shader &hiz_shader,
+       const Shader &cull_shader, const Image &depth_image, int num_frames
+   );
+
+   OcclusionCuller(const OcclusionCuller &other) = delete;
+
+   ~OcclusionCuller();
+
+   OcclusionCuller &operator=(const OcclusionCuller &other) = delete;
+
+   /// Rebuilds the pyramid for a new depth image. Nothing is occlusion culled until the next
+   /// build_hiz(). The device must be idle.
+   void resize(const Image &depth_image);
+
+   /// Returns room for `count` objects of `frame`, to be filled in before record_cull(). The GPU
+   /// must be done with the frame's previous submission.
+   Object *objects(int frame, uint32_t count);
+
+   /// Records the culling of the `count` objects of `frame` into `cmd_buf`. Draws that read
+   /// commands() must be submitted after `cmd_buf`. With `count_draws`, the draws take their
+   /// number of commands from draw_count(), otherwise the commands past the visible ones are
+   /// cleared so that they draw nothing.
+   void record_cull(
+       VkCommandBuffer cmd_buf, int frame, uint32_t count, const Mat4 &view_proj, bool count_draws
+   );
+
+   /// Compacted draw commands of the visible objects, followed by commands drawing nothing unless
+   /// the cull counted the draws
+   inline VkBuffer commands(int frame) const {
+      return frames_[frame].commands->buffer();
+   }
+
+   /// Holds the number of visible objects as a uint32_t at offset 0, for indirect count draws
+   inline VkBuffer draw_count(int frame) const {
+      return frames_[frame].stats->buffer();
+   }
+
+   /// Records building the pyramid from the depth image, which must be in
+   /// VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL with its writes visible to compute shaders
+   void build_hiz(VkCommandBuffer cmd_buf);
+
+   /// Stats of the last record_cull() of `frame`, or nullopt if it didn't cull anything since the
+   /// previous call. The frame's submission must have completed.
+   std::optional<CullStats> read_stats(int frame);
+
+private:
+   static constexpr uint32_t kInitialCapacity = 1024;
+   static constexpr uint32_t kCullGroupSize = 64;
+   static constexpr uint32_t kHiZGroupSize = 8;
+
+   struct PushConstants {
+      Mat4 view_proj;
+      uint32_t num_objects;
+      uint32_t use_hiz;
+   };
+
+   /// Matches the Stats block of the cull shader. num_visible comes first, see draw_count().
+   struct GpuStats {
+      uint32_t num_visible;
+      uint32_t num_tested;
+      uint32_t num_frustum_culled;
+      uint32_t num_occlusion_culled;
+   };
+
+   struct Frame {
+      std::optional<Buffer> objects;
+      std::optional<Buffer> commands;
+      std::optional<Buffer> stats;
+      uint32_t capacity;
+      VkDescriptorSet descriptor_set;
+      /// Whether `stats` will hold the results of a submitted cull
+      bool culled;
+   };
+
+   void create_frame_buffers(Frame &frame, uint32_t capacity);
+
+   void write_frame_descriptors(Frame &frame);
+
+   void destroy_hiz_views();
+
+   MemoryAllocator &allocator_;
+   VkDevice device_;
+   VkSampler sampler_;
+   VkDescriptorSetLayout hiz_layout_;
+   VkDescriptorSetLayout cull_layout_;
+   ComputePipeline hiz_pipeline_;
+   ComputePipeline cull_pipeline_;
+   DescriptorPool cull_descriptor_pool_;
+   std::vector<Frame> frames_;
+
+   /// Depth-only view of the depth image the pyramid is built from
+   VkImageView depth_view_;
+   std::optional<Image> hiz_;
+   VkImageView hiz_view_;
+   /// One view and one descriptor set per pyramid level
+   std::vector<VkImageView> hiz_level_views_;
+   std::optional<DescriptorPool> hiz_descriptor_pool_;
+   std::vector<VkDescriptorSet> hiz_descriptor_sets_;
+   /// Whether the pyramid has been moved out of VK_IMAGE_LAYOUT_UNDEFINED
+   bool hiz_initialized_;
+   /// Whether a build of the pyramid has been recorded since the last resize
+   bool hiz_built_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_GPU_OCCLUSION_CULLER_H_
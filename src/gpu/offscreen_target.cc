@@ -0,0 +1,61 @@
+#include "offscreen_target.h"
+
+#include <memory>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/image.h"
+#include "gpu/memory_allocator.h"
+
+using namespace vkad;
+
+OffscreenTarget::OffscreenTarget(
+    MemoryAllocator &allocator, uint32_t width, uint32_t height, int num_images
+)
+    : extent_{width, height} {
+   images_.reserve(num_images);
+   for (int i = 0; i < num_images; ++i) {
+      images_.push_back(std::make_unique<Image>(
+          allocator, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, kFormat,
+          width, height
+      ));
+      images_.back()->init_view();
+   }
+}
+
+void OffscreenTarget::record_copy(VkCommandBuffer cmd_buf, int index, VkBuffer dst) const {
+   // The render pass already moved the image to TRANSFER_SRC_OPTIMAL, the barrier only makes its
+   // color writes visible to the copy
+   VkImageMemoryBarrier barrier = {
+       .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+       .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+       .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+       .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+       .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+       .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+       .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+       .image = image(index),
+       .subresourceRange =
+           {
+               .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+               .levelCount = 1,
+               .layerCount = 1,
+           },
+   };
+   vkCmdPipelineBarrier(
+       cmd_buf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+       0, nullptr, 0, nullptr, 1, &barrier
+   );
+
+   VkBufferImageCopy region = {
+       .imageSubresource =
+           {
+               .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+               .layerCount = 1,
+           },
+       .imageExtent = {extent_.width, extent_.height, 1},
+   };
+   vkCmdCopyImageToBuffer(
+       cmd_buf, image(index), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, 1, &region
+   );
+}
@@ -0,0 +1,55 @@
+#ifndef VKAD_GPU_OFFSCREEN_TARGET_H_
+#define VKAD_GPU_OFFSCREEN_TARGET_H_
+
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/image.h"
+#include "gpu/memory_allocator.h"
+
+namespace vkad {
+
+/// Color images a headless renderer draws into instead of a swapchain's. Like swapchain images
+/// they are used round robin, one per frame in flight, and every frame leaves its image in
+/// VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL so it can be copied out with record_copy().
+class OffscreenTarget {
+public:
+   /// Renderable and copyable on every device
+   static constexpr VkFormat kFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+   OffscreenTarget(MemoryAllocator &allocator, uint32_t width, uint32_t height, int num_images);
+
+   inline int num_images() const {
+      return images_.size();
+   }
+
+   inline VkImage image(int index) const {
+      return images_[index]->handle();
+   }
+
+   inline VkImageView image_view(int index) const {
+      return images_[index]->view();
+   }
+
+   inline VkFormat img_format() const {
+      return kFormat;
+   }
+
+   inline VkExtent2D extent() const {
+      return extent_;
+   }
+
+   /// Records copying image `index`, which a submission earlier on the same queue rendered, into
+   /// `dst` as tightly packed RGBA8 rows
+   void record_copy(VkCommandBuffer cmd_buf, int index, VkBuffer dst) const;
+
+private:
+   std::vector<std::unique_ptr<Image>> images_;
+   VkExtent2D extent_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_GPU_OFFSCREEN_TARGET_H_
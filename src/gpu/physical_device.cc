@@ -1,6 +1,7 @@
 #include "physical_device.h"
 
-#include <format>
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -10,7 +11,8 @@
 
 using namespace vkad;
 
-PhysicalDevice::PhysicalDevice(const Instance &instance, VkSurfaceKHR surface) {
+PhysicalDevice::PhysicalDevice(const Instance &instance, VkSurfaceKHR surface)
+    : headless_(surface == VK_NULL_HANDLE) {
    uint32_t num_devices;
    vkEnumeratePhysicalDevices(instance.handle(), &num_devices, nullptr);
    if (num_devices == 0) {
@@ -21,7 +23,7 @@ PhysicalDevice::PhysicalDevice(const Instance &instance, VkSurfaceKHR surface) {
    vkEnumeratePhysicalDevices(instance.handle(), &num_devices, devices.data());
 
    for (const auto &device : devices) {
-      if (!Swapchain::is_supported_on(device, surface)) {
+      if (!headless_ && !Swapchain::is_supported_on(device, surface)) {
          continue;
       }
 
@@ -31,11 +33,30 @@ PhysicalDevice::PhysicalDevice(const Instance &instance, VkSurfaceKHR surface) {
 
       physical_device_ = device;
 
-      VkPhysicalDeviceProperties properties;
-      vkGetPhysicalDeviceProperties(physical_device_, &properties);
-      min_uniform_alignment_ = properties.limits.minUniformBufferOffsetAlignment;
+      vkGetPhysicalDeviceProperties(physical_device_, &properties_);
+      min_uniform_alignment_ = properties_.limits.minUniformBufferOffsetAlignment;
 
       vkGetPhysicalDeviceMemoryProperties(device, &mem_properties_);
+      vkGetPhysicalDeviceFeatures(device, &features_);
+
+      // Querying the budget needs vkGetPhysicalDeviceMemoryProperties2 from Vulkan 1.1
+      uint32_t num_extensions;
+      vkEnumerateDeviceExtensionProperties(device, nullptr, &num_extensions, nullptr);
+      std::vector<VkExtensionProperties> extensions(num_extensions);
+      vkEnumerateDeviceExtensionProperties(device, nullptr, &num_extensions, extensions.data());
+
+      memory_budget_supported_ =
+          properties_.apiVersion >= VK_API_VERSION_1_1 &&
+          std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties &ext) {
+             return std::strcmp(ext.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+          });
+
+      draw_indirect_count_supported_ =
+          std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties &ext) {
+             return std::strcmp(ext.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0;
+          });
+
+      query_descriptor_indexing(extensions);
       return;
    }
 
@@ -56,10 +77,17 @@ bool PhysicalDevice::find_queue_families(VkPhysicalDevice candidate_device, VkSu
    for (int i = 0; i < queue_families.size(); ++i) {
       if (!graphics_found && (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0) {
          graphics_queue_ = i;
+         timestamp_valid_bits_ = queue_families[i].timestampValidBits;
          graphics_found = true;
       }
 
-      if (!presentation_found) {
+      if (!presentation_found && headless_) {
+         // Nothing is presented, the graphics queue stands in so queue family sets stay the same
+         if (graphics_found) {
+            present_queue_ = graphics_queue_;
+            presentation_found = true;
+         }
+      } else if (!presentation_found) {
          VkBool32 supported = false;
          vkGetPhysicalDeviceSurfaceSupportKHR(candidate_device, i, surface, &supported);
          if (supported) {
@@ -69,22 +97,147 @@ bool PhysicalDevice::find_queue_families(VkPhysicalDevice candidate_device, VkSu
       }
    }
 
-   return graphics_found && presentation_found;
+   if (!graphics_found || !presentation_found) {
+      return false;
+   }
+
+   // Prefer a family that can only copy (usually a dedicated DMA engine) so uploads can run while
+   // the graphics queue is busy rendering. Its image copies must allow arbitrary offsets because
+   // texture uploads are split into rows.
+   transfer_queue_ = graphics_queue_;
+   for (int i = 0; i < queue_families.size(); ++i) {
+      VkQueueFlags flags = queue_families[i].queueFlags;
+      bool transfer_only = (flags & VK_QUEUE_TRANSFER_BIT) != 0 &&
+                           (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0;
+
+      VkExtent3D granularity = queue_families[i].minImageTransferGranularity;
+      bool any_offset = granularity.width == 1 && granularity.height == 1 && granularity.depth == 1;
+
+      if (transfer_only && any_offset) {
+         transfer_queue_ = i;
+         break;
+      }
+   }
+
+   return true;
+}
+
+void PhysicalDevice::query_descriptor_indexing(
+    const std::vector<VkExtensionProperties> &extensions
+) {
+   descriptor_indexing_supported_ = false;
+   max_bindless_images_ = 0;
+   max_bindless_buffers_ = 0;
+
+   // The feature and property queries need Vulkan 1.1
+   bool has_extension =
+       properties_.apiVersion >= VK_API_VERSION_1_1 &&
+       std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties &ext) {
+          return std::strcmp(ext.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0;
+       });
+   if (!has_extension) {
+      return;
+   }
+
+   VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features = {
+       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+   };
+   VkPhysicalDeviceFeatures2 features = {
+       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+       .pNext = &indexing_features,
+   };
+   vkGetPhysicalDeviceFeatures2(physical_device_, &features);
+
+   // Indices come from push constants, so they are uniform and non-uniform indexing isn't needed
+   descriptor_indexing_supported_ =
+       indexing_features.runtimeDescriptorArray &&
+       indexing_features.descriptorBindingPartiallyBound &&
+       indexing_features.descriptorBindingSampledImageUpdateAfterBind &&
+       indexing_features.descriptorBindingStorageBufferUpdateAfterBind;
+   if (!descriptor_indexing_supported_) {
+      return;
+   }
+
+   VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing_properties = {
+       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT,
+   };
+   VkPhysicalDeviceProperties2 properties = {
+       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+       .pNext = &indexing_properties,
+   };
+   vkGetPhysicalDeviceProperties2(physical_device_, &properties);
+
+   max_bindless_images_ = std::min(
+       indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+       indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages
+   );
+   max_bindless_buffers_ = std::min(
+       indexing_properties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+       indexing_properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers
+   );
+
+   // Images and buffers also share a limit on everything a shader stage can reach, across all the
+   // sets of a pipeline layout, and a limit on update-after-bind descriptors in all pools. Some of
+   // it is left to the materials' own sets, the rest is split 4 to 1 when it's short.
+   uint32_t max_resources = std::min(
+       indexing_properties.maxPerStageUpdateAfterBindResources,
+       indexing_properties.maxUpdateAfterBindDescriptorsInAllPools
+   );
+   uint32_t budget = max_resources > kReservedStageResources
+                         ? max_resources - kReservedStageResources
+                         : 0;
+   if (uint64_t(max_bindless_images_) + max_bindless_buffers_ > budget) {
+      max_bindless_buffers_ = std::min(max_bindless_buffers_, budget / 5);
+      max_bindless_images_ = std::min(max_bindless_images_, budget - max_bindless_buffers_);
+   }
+
+   if (max_bindless_images_ == 0 || max_bindless_buffers_ == 0) {
+      descriptor_indexing_supported_ = false;
+      max_bindless_images_ = 0;
+      max_bindless_buffers_ = 0;
+   }
 }
 
-uint32_t PhysicalDevice::find_memory_type_index(
-    uint32_t supported_bits, VkMemoryPropertyFlagBits extra
-) const {
-   VkMemoryType mem_type;
-   for (int i = 0; i < mem_properties_.memoryTypeCount; ++i) {
-      bool supports_mem_type = (supported_bits & (1 << i)) != 0;
-      bool supports_extra = (mem_properties_.memoryTypes[i].propertyFlags & extra) == extra;
-      if (supports_mem_type && supports_extra) {
-         return i;
+VkFormat PhysicalDevice::find_depth_format() const {
+   const VkFormat candidates[] = {
+       VK_FORMAT_D32_SFLOAT,
+       VK_FORMAT_D32_SFLOAT_S8_UINT,
+       VK_FORMAT_D24_UNORM_S8_UINT,
+   };
+
+   // Sampled so that occlusion culling can read the previous frame's depth
+   constexpr VkFormatFeatureFlags kRequired =
+       VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+   for (const VkFormat format : candidates) {
+      VkFormatProperties properties;
+      vkGetPhysicalDeviceFormatProperties(physical_device_, format, &properties);
+      if ((properties.optimalTilingFeatures & kRequired) == kRequired) {
+         return format;
       }
    }
 
-   throw std::runtime_error(std::format(
-       "no suitable memory type for bits {} and extra flags {}", supported_bits, (int)extra
-   ));
+   throw std::runtime_error("no supported depth format");
+}
+
+std::vector<VkDeviceSize> PhysicalDevice::heap_budgets() const {
+   if (!memory_budget_supported_) {
+      return {};
+   }
+
+   VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {
+       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+   };
+   VkPhysicalDeviceMemoryProperties2 properties = {
+       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+       .pNext = &budget,
+   };
+   vkGetPhysicalDeviceMemoryProperties2(physical_device_, &properties);
+
+   std::vector<VkDeviceSize> budgets(properties.memoryProperties.memoryHeapCount);
+   for (uint32_t heap = 0; heap < budgets.size(); ++heap) {
+      VkDeviceSize usage = budget.heapUsage[heap];
+      budgets[heap] = budget.heapBudget[heap] > usage ? budget.heapBudget[heap] - usage : 0;
+   }
+   return budgets;
 }
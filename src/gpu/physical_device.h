@@ -2,12 +2,15 @@
 #define VKAD_GPU_PHYSICAL_DEVICE_H_
 
 #include "gpu/instance.h"
+#include <vector>
 #include <vulkan/vulkan_core.h>
 
 namespace vkad {
 
 class PhysicalDevice {
 public:
+   /// With a null `surface`, picks the first device with a graphics queue and doesn't check for
+   /// presentation support, see headless()
    PhysicalDevice(const Instance &instance, VkSurfaceKHR surface);
 
    inline VkPhysicalDevice handle() const {
@@ -18,24 +21,103 @@ public:
       return min_uniform_alignment_;
    }
 
+   inline const VkPhysicalDeviceProperties &properties() const {
+      return properties_;
+   }
+
+   inline const VkPhysicalDeviceMemoryProperties &memory_properties() const {
+      return mem_properties_;
+   }
+
+   inline const VkPhysicalDeviceFeatures &features() const {
+      return features_;
+   }
+
    inline uint32_t graphics_queue() const {
       return graphics_queue_;
    }
 
+   /// The graphics family when headless
    inline uint32_t present_queue() const {
       return present_queue_;
    }
 
-   uint32_t find_memory_type_index(uint32_t supported_bits, VkMemoryPropertyFlagBits extra) const;
+   /// Whether the device was picked without a surface, in which case it never presents and the
+   /// Device is created without VK_KHR_swapchain
+   inline bool headless() const {
+      return headless_;
+   }
+
+   /// A transfer-only queue family if the device has one, otherwise the graphics family
+   inline uint32_t transfer_queue() const {
+      return transfer_queue_;
+   }
+
+   /// Significant bits of timestamps written on the graphics queue, 0 if it can't write them
+   inline uint32_t timestamp_valid_bits() const {
+      return timestamp_valid_bits_;
+   }
+
+   /// Returns the first depth format usable as an optimally tiled depth attachment that shaders can
+   /// also sample
+   VkFormat find_depth_format() const;
+
+   /// Whether VK_EXT_memory_budget is supported, and enabled on the Device
+   inline bool memory_budget_supported() const {
+      return memory_budget_supported_;
+   }
+
+   /// Bytes each memory heap can still take before this process goes over the budget the driver
+   /// gives it, or an empty vector if VK_EXT_memory_budget isn't supported
+   std::vector<VkDeviceSize> heap_budgets() const;
+
+   /// Whether VK_KHR_draw_indirect_count is supported, and enabled on the Device. Indirect draws
+   /// can then read their number of commands from a buffer.
+   inline bool draw_indirect_count_supported() const {
+      return draw_indirect_count_supported_;
+   }
+
+   /// Whether VK_EXT_descriptor_indexing supports everything a bindless descriptor set needs:
+   /// runtime-sized arrays of sampled images and storage buffers that are partially bound and
+   /// updated after being bound. Enabled on the Device when supported.
+   inline bool descriptor_indexing_supported() const {
+      return descriptor_indexing_supported_;
+   }
+
+   /// Most sampled images a bindless set may hold, 0 without descriptor indexing. Together with
+   /// max_bindless_buffers() it fits in the per-stage limit on update-after-bind resources.
+   inline uint32_t max_bindless_images() const {
+      return max_bindless_images_;
+   }
+
+   /// Most storage buffers a bindless set may hold, 0 without descriptor indexing
+   inline uint32_t max_bindless_buffers() const {
+      return max_bindless_buffers_;
+   }
 
 private:
+   /// Per-stage descriptors kept out of the bindless set for the other sets of a pipeline layout
+   static constexpr uint32_t kReservedStageResources = 16;
+
    bool find_queue_families(VkPhysicalDevice candidate_device, VkSurfaceKHR surface);
 
+   void query_descriptor_indexing(const std::vector<VkExtensionProperties> &extensions);
+
    VkPhysicalDevice physical_device_;
+   VkPhysicalDeviceProperties properties_;
    VkPhysicalDeviceMemoryProperties mem_properties_;
+   VkPhysicalDeviceFeatures features_;
    VkDeviceSize min_uniform_alignment_;
    uint32_t graphics_queue_;
    uint32_t present_queue_;
+   uint32_t transfer_queue_;
+   uint32_t timestamp_valid_bits_;
+   bool headless_;
+   bool memory_budget_supported_;
+   bool draw_indirect_count_supported_;
+   bool descriptor_indexing_supported_;
+   uint32_t max_bindless_images_;
+   uint32_t max_bindless_buffers_;
 };
 
 } // namespace vkad
@@ -8,12 +8,13 @@
 using namespace vkad;
 
 Pipeline::Pipeline(
-    VkDevice device, VkVertexInputBindingDescription vertex_binding,
+    VkDevice device, const std::vector<VkVertexInputBindingDescription> &vertex_bindings,
     const std::vector<VkVertexInputAttributeDescription> &vertex_attributes,
     const std::vector<Shader> &shaders, VkDescriptorSetLayout descriptor_layout,
-    VkRenderPass render_pass
+    VkRenderPass render_pass, VkPipelineCache cache, const PipelineOptions &options
 )
-    : layout_(VK_NULL_HANDLE), pipeline_(VK_NULL_HANDLE), device_(device) {
+    : layout_(VK_NULL_HANDLE), pipeline_(VK_NULL_HANDLE), device_(device),
+      owns_layout_(options.shared_layout == VK_NULL_HANDLE) {
 
    std::vector<VkPipelineShaderStageCreateInfo> shader_stages(shaders.size());
    for (int i = 0; i < shader_stages.size(); ++i) {
@@ -27,8 +28,8 @@ Pipeline::Pipeline(
 
    VkPipelineVertexInputStateCreateInfo vertex_input_create = {
        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-       .vertexBindingDescriptionCount = 1,
-       .pVertexBindingDescriptions = &vertex_binding,
+       .vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_bindings.size()),
+       .pVertexBindingDescriptions = vertex_bindings.data(),
        .vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_attributes.size()),
        .pVertexAttributeDescriptions = vertex_attributes.data(),
    };
@@ -57,10 +58,21 @@ Pipeline::Pipeline(
        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
    };
 
+   // Less-or-equal lets equal depths pass in submission order, which keeps coplanar faces stable
+   VkPipelineDepthStencilStateCreateInfo depth_stencil_create = {
+       .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+       .depthTestEnable = options.depth_test ? VK_TRUE : VK_FALSE,
+       .depthWriteEnable = options.depth_test ? VK_TRUE : VK_FALSE,
+       .depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
+       .depthBoundsTestEnable = VK_FALSE,
+       .stencilTestEnable = VK_FALSE,
+   };
+
+   bool additive = options.blend == BlendMode::ADDITIVE;
    VkPipelineColorBlendAttachmentState color_blend_attachment = {
-       .blendEnable = VK_TRUE,
-       .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
-       .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+       .blendEnable = options.blend != BlendMode::REPLACE ? VK_TRUE : VK_FALSE,
+       .srcColorBlendFactor = additive ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_SRC_ALPHA,
+       .dstColorBlendFactor = additive ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
        .colorBlendOp = VK_BLEND_OP_ADD,
        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
@@ -82,12 +94,24 @@ Pipeline::Pipeline(
        .pDynamicStates = dynamic_states,
    };
 
-   VkPipelineLayoutCreateInfo layout_create = {
-       .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-       .setLayoutCount = 1,
-       .pSetLayouts = &descriptor_layout,
-   };
-   VKAD_VK(vkCreatePipelineLayout(device, &layout_create, nullptr, &layout_));
+   if (owns_layout_) {
+      VkPushConstantRange push_constant_range = {
+          .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+          .offset = 0,
+          .size = options.push_constant_size,
+      };
+
+      VkPipelineLayoutCreateInfo layout_create = {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+          .setLayoutCount = 1,
+          .pSetLayouts = &descriptor_layout,
+          .pushConstantRangeCount = options.push_constant_size != 0 ? 1u : 0u,
+          .pPushConstantRanges = &push_constant_range,
+      };
+      VKAD_VK(vkCreatePipelineLayout(device, &layout_create, nullptr, &layout_));
+   } else {
+      layout_ = options.shared_layout;
+   }
 
    VkGraphicsPipelineCreateInfo create_info = {
        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
@@ -98,14 +122,14 @@ Pipeline::Pipeline(
        .pViewportState = &viewport_create,
        .pRasterizationState = &rasterizer_create,
        .pMultisampleState = &multisample_create,
-       .pDepthStencilState = nullptr,
+       .pDepthStencilState = &depth_stencil_create,
        .pColorBlendState = &color_blend_create,
        .pDynamicState = &dynamic_create,
        .layout = layout_,
        .renderPass = render_pass,
        .subpass = 0,
    };
-   VKAD_VK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline_));
+   VKAD_VK(vkCreateGraphicsPipelines(device, cache, 1, &create_info, nullptr, &pipeline_));
 }
 
 Pipeline::~Pipeline() {
@@ -113,6 +137,51 @@ Pipeline::~Pipeline() {
       vkDestroyPipeline(device_, pipeline_, nullptr);
    }
 
+   if (owns_layout_ && layout_ != VK_NULL_HANDLE) {
+      vkDestroyPipelineLayout(device_, layout_, nullptr);
+   }
+}
+
+ComputePipeline::ComputePipeline(
+    VkDevice device, const Shader &shader, VkDescriptorSetLayout descriptor_layout,
+    VkPipelineCache cache, uint32_t push_constant_size
+)
+    : layout_(VK_NULL_HANDLE), pipeline_(VK_NULL_HANDLE), device_(device) {
+
+   VkPushConstantRange push_constant_range = {
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+       .offset = 0,
+       .size = push_constant_size,
+   };
+
+   VkPipelineLayoutCreateInfo layout_create = {
+       .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+       .setLayoutCount = 1,
+       .pSetLayouts = &descriptor_layout,
+       .pushConstantRangeCount = push_constant_size != 0 ? 1u : 0u,
+       .pPushConstantRanges = &push_constant_range,
+   };
+   VKAD_VK(vkCreatePipelineLayout(device, &layout_create, nullptr, &layout_));
+
+   VkComputePipelineCreateInfo create_info = {
+       .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+       .stage =
+           {
+               .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+               .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+               .module = shader.module,
+               .pName = "main",
+           },
+       .layout = layout_,
+   };
+   VKAD_VK(vkCreateComputePipelines(device, cache, 1, &create_info, nullptr, &pipeline_));
+}
+
+ComputePipeline::~ComputePipeline() {
+   if (pipeline_ != VK_NULL_HANDLE) {
+      vkDestroyPipeline(device_, pipeline_, nullptr);
+   }
+
    if (layout_ != VK_NULL_HANDLE) {
       vkDestroyPipelineLayout(device_, layout_, nullptr);
    }
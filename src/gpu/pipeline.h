@@ -1,6 +1,7 @@
 #ifndef VKAD_GPU_PIPELINE_H_
 #define VKAD_GPU_PIPELINE_H_
 
+#include <cstdint>
 #include <vector>
 
 #include "vulkan/vulkan_core.h"
@@ -12,13 +13,33 @@ struct Shader {
    VkShaderStageFlagBits type;
 };
 
+enum class BlendMode {
+   /// Overwrites the color attachment
+   REPLACE,
+   /// Blends by source alpha
+   ALPHA,
+   /// Adds to the color attachment, used to count fragments when visualizing overdraw
+   ADDITIVE,
+};
+
+/// Fixed-function state that differs between pipelines
+struct PipelineOptions {
+   uint32_t push_constant_size = 0;
+   /// Whether to test against and write to the depth attachment
+   bool depth_test = false;
+   BlendMode blend = BlendMode::ALPHA;
+   /// Layout shared with other pipelines and owned by the caller. When set, the descriptor set
+   /// layout and `push_constant_size` are ignored and the pipeline creates no layout of its own.
+   VkPipelineLayout shared_layout = VK_NULL_HANDLE;
+};
+
 class Pipeline {
 public:
    explicit Pipeline(
-       VkDevice device, VkVertexInputBindingDescription vertex_binding,
+       VkDevice device, const std::vector<VkVertexInputBindingDescription> &vertex_bindings,
        const std::vector<VkVertexInputAttributeDescription> &vertex_attributes,
        const std::vector<Shader> &shaders, VkDescriptorSetLayout descriptor_layout,
-       VkRenderPass render_pass
+       VkRenderPass render_pass, VkPipelineCache cache, const PipelineOptions &options = {}
    );
 
    explicit inline Pipeline(Pipeline &&other) {
@@ -27,6 +48,7 @@ public:
       pipeline_ = other.pipeline_;
       other.pipeline_ = VK_NULL_HANDLE;
       device_ = other.device_;
+      owns_layout_ = other.owns_layout_;
    }
 
    explicit Pipeline(const Pipeline &other) = delete;
@@ -43,6 +65,35 @@ public:
       return layout_;
    }
 
+private:
+   VkPipelineLayout layout_;
+   VkPipeline pipeline_;
+   VkDevice device_;
+   bool owns_layout_;
+};
+
+class ComputePipeline {
+public:
+   /// `push_constant_size` of 0 means the pipeline has no push constants
+   explicit ComputePipeline(
+       VkDevice device, const Shader &shader, VkDescriptorSetLayout descriptor_layout,
+       VkPipelineCache cache, uint32_t push_constant_size = 0
+   );
+
+   ComputePipeline(const ComputePipeline &other) = delete;
+
+   ~ComputePipeline();
+
+   ComputePipeline &operator=(const ComputePipeline &other) = delete;
+
+   inline VkPipeline handle() const {
+      return pipeline_;
+   }
+
+   inline VkPipelineLayout layout() const {
+      return layout_;
+   }
+
 private:
    VkPipelineLayout layout_;
    VkPipeline pipeline_;
@@ -0,0 +1,178 @@
+#include "pipeline_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "status.h"
+
+using namespace vkad;
+
+namespace {
+
+constexpr uint32_t kFileMagic = 0x43504b56; // "VKPC"
+constexpr uint32_t kFileVersion = 1;
+
+struct FileHeader {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t vendor_id;
+   uint32_t device_id;
+   uint32_t driver_version;
+   uint8_t uuid[VK_UUID_SIZE];
+   uint64_t data_size;
+   uint64_t checksum;
+};
+
+/// The header that starts every vkGetPipelineCacheData() blob, see VkPipelineCacheHeaderVersionOne
+struct VulkanCacheHeader {
+   uint32_t header_size;
+   uint32_t header_version;
+   uint32_t vendor_id;
+   uint32_t device_id;
+   uint8_t uuid[VK_UUID_SIZE];
+};
+
+uint64_t fnv1a(const uint8_t *data, size_t size) {
+   uint64_t hash = 0xcbf29ce484222325;
+   for (size_t i = 0; i < size; ++i) {
+      hash ^= data[i];
+      hash *= 0x100000001b3;
+   }
+   return hash;
+}
+
+} // namespace
+
+PipelineCache::PipelineCache(
+    VkDevice device, const PhysicalDevice &physical_device, const std::string &path
+)
+    : device_(device), cache_(VK_NULL_HANDLE), path_(path), seeded_(false) {
+   const VkPhysicalDeviceProperties &properties = physical_device.properties();
+   identity_ = {
+       .vendor_id = properties.vendorID,
+       .device_id = properties.deviceID,
+       .driver_version = properties.driverVersion,
+   };
+   std::copy_n(properties.pipelineCacheUUID, VK_UUID_SIZE, identity_.uuid.begin());
+
+   std::vector<uint8_t> data;
+   std::ifstream file(path, std::ios::binary);
+   if (file.is_open()) {
+      std::vector<uint8_t> contents(
+          (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>()
+      );
+      seeded_ = decode(contents, identity_, &data);
+   }
+
+   VkPipelineCacheCreateInfo create_info = {
+       .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+       .initialDataSize = seeded_ ? data.size() : 0,
+       .pInitialData = seeded_ ? data.data() : nullptr,
+   };
+   VKAD_VK(vkCreatePipelineCache(device_, &create_info, nullptr, &cache_));
+}
+
+PipelineCache::~PipelineCache() {
+   if (cache_ != VK_NULL_HANDLE) {
+      vkDestroyPipelineCache(device_, cache_, nullptr);
+   }
+}
+
+bool PipelineCache::save() const {
+   size_t size;
+   if (vkGetPipelineCacheData(device_, cache_, &size, nullptr) != VK_SUCCESS) {
+      return false;
+   }
+
+   std::vector<uint8_t> data(size);
+   if (vkGetPipelineCacheData(device_, cache_, &size, data.data()) != VK_SUCCESS) {
+      return false;
+   }
+   data.resize(size);
+
+   std::vector<uint8_t> contents = encode(data, identity_);
+
+   // Write next to the old file and swap it in, so a crash mid-write can't leave a partial file
+   std::string temp_path = path_ + ".tmp";
+   {
+      std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+      file.write(reinterpret_cast<const char *>(contents.data()), contents.size());
+      if (!file) {
+         return false;
+      }
+   }
+
+   std::error_code error;
+   std::filesystem::rename(temp_path, path_, error);
+   return !error;
+}
+
+std::vector<uint8_t>
+PipelineCache::encode(const std::vector<uint8_t> &data, const PipelineCacheIdentity &identity) {
+   FileHeader header = {
+       .magic = kFileMagic,
+       .version = kFileVersion,
+       .vendor_id = identity.vendor_id,
+       .device_id = identity.device_id,
+       .driver_version = identity.driver_version,
+       .data_size = data.size(),
+       .checksum = fnv1a(data.data(), data.size()),
+   };
+   std::copy(identity.uuid.begin(), identity.uuid.end(), header.uuid);
+
+   std::vector<uint8_t> file(sizeof(header) + data.size());
+   std::memcpy(file.data(), &header, sizeof(header));
+   std::copy(data.begin(), data.end(), file.begin() + sizeof(header));
+   return file;
+}
+
+bool PipelineCache::decode(
+    const std::vector<uint8_t> &file, const PipelineCacheIdentity &identity,
+    std::vector<uint8_t> *data
+) {
+   if (file.size() < sizeof(FileHeader)) {
+      return false;
+   }
+
+   FileHeader header;
+   std::memcpy(&header, file.data(), sizeof(header));
+
+   if (header.magic != kFileMagic || header.version != kFileVersion ||
+       header.vendor_id != identity.vendor_id || header.device_id != identity.device_id ||
+       header.driver_version != identity.driver_version ||
+       !std::equal(identity.uuid.begin(), identity.uuid.end(), header.uuid)) {
+      return false;
+   }
+
+   const uint8_t *payload = file.data() + sizeof(header);
+   if (header.data_size != file.size() - sizeof(header) ||
+       header.checksum != fnv1a(payload, header.data_size)) {
+      return false;
+   }
+
+   // The driver's own header has to describe this device too before the data is handed to it
+   VulkanCacheHeader vk_header;
+   if (header.data_size < sizeof(vk_header)) {
+      return false;
+   }
+
+   std::memcpy(&vk_header, payload, sizeof(vk_header));
+   if (vk_header.header_size < sizeof(vk_header) || vk_header.header_size > header.data_size ||
+       vk_header.header_version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+       vk_header.vendor_id != identity.vendor_id || vk_header.device_id != identity.device_id ||
+       !std::equal(identity.uuid.begin(), identity.uuid.end(), vk_header.uuid)) {
+      return false;
+   }
+
+   data->assign(payload, payload + header.data_size);
+   return true;
+}
@@ -0,0 +1,71 @@
+#ifndef VKAD_GPU_PIPELINE_CACHE_H_
+#define VKAD_GPU_PIPELINE_CACHE_H_
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/physical_device.h"
+
+namespace vkad {
+
+/// What a cache file has to match to be reused: the same GPU and the same driver build
+struct PipelineCacheIdentity {
+   uint32_t vendor_id;
+   uint32_t device_id;
+   uint32_t driver_version;
+   std::array<uint8_t, VK_UUID_SIZE> uuid;
+};
+
+/// A VkPipelineCache that is seeded from a file on disk and can be written back to it, so that
+/// pipelines compiled in one run are reused in the next one.
+class PipelineCache {
+public:
+   explicit PipelineCache(
+       VkDevice device, const PhysicalDevice &physical_device, const std::string &path
+   );
+
+   PipelineCache(const PipelineCache &other) = delete;
+
+   ~PipelineCache();
+
+   PipelineCache &operator=(const PipelineCache &other) = delete;
+
+   /// Writes the cache contents to the file. Returns false if the file couldn't be written.
+   bool save() const;
+
+   inline VkPipelineCache handle() const {
+      return cache_;
+   }
+
+   /// Whether the cache started out with data from the file
+   inline bool seeded() const {
+      return seeded_;
+   }
+
+   /// Wraps vkGetPipelineCacheData() output in a header with a checksum so truncated or corrupt
+   /// files can be detected without handing them to the driver
+   static std::vector<uint8_t>
+   encode(const std::vector<uint8_t> &data, const PipelineCacheIdentity &identity);
+
+   /// Returns false unless `file` was written by encode() for `identity` and is intact. On success
+   /// `data` holds the driver's cache data.
+   static bool decode(
+       const std::vector<uint8_t> &file, const PipelineCacheIdentity &identity,
+       std::vector<uint8_t> *data
+   );
+
+private:
+   VkDevice device_;
+   VkPipelineCache cache_;
+   PipelineCacheIdentity identity_;
+   std::string path_;
+   bool seeded_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_GPU_PIPELINE_CACHE_H_
@@ -0,0 +1,91 @@
+#include "pipeline_cache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "vendor/doctest.h"
+
+using namespace vkad;
+
+namespace {
+
+PipelineCacheIdentity test_identity() {
+   PipelineCacheIdentity identity = {
+       .vendor_id = 0x10de,
+       .device_id = 0x2684,
+       .driver_version = 42,
+   };
+   for (int i = 0; i < VK_UUID_SIZE; ++i) {
+      identity.uuid[i] = static_cast<uint8_t>(i);
+   }
+   return identity;
+}
+
+/// Cache data as a driver would return it: a VkPipelineCacheHeaderVersionOne and some payload
+std::vector<uint8_t> driver_data(const PipelineCacheIdentity &identity) {
+   std::vector<uint8_t> data(16 + VK_UUID_SIZE + 64, 0xab);
+   uint32_t fields[] = {
+       16 + VK_UUID_SIZE, VK_PIPELINE_CACHE_HEADER_VERSION_ONE, identity.vendor_id,
+       identity.device_id
+   };
+   std::memcpy(data.data(), fields, sizeof(fields));
+   std::memcpy(data.data() + sizeof(fields), identity.uuid.data(), VK_UUID_SIZE);
+   return data;
+}
+
+} // namespace
+
+TEST_CASE("PipelineCache round-trips data for the same device") {
+   PipelineCacheIdentity identity = test_identity();
+   std::vector<uint8_t> data = driver_data(identity);
+
+   std::vector<uint8_t> decoded;
+   CHECK(PipelineCache::decode(PipelineCache::encode(data, identity), identity, &decoded));
+   CHECK(decoded == data);
+}
+
+TEST_CASE("PipelineCache rejects files from another device or driver") {
+   PipelineCacheIdentity identity = test_identity();
+   std::vector<uint8_t> file = PipelineCache::encode(driver_data(identity), identity);
+   std::vector<uint8_t> decoded;
+
+   PipelineCacheIdentity other_driver = identity;
+   other_driver.driver_version = 43;
+   CHECK_FALSE(PipelineCache::decode(file, other_driver, &decoded));
+
+   PipelineCacheIdentity other_uuid = identity;
+   other_uuid.uuid[3] = 0xff;
+   CHECK_FALSE(PipelineCache::decode(file, other_uuid, &decoded));
+
+   PipelineCacheIdentity other_device = identity;
+   other_device.device_id = 1;
+   CHECK_FALSE(PipelineCache::decode(file, other_device, &decoded));
+}
+
+TEST_CASE("PipelineCache rejects truncated and corrupt files") {
+   PipelineCacheIdentity identity = test_identity();
+   std::vector<uint8_t> file = PipelineCache::encode(driver_data(identity), identity);
+   std::vector<uint8_t> decoded;
+
+   std::vector<uint8_t> truncated(file.begin(), file.end() - 1);
+   CHECK_FALSE(PipelineCache::decode(truncated, identity, &decoded));
+
+   std::vector<uint8_t> corrupt = file;
+   corrupt.back() ^= 1;
+   CHECK_FALSE(PipelineCache::decode(corrupt, identity, &decoded));
+
+   CHECK_FALSE(PipelineCache::decode({}, identity, &decoded));
+}
+
+TEST_CASE("PipelineCache rejects driver data describing another device") {
+   PipelineCacheIdentity identity = test_identity();
+   PipelineCacheIdentity other = identity;
+   other.vendor_id = 0x1002;
+
+   std::vector<uint8_t> file = PipelineCache::encode(driver_data(other), identity);
+   std::vector<uint8_t> decoded;
+   CHECK_FALSE(PipelineCache::decode(file, identity, &decoded));
+}
@@ -0,0 +1,444 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/image.h"
+#include "gpu/memory_allocator.h"
+#include "gpu/render_graph_plan.h"
+#include "status.h"
+#include "util/assert.h"
+
+using namespace vkad;
+
+namespace {
+
+/// Stage masks of a barrier may not be 0
+VkPipelineStageFlags non_empty(VkPipelineStageFlags stages) {
+   return stages != 0 ? stages
+                      : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+}
+
+const char *load_op_name(VkAttachmentLoadOp op) {
+   switch (op) {
+   case VK_ATTACHMENT_LOAD_OP_LOAD:
+      return "load";
+   case VK_ATTACHMENT_LOAD_OP_CLEAR:
+      return "clear";
+   default:
+      return "don't care";
+   }
+}
+
+const char *layout_name(VkImageLayout layout) {
+   switch (layout) {
+   case VK_IMAGE_LAYOUT_UNDEFINED:
+      return "undefined";
+   case VK_IMAGE_LAYOUT_GENERAL:
+      return "general";
+   case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+      return "color attachment";
+   case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+      return "depth attachment";
+   case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+      return "depth read only";
+   case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+      return "shader read only";
+   case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+      return "present";
+   default:
+      return "other";
+   }
+}
+
+} // namespace
+
+RenderGraph::RenderGraph(MemoryAllocator &allocator)
+    : allocator_(allocator), device_(allocator.device()), extent_({0, 0}), profiler_(nullptr),
+      current_pass_(-1), pass_scope_(-1), contents_(VK_SUBPASS_CONTENTS_INLINE),
+      current_framebuffer_(VK_NULL_HANDLE) {}
+
+RenderGraph::~RenderGraph() {
+   destroy_transients();
+   destroy_render_passes();
+}
+
+void RenderGraph::reset() {
+   desc_ = {};
+}
+
+int RenderGraph::import_image(
+    const std::string &name, VkFormat format, VkImageLayout final_layout, VkClearValue clear_value
+) {
+   desc_.images.push_back({
+       .name = name,
+       .format = format,
+       .imported = true,
+       .final_layout = final_layout,
+       .clear_value = clear_value,
+   });
+   return static_cast<int>(desc_.images.size()) - 1;
+}
+
+int RenderGraph::create_image(const std::string &name, VkFormat format, VkClearValue clear_value) {
+   desc_.images.push_back({
+       .name = name,
+       .format = format,
+       .imported = false,
+       .final_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+       .clear_value = clear_value,
+   });
+   return static_cast<int>(desc_.images.size()) - 1;
+}
+
+int RenderGraph::add_pass(
+    const std::string &name, PassType type, const std::vector<PassImage> &images
+) {
+   desc_.passes.push_back({.name = name, .type = type, .images = images});
+   return static_cast<int>(desc_.passes.size()) - 1;
+}
+
+void RenderGraph::compile(VkExtent2D extent) {
+   destroy_transients();
+   destroy_render_passes();
+
+   plan_ = plan_render_graph(desc_);
+   extent_ = extent;
+   bound_images_.assign(desc_.images.size(), {VK_NULL_HANDLE, VK_NULL_HANDLE});
+   record_ms_.assign(desc_.passes.size(), 0.0f);
+
+   create_render_passes();
+   create_transients();
+}
+
+void RenderGraph::resize(VkExtent2D extent) {
+   destroy_transients();
+   extent_ = extent;
+   create_transients();
+}
+
+void RenderGraph::begin_pass(VkCommandBuffer cmd_buf, int pass, VkSubpassContents contents) {
+   VKAD_ASSERT(current_pass_ == -1, "begin_pass() called twice without end_pass()");
+   current_pass_ = pass;
+   pass_start_ = std::chrono::steady_clock::now();
+
+   const PassGroup &group = plan_.groups[plan_.pass_groups[pass]];
+   bool first_in_group = pass == group.first_pass;
+   // Timestamps can be written between passes of a render pass only if its contents are inline
+   VkSubpassContents pass_contents = first_in_group ? contents : contents_;
+   pass_scope_ = -1;
+   if (profiler_ != nullptr &&
+       (group.num_passes == 1 || pass_contents == VK_SUBPASS_CONTENTS_INLINE)) {
+      pass_scope_ = profiler_->begin_scope(cmd_buf, desc_.passes[pass].name);
+   }
+
+   if (!first_in_group) {
+      return;
+   }
+
+   // Barriers of every pass in the group go before the render pass, which can't contain them
+   record_barriers(cmd_buf, group.first_pass, group.first_pass + group.num_passes);
+   if (group.type != PassType::GRAPHICS) {
+      return;
+   }
+
+   std::vector<VkClearValue> clear_values;
+   for (const GraphAttachment &attachment : group.attachments) {
+      clear_values.push_back(desc_.images[attachment.image].clear_value);
+   }
+
+   current_framebuffer_ = framebuffer_for(plan_.pass_groups[pass]);
+   VkRenderPassBeginInfo begin_info = {
+       .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+       .renderPass = render_passes_[plan_.pass_groups[pass]],
+       .framebuffer = current_framebuffer_,
+       .renderArea = {.offset = {0, 0}, .extent = extent_},
+       .clearValueCount = static_cast<uint32_t>(clear_values.size()),
+       .pClearValues = clear_values.data(),
+   };
+   vkCmdBeginRenderPass(cmd_buf, &begin_info, contents);
+   contents_ = contents;
+}
+
+void RenderGraph::end_pass(VkCommandBuffer cmd_buf) {
+   VKAD_ASSERT(current_pass_ != -1, "end_pass() called without begin_pass()");
+   int pass = current_pass_;
+   current_pass_ = -1;
+
+   const PassGroup &group = plan_.groups[plan_.pass_groups[pass]];
+   if (group.type == PassType::GRAPHICS && pass == group.first_pass + group.num_passes - 1) {
+      vkCmdEndRenderPass(cmd_buf);
+      contents_ = VK_SUBPASS_CONTENTS_INLINE;
+   }
+
+   int num_passes = static_cast<int>(desc_.passes.size());
+   if (pass == num_passes - 1) {
+      record_barriers(cmd_buf, num_passes, num_passes + 1);
+   }
+
+   if (profiler_ != nullptr && pass_scope_ != -1) {
+      profiler_->end_scope(cmd_buf, pass_scope_);
+   }
+
+   std::chrono::duration<float, std::milli> elapsed =
+       std::chrono::steady_clock::now() - pass_start_;
+   record_ms_[pass] = elapsed.count();
+}
+
+std::string RenderGraph::describe() const {
+   std::string out;
+   for (int g = 0; g < plan_.groups.size(); ++g) {
+      const PassGroup &group = plan_.groups[g];
+      out += std::format("{} {}:", group.type == PassType::GRAPHICS ? "render pass" : "compute", g);
+      for (int p = group.first_pass; p < group.first_pass + group.num_passes; ++p) {
+         out += std::format(" {} ({:.3f} ms)", desc_.passes[p].name, record_ms_[p]);
+      }
+      out += "\n";
+
+      for (const GraphAttachment &attachment : group.attachments) {
+         out += std::format(
+             "  {}: {}/{}, {} -> {} -> {}\n", desc_.images[attachment.image].name,
+             load_op_name(attachment.load_op),
+             attachment.store_op == VK_ATTACHMENT_STORE_OP_STORE ? "store" : "don't care",
+             layout_name(attachment.initial_layout), layout_name(attachment.layout),
+             layout_name(attachment.final_layout)
+         );
+      }
+   }
+
+   out += "barriers:\n";
+   for (const GraphBarrier &barrier : plan_.barriers) {
+      out += std::format(
+          "  {} before {}: {} -> {}{}\n", desc_.images[barrier.image].name,
+          barrier.pass < desc_.passes.size() ? desc_.passes[barrier.pass].name : "end of frame",
+          layout_name(barrier.src.layout), layout_name(barrier.dst.layout),
+          barrier.in_render_pass ? " (render pass)" : ""
+      );
+   }
+
+   out += std::format("transient images, {} shared memory slots:\n", plan_.num_memory_slots);
+   for (const TransientPlacement &placement : plan_.transients) {
+      out += std::format(
+          "  {}: {}, {} KiB\n", desc_.images[placement.image].name,
+          placement.lazy ? "lazy" : std::format("slot {}", placement.memory_slot),
+          transient_sizes_[placement.image] / 1024
+      );
+   }
+   return out;
+}
+
+void RenderGraph::create_render_passes() {
+   render_passes_.assign(plan_.groups.size(), VK_NULL_HANDLE);
+   for (int g = 0; g < plan_.groups.size(); ++g) {
+      const PassGroup &group = plan_.groups[g];
+      if (group.type != PassType::GRAPHICS) {
+         continue;
+      }
+
+      std::vector<VkAttachmentDescription> attachments;
+      std::vector<VkAttachmentReference> color_refs;
+      std::optional<VkAttachmentReference> depth_ref;
+      for (const GraphAttachment &attachment : group.attachments) {
+         VkAttachmentReference ref = {
+             .attachment = static_cast<uint32_t>(attachments.size()),
+             .layout = attachment.layout,
+         };
+         if (attachment.layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
+            depth_ref = ref;
+         } else {
+            color_refs.push_back(ref);
+         }
+
+         attachments.push_back({
+             .format = desc_.images[attachment.image].format,
+             .samples = VK_SAMPLE_COUNT_1_BIT,
+             .loadOp = attachment.load_op,
+             .storeOp = attachment.store_op,
+             .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+             .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+             .initialLayout = attachment.initial_layout,
+             .finalLayout = attachment.final_layout,
+         });
+      }
+
+      VkSubpassDescription subpass = {
+          .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+          .colorAttachmentCount = static_cast<uint32_t>(color_refs.size()),
+          .pColorAttachments = color_refs.data(),
+          .pDepthStencilAttachment = depth_ref.has_value() ? &*depth_ref : nullptr,
+      };
+
+      std::vector<VkSubpassDependency> dependencies;
+      for (const VkSubpassDependency &dependency : {group.dependency_in, group.dependency_out}) {
+         if (dependency.srcStageMask != 0 && dependency.dstStageMask != 0) {
+            dependencies.push_back(dependency);
+         }
+      }
+
+      VkRenderPassCreateInfo render_pass_info = {
+          .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+          .attachmentCount = static_cast<uint32_t>(attachments.size()),
+          .pAttachments = attachments.data(),
+          .subpassCount = 1,
+          .pSubpasses = &subpass,
+          .dependencyCount = static_cast<uint32_t>(dependencies.size()),
+          .pDependencies = dependencies.data(),
+      };
+      VKAD_VK(vkCreateRenderPass(device_, &render_pass_info, nullptr, &render_passes_[g]));
+   }
+}
+
+void RenderGraph::destroy_render_passes() {
+   for (VkRenderPass render_pass : render_passes_) {
+      if (render_pass != VK_NULL_HANDLE) {
+         vkDestroyRenderPass(device_, render_pass, nullptr);
+      }
+   }
+   render_passes_.clear();
+}
+
+void RenderGraph::create_transients() {
+   transient_images_.resize(desc_.images.size());
+   transient_sizes_.assign(desc_.images.size(), 0);
+
+   // Images of a slot share one allocation big and aligned enough for each of them
+   std::vector<VkMemoryRequirements> slot_requirements(
+       plan_.num_memory_slots, {.size = 0, .alignment = 1, .memoryTypeBits = ~0u}
+   );
+   std::vector<int> own_memory;
+
+   for (const TransientPlacement &placement : plan_.transients) {
+      const GraphImageDesc &desc = desc_.images[placement.image];
+      std::optional<Image> &image = transient_images_[placement.image];
+      if (placement.lazy) {
+         image.emplace(
+             allocator_, placement.usage, desc.format, extent_.width, extent_.height, 1,
+             MemoryUsage::LAZY
+         );
+         transient_sizes_[placement.image] = image->memory_requirements().size;
+         continue;
+      }
+
+      image.emplace(device_, placement.usage, desc.format, extent_.width, extent_.height);
+      VkMemoryRequirements requirements = image->memory_requirements();
+      transient_sizes_[placement.image] = requirements.size;
+
+      VkMemoryRequirements &slot = slot_requirements[placement.memory_slot];
+      if ((slot.memoryTypeBits & requirements.memoryTypeBits) == 0) {
+         own_memory.push_back(placement.image);
+         continue;
+      }
+      slot.size = std::max(slot.size, requirements.size);
+      slot.alignment = std::max(slot.alignment, requirements.alignment);
+      slot.memoryTypeBits &= requirements.memoryTypeBits;
+   }
+
+   for (const VkMemoryRequirements &requirements : slot_requirements) {
+      shared_memory_.push_back(allocator_.allocate(requirements, MemoryUsage::GPU_ONLY, false));
+   }
+   for (int image : own_memory) {
+      shared_memory_.push_back(allocator_.allocate(
+          transient_images_[image]->memory_requirements(), MemoryUsage::GPU_ONLY, false
+      ));
+   }
+
+   int num_own = 0;
+   for (const TransientPlacement &placement : plan_.transients) {
+      Image &image = *transient_images_[placement.image];
+      if (!placement.lazy) {
+         bool own = std::find(own_memory.begin(), own_memory.end(), placement.image) !=
+                    own_memory.end();
+         const Allocation &allocation =
+             shared_memory_[own ? plan_.num_memory_slots + num_own++ : placement.memory_slot];
+         image.bind_memory(allocation.memory, allocation.offset);
+      }
+      image.init_view();
+   }
+}
+
+void RenderGraph::destroy_transients() {
+   for (const CachedFramebuffer &cached : framebuffers_) {
+      vkDestroyFramebuffer(device_, cached.framebuffer, nullptr);
+   }
+   framebuffers_.clear();
+
+   transient_images_.clear();
+   for (const Allocation &allocation : shared_memory_) {
+      allocator_.free(allocation);
+   }
+   shared_memory_.clear();
+}
+
+VkFramebuffer RenderGraph::framebuffer_for(int group) {
+   std::vector<VkImageView> views;
+   for (const GraphAttachment &attachment : plan_.groups[group].attachments) {
+      views.push_back(image_view(attachment.image));
+   }
+
+   for (const CachedFramebuffer &cached : framebuffers_) {
+      if (cached.group == group && cached.views == views) {
+         return cached.framebuffer;
+      }
+   }
+
+   VkFramebufferCreateInfo framebuffer_info = {
+       .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+       .renderPass = render_passes_[group],
+       .attachmentCount = static_cast<uint32_t>(views.size()),
+       .pAttachments = views.data(),
+       .width = extent_.width,
+       .height = extent_.height,
+       .layers = 1,
+   };
+   VkFramebuffer framebuffer;
+   VKAD_VK(vkCreateFramebuffer(device_, &framebuffer_info, nullptr, &framebuffer));
+   framebuffers_.push_back({.group = group, .views = views, .framebuffer = framebuffer});
+   return framebuffer;
+}
+
+void RenderGraph::record_barriers(VkCommandBuffer cmd_buf, int first, int end) {
+   std::vector<VkImageMemoryBarrier> barriers;
+   VkPipelineStageFlags src_stages = 0;
+   VkPipelineStageFlags dst_stages = 0;
+
+   for (const GraphBarrier &barrier : plan_.barriers) {
+      if (barrier.pass < first || barrier.pass >= end || barrier.in_render_pass) {
+         continue;
+      }
+
+      src_stages |= barrier.src.stages;
+      dst_stages |= barrier.dst.stages;
+      barriers.push_back({
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+          .srcAccessMask = barrier.src.access,
+          .dstAccessMask = barrier.dst.access,
+          .oldLayout = barrier.src.layout,
+          .newLayout = barrier.dst.layout,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image = image_handle(barrier.image),
+          .subresourceRange =
+              {
+                  .aspectMask = Image::aspect_of(desc_.images[barrier.image].format),
+                  .baseMipLevel = 0,
+                  .levelCount = VK_REMAINING_MIP_LEVELS,
+                  .baseArrayLayer = 0,
+                  .layerCount = 1,
+              },
+      });
+   }
+
+   if (barriers.empty()) {
+      return;
+   }
+   vkCmdPipelineBarrier(
+       cmd_buf, non_empty(src_stages), non_empty(dst_stages), 0, 0, nullptr, 0, nullptr,
+       static_cast<uint32_t>(barriers.size()), barriers.data()
+   );
+}
@@ -0,0 +1,168 @@
+#ifndef VKAD_GPU_RENDER_GRAPH_H_
+#define VKAD_GPU_RENDER_GRAPH_H_
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "gpu/gpu_profiler.h"
+#include "gpu/image.h"
+#include "gpu/memory_allocator.h"
+#include "gpu/render_graph_plan.h"
+
+namespace vkad {
+
+/// The passes of a frame and the images they use. Each pass declares how it uses its images, and
+/// from that the graph records the barriers and layout transitions between passes, runs
+/// consecutive graphics passes drawing to the same attachments in one render pass, and lets
+/// transient images that are never used at the same time share memory. Transient attachments
+/// that never leave their render pass get lazily allocated memory. See plan_render_graph().
+///
+/// Every compiled pass must be recorded every frame, in declaration order, between begin_pass()
+/// and end_pass().
+class RenderGraph {
+public:
+   explicit RenderGraph(MemoryAllocator &allocator);
+
+   RenderGraph(const RenderGraph &other) = delete;
+
+   ~RenderGraph();
+
+   RenderGraph &operator=(const RenderGraph &other) = delete;
+
+   /// Forgets every declared image and pass so the graph can be declared again. What the last
+   /// compile() created lives until the next one.
+   void reset();
+
+   /// Declares an image owned outside the graph, which bind_image() points at a real image before
+   /// each frame. Its contents from before the frame are discarded.
+   int import_image(
+       const std::string &name, VkFormat format, VkImageLayout final_layout,
+       VkClearValue clear_value = {}
+   );
+
+   /// Declares an image the graph creates at its extent, with the usage its passes need
+   int create_image(const std::string &name, VkFormat format, VkClearValue clear_value = {});
+
+   int add_pass(const std::string &name, PassType type, const std::vector<PassImage> &images);
+
+   /// Plans the declared passes and creates their render passes and transient images. Replaces
+   /// what the previous compile() created, so the device must not be using it anymore.
+   void compile(VkExtent2D extent);
+
+   /// Recreates the transient images and framebuffers at `extent`. The device must be idle.
+   void resize(VkExtent2D extent);
+
+   inline void bind_image(int image, VkImage handle, VkImageView view) {
+      bound_images_[image] = {.handle = handle, .view = view};
+   }
+
+   /// Pipelines drawing in a graphics pass are created against its render pass
+   inline VkRenderPass render_pass(int pass) const {
+      return render_passes_[plan_.pass_groups[pass]];
+   }
+
+   /// Framebuffer of the render pass being recorded
+   inline VkFramebuffer framebuffer() const {
+      return current_framebuffer_;
+   }
+
+   /// A transient image created by compile()
+   inline const Image &image(int image) const {
+      return *transient_images_[image];
+   }
+
+   /// Times every pass as a scope of `profiler` from now on, or stops timing them if it's nullptr.
+   /// Passes that continue a render pass recorded in secondary command buffers aren't timed, as
+   /// the primary command buffer can't write timestamps inside it.
+   inline void set_profiler(GpuProfiler *profiler) {
+      profiler_ = profiler;
+   }
+
+   /// Records the barriers the pass needs and begins its render pass, unless the pass continues
+   /// the render pass of the one before it. `contents` applies to the whole render pass.
+   void begin_pass(
+       VkCommandBuffer cmd_buf, int pass, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE
+   );
+
+   void end_pass(VkCommandBuffer cmd_buf);
+
+   /// Lists the render passes with the passes merged into each and their attachments' load and
+   /// store ops, every barrier, where transient images live and how long each pass took to record
+   /// in the last frame
+   std::string describe() const;
+
+   inline const RenderGraphPlan &plan() const {
+      return plan_;
+   }
+
+private:
+   struct BoundImage {
+      VkImage handle;
+      VkImageView view;
+   };
+
+   /// Framebuffers depend on the imported views, so there is one per swapchain image
+   struct CachedFramebuffer {
+      int group;
+      std::vector<VkImageView> views;
+      VkFramebuffer framebuffer;
+   };
+
+   void create_render_passes();
+
+   void destroy_render_passes();
+
+   void create_transients();
+
+   void destroy_transients();
+
+   VkFramebuffer framebuffer_for(int group);
+
+   /// Records the barriers of passes [first, end) that no render pass takes care of
+   void record_barriers(VkCommandBuffer cmd_buf, int first, int end);
+
+   inline VkImage image_handle(int image) const {
+      return desc_.images[image].imported ? bound_images_[image].handle
+                                          : transient_images_[image]->handle();
+   }
+
+   inline VkImageView image_view(int image) const {
+      return desc_.images[image].imported ? bound_images_[image].view
+                                          : transient_images_[image]->view();
+   }
+
+   MemoryAllocator &allocator_;
+   VkDevice device_;
+   RenderGraphDesc desc_;
+   RenderGraphPlan plan_;
+   VkExtent2D extent_;
+   /// One per group of the plan, VK_NULL_HANDLE for compute passes
+   std::vector<VkRenderPass> render_passes_;
+   std::vector<CachedFramebuffer> framebuffers_;
+   /// Indexed by image, only transient images have a value
+   std::vector<std::optional<Image>> transient_images_;
+   std::vector<VkDeviceSize> transient_sizes_;
+   std::vector<BoundImage> bound_images_;
+   /// Memory shared by the images of each slot, followed by that of images that didn't fit the
+   /// memory types of their slot
+   std::vector<Allocation> shared_memory_;
+   GpuProfiler *profiler_;
+   /// Pass between begin_pass() and end_pass(), or -1
+   int current_pass_;
+   /// Profiler scope of current_pass_, -1 if it isn't timed
+   int pass_scope_;
+   /// Contents of the render pass being recorded
+   VkSubpassContents contents_;
+   VkFramebuffer current_framebuffer_;
+   std::chrono::steady_clock::time_point pass_start_;
+   /// Milliseconds between begin_pass() and end_pass() of each pass in the last frame
+   std::vector<float> record_ms_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_GPU_RENDER_GRAPH_H_
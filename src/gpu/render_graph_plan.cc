@@ -0,0 +1,425 @@
+#include "render_graph_plan.h"
+
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "util/assert.h"
+
+using namespace vkad;
+
+namespace {
+
+constexpr VkAccessFlags kWriteAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                       VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+bool is_depth_format(VkFormat format) {
+   switch (format) {
+   case VK_FORMAT_D16_UNORM:
+   case VK_FORMAT_D32_SFLOAT:
+   case VK_FORMAT_D16_UNORM_S8_UINT:
+   case VK_FORMAT_D24_UNORM_S8_UINT:
+   case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return true;
+   default:
+      return false;
+   }
+}
+
+VkImageUsageFlags usage_of(ImageAccess access) {
+   switch (access) {
+   case ImageAccess::COLOR_ATTACHMENT:
+      return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+   case ImageAccess::DEPTH_ATTACHMENT:
+      return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+   case ImageAccess::FRAGMENT_SAMPLED:
+   case ImageAccess::COMPUTE_SAMPLED:
+      return VK_IMAGE_USAGE_SAMPLED_BIT;
+   case ImageAccess::COMPUTE_STORAGE:
+      return VK_IMAGE_USAGE_STORAGE_BIT;
+   }
+   return 0;
+}
+
+/// How far the frame's use of an image has got while walking the passes
+struct ImageState {
+   /// Passes of the first and latest use, -1 before the first
+   int first_pass;
+   int last_pass;
+   /// Barrier of the first use
+   int first_barrier;
+   VkImageLayout layout;
+   VkPipelineStageFlags write_stages;
+   VkAccessFlags write_access;
+   /// Stages that read the image since the latest write, all of which waited for it
+   VkPipelineStageFlags read_stages;
+   VkImageUsageFlags usage;
+   bool attachment_only;
+};
+
+bool same_attachments(const GraphPassDesc &a, const GraphPassDesc &b) {
+   std::vector<PassImage> a_attachments;
+   std::vector<PassImage> b_attachments;
+   for (const PassImage &use : a.images) {
+      if (is_attachment(use.access)) {
+         a_attachments.push_back(use);
+      }
+   }
+   for (const PassImage &use : b.images) {
+      if (is_attachment(use.access)) {
+         b_attachments.push_back(use);
+      }
+   }
+
+   if (a_attachments.size() != b_attachments.size()) {
+      return false;
+   }
+   for (int i = 0; i < a_attachments.size(); ++i) {
+      if (a_attachments[i].image != b_attachments[i].image ||
+          a_attachments[i].access != b_attachments[i].access) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/// Whether `pass` can continue the render pass of `group`
+bool can_merge(const RenderGraphDesc &desc, const PassGroup &group, const GraphPassDesc &pass) {
+   if (group.type != PassType::GRAPHICS || pass.type != PassType::GRAPHICS ||
+       !same_attachments(desc.passes[group.first_pass], pass)) {
+      return false;
+   }
+
+   // Sampling an image the render pass writes would need a barrier in the middle of it
+   for (const PassImage &use : pass.images) {
+      if (is_attachment(use.access)) {
+         continue;
+      }
+
+      for (int p = group.first_pass; p < group.first_pass + group.num_passes; ++p) {
+         for (const PassImage &other : desc.passes[p].images) {
+            if (other.image == use.image && is_write(other.access)) {
+               return false;
+            }
+         }
+      }
+   }
+   return true;
+}
+
+void add_dependency(
+    VkSubpassDependency &dependency, const AccessState &src, const AccessState &dst
+) {
+   dependency.srcStageMask |= src.stages;
+   dependency.srcAccessMask |= src.access;
+   dependency.dstStageMask |= dst.stages;
+   dependency.dstAccessMask |= dst.access;
+}
+
+} // namespace
+
+AccessState vkad::access_state(ImageAccess access, VkFormat format) {
+   VkImageLayout read_only = is_depth_format(format)
+                                 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                 : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+   switch (access) {
+   case ImageAccess::COLOR_ATTACHMENT:
+      // Blending reads the attachment too
+      return {
+          .stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+          .access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+          .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+      };
+   case ImageAccess::DEPTH_ATTACHMENT:
+      return {
+          .stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                    VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+          .access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+          .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+      };
+   case ImageAccess::FRAGMENT_SAMPLED:
+      return {
+          .stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+          .access = VK_ACCESS_SHADER_READ_BIT,
+          .layout = read_only,
+      };
+   case ImageAccess::COMPUTE_SAMPLED:
+      return {
+          .stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          .access = VK_ACCESS_SHADER_READ_BIT,
+          .layout = read_only,
+      };
+   case ImageAccess::COMPUTE_STORAGE:
+      return {
+          .stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          .access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+          .layout = VK_IMAGE_LAYOUT_GENERAL,
+      };
+   }
+   return {};
+}
+
+RenderGraphPlan vkad::plan_render_graph(const RenderGraphDesc &desc) {
+   RenderGraphPlan plan = {};
+   int num_passes = static_cast<int>(desc.passes.size());
+
+   for (int p = 0; p < num_passes; ++p) {
+      const GraphPassDesc &pass = desc.passes[p];
+      if (!plan.groups.empty() && can_merge(desc, plan.groups.back(), pass)) {
+         ++plan.groups.back().num_passes;
+      } else {
+         plan.groups.push_back({.first_pass = p, .num_passes = 1, .type = pass.type});
+      }
+      plan.pass_groups.push_back(static_cast<int>(plan.groups.size()) - 1);
+   }
+
+   // Barriers between consecutive uses of each image. Reads that are already ordered after the
+   // latest write in the same layout need none, and neither do passes sharing a render pass.
+   std::vector<ImageState> states(
+       desc.images.size(),
+       {
+           .first_pass = -1,
+           .last_pass = -1,
+           .first_barrier = -1,
+           .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+           .write_stages = 0,
+           .write_access = 0,
+           .read_stages = 0,
+           .usage = 0,
+           .attachment_only = true,
+       }
+   );
+
+   for (int p = 0; p < num_passes; ++p) {
+      for (const PassImage &use : desc.passes[p].images) {
+         ImageState &state = states[use.image];
+         VKAD_ASSERT(state.last_pass != p, "a pass may use an image only once");
+
+         AccessState dst = access_state(use.access, desc.images[use.image].format);
+         bool write = is_write(use.access);
+         state.usage |= usage_of(use.access);
+         state.attachment_only = state.attachment_only && is_attachment(use.access);
+
+         if (state.last_pass == -1) {
+            // Nothing from before the frame is kept. Imported images only wait for what made them
+            // available, like a swapchain image's acquire semaphore, at the stages that use them.
+            // The first uses of transient images wait for the last use of their memory, which is
+            // filled in once every use is known.
+            state.first_pass = p;
+            state.first_barrier = static_cast<int>(plan.barriers.size());
+            plan.barriers.push_back({
+                .image = use.image,
+                .pass = p,
+                .src = {.stages = dst.stages, .access = 0, .layout = VK_IMAGE_LAYOUT_UNDEFINED},
+                .dst = dst,
+                .in_render_pass = false,
+            });
+         } else if (is_attachment(use.access) &&
+                    plan.pass_groups[state.last_pass] == plan.pass_groups[p]) {
+            // Draws to an attachment within a render pass are ordered already
+         } else if (write || state.layout != dst.layout ||
+                    (dst.stages & ~state.read_stages) != 0) {
+            // Layout transitions are writes too, so they also wait for the reads before them
+            bool transition = write || state.layout != dst.layout;
+            plan.barriers.push_back({
+                .image = use.image,
+                .pass = p,
+                .src =
+                    {
+                        .stages = state.write_stages | (transition ? state.read_stages : 0),
+                        .access = state.write_access,
+                        .layout = state.layout,
+                    },
+                .dst = dst,
+                .in_render_pass = false,
+            });
+         }
+
+         if (write) {
+            state.write_stages = dst.stages;
+            state.write_access = dst.access & kWriteAccess;
+            state.read_stages = 0;
+         } else {
+            state.read_stages |= dst.stages;
+         }
+         state.layout = dst.layout;
+         state.last_pass = p;
+      }
+   }
+
+   // Imported images used last outside a render pass are moved to their final layout after the
+   // last pass
+   for (int i = 0; i < desc.images.size(); ++i) {
+      const GraphImageDesc &image = desc.images[i];
+      const ImageState &state = states[i];
+      if (!image.imported || state.last_pass == -1 || state.layout == image.final_layout ||
+          state.attachment_only) {
+         continue;
+      }
+
+      plan.barriers.push_back({
+          .image = i,
+          .pass = num_passes,
+          .src =
+              {
+                  .stages = state.write_stages | state.read_stages,
+                  .access = state.write_access,
+                  .layout = state.layout,
+              },
+          .dst =
+              {
+                  .stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                  .access = 0,
+                  .layout = image.final_layout,
+              },
+          .in_render_pass = false,
+      });
+   }
+
+   // Transient images whose lifetimes, counted in render passes, don't overlap share memory
+   std::vector<int> slot_last_group;
+   for (int p = 0; p < num_passes; ++p) {
+      for (const PassImage &use : desc.passes[p].images) {
+         const ImageState &state = states[use.image];
+         if (desc.images[use.image].imported || state.first_pass != p) {
+            continue;
+         }
+
+         int first_group = plan.pass_groups[state.first_pass];
+         int last_group = plan.pass_groups[state.last_pass];
+         TransientPlacement placement = {
+             .image = use.image,
+             .usage = state.usage,
+             .lazy = state.attachment_only && first_group == last_group,
+             .memory_slot = -1,
+         };
+
+         if (placement.lazy) {
+            placement.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+         } else {
+            for (int slot = 0; slot < slot_last_group.size(); ++slot) {
+               if (slot_last_group[slot] < first_group) {
+                  placement.memory_slot = slot;
+                  break;
+               }
+            }
+
+            if (placement.memory_slot == -1) {
+               placement.memory_slot = static_cast<int>(slot_last_group.size());
+               slot_last_group.push_back(last_group);
+            } else {
+               slot_last_group[placement.memory_slot] = last_group;
+            }
+         }
+         plan.transients.push_back(placement);
+      }
+   }
+   plan.num_memory_slots = static_cast<int>(slot_last_group.size());
+
+   // The first use of a transient image waits for the image before it in the same memory, and the
+   // first image in a slot for the last one of the previous frame
+   for (int i = 0; i < plan.transients.size(); ++i) {
+      const TransientPlacement &placement = plan.transients[i];
+      int previous = placement.image;
+      if (!placement.lazy) {
+         int last_in_slot = -1;
+         int previous_in_frame = -1;
+         for (int j = 0; j < plan.transients.size(); ++j) {
+            const TransientPlacement &other = plan.transients[j];
+            if (other.memory_slot == placement.memory_slot) {
+               previous_in_frame = j < i ? other.image : previous_in_frame;
+               last_in_slot = other.image;
+            }
+         }
+         previous = previous_in_frame != -1 ? previous_in_frame : last_in_slot;
+      }
+
+      const ImageState &prev_state = states[previous];
+      AccessState &src = plan.barriers[states[placement.image].first_barrier].src;
+      src.stages = prev_state.write_stages | prev_state.read_stages;
+      src.access = prev_state.write_access;
+   }
+
+   // Render passes take over the barriers of their attachments
+   for (PassGroup &group : plan.groups) {
+      if (group.type != PassType::GRAPHICS) {
+         continue;
+      }
+
+      group.dependency_in = {.srcSubpass = VK_SUBPASS_EXTERNAL, .dstSubpass = 0};
+      group.dependency_out = {.srcSubpass = 0, .dstSubpass = VK_SUBPASS_EXTERNAL};
+      int last_pass = group.first_pass + group.num_passes - 1;
+
+      for (const PassImage &use : desc.passes[group.first_pass].images) {
+         if (!is_attachment(use.access)) {
+            continue;
+         }
+
+         const GraphImageDesc &image = desc.images[use.image];
+         const ImageState &state = states[use.image];
+         AccessState attachment_state = access_state(use.access, image.format);
+         GraphAttachment attachment = {
+             .image = use.image,
+             .load_op = VK_ATTACHMENT_LOAD_OP_LOAD,
+             .store_op = image.imported || state.last_pass > last_pass
+                             ? VK_ATTACHMENT_STORE_OP_STORE
+                             : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+             .initial_layout = attachment_state.layout,
+             .layout = attachment_state.layout,
+             .final_layout = attachment_state.layout,
+         };
+
+         GraphBarrier *next = nullptr;
+         for (int b = 0; b < plan.barriers.size(); ++b) {
+            GraphBarrier &barrier = plan.barriers[b];
+            if (barrier.image != use.image) {
+               continue;
+            }
+
+            if (barrier.pass == group.first_pass) {
+               barrier.in_render_pass = true;
+               attachment.initial_layout = barrier.src.layout;
+               if (b == state.first_barrier) {
+                  attachment.load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+               }
+               add_dependency(group.dependency_in, barrier.src, barrier.dst);
+            } else if (barrier.pass > last_pass && next == nullptr) {
+               next = &barrier;
+            }
+         }
+
+         // Attachments of a later render pass transition when that one begins
+         bool next_is_attachment = false;
+         if (next != nullptr && next->pass < num_passes) {
+            for (const PassImage &next_use : desc.passes[next->pass].images) {
+               if (next_use.image == use.image) {
+                  next_is_attachment = is_attachment(next_use.access);
+               }
+            }
+         }
+
+         if (next != nullptr && !next_is_attachment) {
+            next->in_render_pass = true;
+            attachment.final_layout = next->dst.layout;
+            add_dependency(group.dependency_out, next->src, next->dst);
+         } else if (next == nullptr && image.imported) {
+            attachment.final_layout = image.final_layout;
+            add_dependency(
+                group.dependency_out,
+                {
+                    .stages = attachment_state.stages,
+                    .access = attachment_state.access & kWriteAccess,
+                    .layout = attachment_state.layout,
+                },
+                {.stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, .access = 0}
+            );
+         }
+         group.attachments.push_back(attachment);
+      }
+   }
+
+   return plan;
+}
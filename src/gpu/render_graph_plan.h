@@ -0,0 +1,140 @@
+#ifndef VKAD_GPU_RENDER_GRAPH_PLAN_H_
+#define VKAD_GPU_RENDER_GRAPH_PLAN_H_
+
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+namespace vkad {
+
+/// How a pass uses an image
+enum class ImageAccess {
+   /// Written as a color attachment
+   COLOR_ATTACHMENT,
+   /// Depth tested and written as the depth attachment
+   DEPTH_ATTACHMENT,
+   /// Sampled by fragment shaders
+   FRAGMENT_SAMPLED,
+   /// Sampled by compute shaders
+   COMPUTE_SAMPLED,
+   /// Written by compute shaders as a storage image
+   COMPUTE_STORAGE,
+};
+
+enum class PassType {
+   GRAPHICS,
+   COMPUTE,
+};
+
+/// The stages and accesses of an ImageAccess and the layout it needs
+struct AccessState {
+   VkPipelineStageFlags stages;
+   VkAccessFlags access;
+   VkImageLayout layout;
+};
+
+/// `format` decides between the color and depth flavor of an access
+AccessState access_state(ImageAccess access, VkFormat format);
+
+inline bool is_attachment(ImageAccess access) {
+   return access == ImageAccess::COLOR_ATTACHMENT || access == ImageAccess::DEPTH_ATTACHMENT;
+}
+
+inline bool is_write(ImageAccess access) {
+   return is_attachment(access) || access == ImageAccess::COMPUTE_STORAGE;
+}
+
+struct GraphImageDesc {
+   std::string name;
+   VkFormat format;
+   /// Imported images are owned outside the graph, like swapchain images. The others are
+   /// transient: the graph creates them and their contents don't outlive a frame.
+   bool imported;
+   /// Layout an imported image is left in at the end of the frame
+   VkImageLayout final_layout;
+   /// What the first pass of the frame that uses the image as an attachment clears it to
+   VkClearValue clear_value;
+};
+
+struct PassImage {
+   int image;
+   ImageAccess access;
+};
+
+struct GraphPassDesc {
+   std::string name;
+   PassType type;
+   /// Each image at most once
+   std::vector<PassImage> images;
+};
+
+struct RenderGraphDesc {
+   std::vector<GraphImageDesc> images;
+   /// In execution order
+   std::vector<GraphPassDesc> passes;
+};
+
+/// A dependency between two uses of an image, with the layout transition between them
+struct GraphBarrier {
+   int image;
+   /// The pass that needs the barrier. It is recorded before the render pass that pass is in.
+   int pass;
+   AccessState src;
+   AccessState dst;
+   /// Whether a render pass performs the barrier through an attachment's initial or final layout
+   /// and a subpass dependency, rather than vkCmdPipelineBarrier()
+   bool in_render_pass;
+};
+
+struct GraphAttachment {
+   int image;
+   VkAttachmentLoadOp load_op;
+   VkAttachmentStoreOp store_op;
+   VkImageLayout initial_layout;
+   VkImageLayout layout;
+   VkImageLayout final_layout;
+};
+
+/// Consecutive graphics passes drawing to the same attachments share a render pass instance, so
+/// their attachments stay in tile memory between them. Compute passes are always alone.
+struct PassGroup {
+   int first_pass;
+   int num_passes;
+   PassType type;
+   /// Graphics groups only, in framebuffer order
+   std::vector<GraphAttachment> attachments;
+   /// Subpass dependencies from VK_SUBPASS_EXTERNAL and to it, unused if their stage masks are 0
+   VkSubpassDependency dependency_in;
+   VkSubpassDependency dependency_out;
+};
+
+struct TransientPlacement {
+   int image;
+   VkImageUsageFlags usage;
+   /// Used as an attachment of a single render pass and never stored, so the image can live in
+   /// lazily allocated memory. Lazy images don't share memory.
+   bool lazy;
+   /// Images with the same slot are never used at the same time and share memory. -1 for lazy
+   /// images.
+   int memory_slot;
+};
+
+struct RenderGraphPlan {
+   std::vector<PassGroup> groups;
+   /// Group of each pass
+   std::vector<int> pass_groups;
+   std::vector<GraphBarrier> barriers;
+   /// One per transient image, in order of first use
+   std::vector<TransientPlacement> transients;
+   int num_memory_slots;
+};
+
+/// Works out the barriers, render passes and memory of the transient images that `desc` needs.
+/// Transient images are treated as shared by every frame in flight, so their first use in a frame
+/// also waits for the last use of their memory in the previous frame.
+RenderGraphPlan plan_render_graph(const RenderGraphDesc &desc);
+
+} // namespace vkad
+
+#endif // !VKAD_GPU_RENDER_GRAPH_PLAN_H_
@@ -0,0 +1,289 @@
+#include "render_graph_plan.h"
+
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "vendor/doctest.h"
+
+using namespace vkad;
+
+namespace {
+
+GraphImageDesc swapchain_image() {
+   return {
+       .name = "swapchain",
+       .format = VK_FORMAT_B8G8R8A8_SRGB,
+       .imported = true,
+       .final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+   };
+}
+
+GraphImageDesc transient_image(const char *name, VkFormat format) {
+   return {.name = name, .format = format, .imported = false};
+}
+
+std::vector<GraphBarrier> barriers_of(const RenderGraphPlan &plan, int image) {
+   std::vector<GraphBarrier> barriers;
+   for (const GraphBarrier &barrier : plan.barriers) {
+      if (barrier.image == image) {
+         barriers.push_back(barrier);
+      }
+   }
+   return barriers;
+}
+
+} // namespace
+
+TEST_CASE("plan_render_graph keeps a depth buffer nothing reads in lazy memory") {
+   RenderGraphDesc desc = {
+       .images = {swapchain_image(), transient_image("depth", VK_FORMAT_D32_SFLOAT)},
+       .passes = {{
+           .name = "scene",
+           .type = PassType::GRAPHICS,
+           .images = {{0, ImageAccess::COLOR_ATTACHMENT}, {1, ImageAccess::DEPTH_ATTACHMENT}},
+       }},
+   };
+   RenderGraphPlan plan = plan_render_graph(desc);
+
+   REQUIRE(plan.groups.size() == 1);
+   const PassGroup &group = plan.groups[0];
+   REQUIRE(group.attachments.size() == 2);
+
+   const GraphAttachment &color = group.attachments[0];
+   CHECK(color.load_op == VK_ATTACHMENT_LOAD_OP_CLEAR);
+   CHECK(color.store_op == VK_ATTACHMENT_STORE_OP_STORE);
+   CHECK(color.initial_layout == VK_IMAGE_LAYOUT_UNDEFINED);
+   CHECK(color.final_layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+   const GraphAttachment &depth = group.attachments[1];
+   CHECK(depth.load_op == VK_ATTACHMENT_LOAD_OP_CLEAR);
+   CHECK(depth.store_op == VK_ATTACHMENT_STORE_OP_DONT_CARE);
+   CHECK(depth.final_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+   REQUIRE(plan.transients.size() == 1);
+   CHECK(plan.transients[0].lazy);
+   CHECK(plan.transients[0].memory_slot == -1);
+   CHECK((plan.transients[0].usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0);
+   CHECK(plan.num_memory_slots == 0);
+
+   // The render pass does every transition, and clearing depth waits for last frame's depth tests
+   for (const GraphBarrier &barrier : plan.barriers) {
+      CHECK(barrier.in_render_pass);
+   }
+   CHECK((group.dependency_in.srcStageMask & VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT) != 0);
+   CHECK((group.dependency_in.srcAccessMask & VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT) != 0);
+}
+
+TEST_CASE("plan_render_graph stores depth for a compute pass that samples it") {
+   RenderGraphDesc desc = {
+       .images = {swapchain_image(), transient_image("depth", VK_FORMAT_D32_SFLOAT)},
+       .passes =
+           {
+               {
+                   .name = "scene",
+                   .type = PassType::GRAPHICS,
+                   .images =
+                       {{0, ImageAccess::COLOR_ATTACHMENT}, {1, ImageAccess::DEPTH_ATTACHMENT}},
+               },
+               {
+                   .name = "hiz",
+                   .type = PassType::COMPUTE,
+                   .images = {{1, ImageAccess::COMPUTE_SAMPLED}},
+               },
+           },
+   };
+   RenderGraphPlan plan = plan_render_graph(desc);
+
+   REQUIRE(plan.groups.size() == 2);
+   const GraphAttachment &depth = plan.groups[0].attachments[1];
+   CHECK(depth.store_op == VK_ATTACHMENT_STORE_OP_STORE);
+   CHECK(depth.final_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+   CHECK((plan.groups[0].dependency_out.dstStageMask & VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT) != 0);
+
+   REQUIRE(plan.transients.size() == 1);
+   CHECK(!plan.transients[0].lazy);
+   CHECK((plan.transients[0].usage & VK_IMAGE_USAGE_SAMPLED_BIT) != 0);
+
+   // Both uses transition in the render pass, and the next frame's clear waits for the sampling
+   std::vector<GraphBarrier> barriers = barriers_of(plan, 1);
+   REQUIRE(barriers.size() == 2);
+   CHECK(barriers[0].in_render_pass);
+   CHECK((barriers[0].src.stages & VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT) != 0);
+   CHECK(barriers[1].in_render_pass);
+   CHECK(barriers[1].pass == 1);
+}
+
+TEST_CASE("plan_render_graph merges passes drawing to the same attachments") {
+   RenderGraphDesc desc = {
+       .images =
+           {
+               swapchain_image(),
+               transient_image("depth", VK_FORMAT_D32_SFLOAT),
+               transient_image("hdr", VK_FORMAT_R16G16B16A16_SFLOAT),
+           },
+       .passes =
+           {
+               {
+                   .name = "opaque",
+                   .type = PassType::GRAPHICS,
+                   .images =
+                       {{2, ImageAccess::COLOR_ATTACHMENT}, {1, ImageAccess::DEPTH_ATTACHMENT}},
+               },
+               {
+                   .name = "transparent",
+                   .type = PassType::GRAPHICS,
+                   .images =
+                       {{2, ImageAccess::COLOR_ATTACHMENT}, {1, ImageAccess::DEPTH_ATTACHMENT}},
+               },
+               {
+                   .name = "tonemap",
+                   .type = PassType::GRAPHICS,
+                   .images =
+                       {{0, ImageAccess::COLOR_ATTACHMENT}, {2, ImageAccess::FRAGMENT_SAMPLED}},
+               },
+           },
+   };
+   RenderGraphPlan plan = plan_render_graph(desc);
+
+   REQUIRE(plan.groups.size() == 2);
+   CHECK(plan.groups[0].num_passes == 2);
+   CHECK(plan.pass_groups == std::vector<int>{0, 0, 1});
+
+   // Nothing between the merged passes
+   for (const GraphBarrier &barrier : plan.barriers) {
+      CHECK(barrier.pass != 1);
+   }
+
+   const GraphAttachment &hdr = plan.groups[0].attachments[0];
+   CHECK(hdr.store_op == VK_ATTACHMENT_STORE_OP_STORE);
+   CHECK(hdr.final_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+   CHECK(plan.groups[0].attachments[1].store_op == VK_ATTACHMENT_STORE_OP_DONT_CARE);
+
+   // Depth never leaves the merged render pass
+   REQUIRE(plan.transients.size() == 2);
+   CHECK(plan.transients[0].image == 2);
+   CHECK(!plan.transients[0].lazy);
+   CHECK(plan.transients[1].image == 1);
+   CHECK(plan.transients[1].lazy);
+}
+
+TEST_CASE("plan_render_graph splits render passes around compute passes") {
+   RenderGraphDesc desc = {
+       .images = {swapchain_image(), transient_image("color", VK_FORMAT_R8G8B8A8_SRGB)},
+       .passes =
+           {
+               {
+                   .name = "draw",
+                   .type = PassType::GRAPHICS,
+                   .images = {{0, ImageAccess::COLOR_ATTACHMENT}},
+               },
+               {
+                   .name = "sample",
+                   .type = PassType::GRAPHICS,
+                   .images =
+                       {{0, ImageAccess::COLOR_ATTACHMENT}, {1, ImageAccess::FRAGMENT_SAMPLED}},
+               },
+               {
+                   .name = "write",
+                   .type = PassType::COMPUTE,
+                   .images = {{1, ImageAccess::COMPUTE_STORAGE}},
+               },
+               {
+                   .name = "sample again",
+                   .type = PassType::GRAPHICS,
+                   .images =
+                       {{0, ImageAccess::COLOR_ATTACHMENT}, {1, ImageAccess::FRAGMENT_SAMPLED}},
+               },
+           },
+   };
+   RenderGraphPlan plan = plan_render_graph(desc);
+
+   // Reading an image nothing in the render pass writes doesn't stop merging
+   CHECK(plan.pass_groups == std::vector<int>{0, 0, 1, 2});
+
+   // The swapchain image is loaded again after the compute pass
+   REQUIRE(plan.groups[2].attachments.size() == 1);
+   CHECK(plan.groups[2].attachments[0].load_op == VK_ATTACHMENT_LOAD_OP_LOAD);
+   CHECK(plan.groups[2].attachments[0].initial_layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+   CHECK(plan.groups[0].attachments[0].final_layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+}
+
+TEST_CASE("plan_render_graph shares memory between images that are never used together") {
+   RenderGraphDesc desc = {
+       .images =
+           {
+               transient_image("a", VK_FORMAT_R32_SFLOAT),
+               transient_image("b", VK_FORMAT_R32_SFLOAT),
+               transient_image("c", VK_FORMAT_R32_SFLOAT),
+           },
+       .passes =
+           {
+               {
+                   .name = "write a",
+                   .type = PassType::COMPUTE,
+                   .images = {{0, ImageAccess::COMPUTE_STORAGE}},
+               },
+               {
+                   .name = "a to b",
+                   .type = PassType::COMPUTE,
+                   .images = {{0, ImageAccess::COMPUTE_SAMPLED}, {1, ImageAccess::COMPUTE_STORAGE}},
+               },
+               {
+                   .name = "b to c",
+                   .type = PassType::COMPUTE,
+                   .images = {{1, ImageAccess::COMPUTE_SAMPLED}, {2, ImageAccess::COMPUTE_STORAGE}},
+               },
+           },
+   };
+   RenderGraphPlan plan = plan_render_graph(desc);
+
+   REQUIRE(plan.transients.size() == 3);
+   CHECK(plan.num_memory_slots == 2);
+   CHECK(plan.transients[0].memory_slot == 0);
+   CHECK(plan.transients[1].memory_slot == 1);
+   CHECK(plan.transients[2].memory_slot == 0);
+
+   // `c` overwrites `a` only once the pass sampling `a` is done, and the next frame's `a` waits for
+   // `c` in turn
+   std::vector<GraphBarrier> c_barriers = barriers_of(plan, 2);
+   REQUIRE(c_barriers.size() == 1);
+   CHECK(c_barriers[0].src.stages == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+   CHECK(c_barriers[0].src.layout == VK_IMAGE_LAYOUT_UNDEFINED);
+
+   std::vector<GraphBarrier> a_barriers = barriers_of(plan, 0);
+   REQUIRE(a_barriers.size() == 2);
+   CHECK(a_barriers[0].src.access == VK_ACCESS_SHADER_WRITE_BIT);
+   CHECK(a_barriers[1].src.layout == VK_IMAGE_LAYOUT_GENERAL);
+   CHECK(a_barriers[1].dst.layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+TEST_CASE("plan_render_graph skips barriers between reads") {
+   RenderGraphDesc desc = {
+       .images = {transient_image("a", VK_FORMAT_R32_SFLOAT)},
+       .passes =
+           {
+               {
+                   .name = "write",
+                   .type = PassType::COMPUTE,
+                   .images = {{0, ImageAccess::COMPUTE_STORAGE}},
+               },
+               {
+                   .name = "read",
+                   .type = PassType::COMPUTE,
+                   .images = {{0, ImageAccess::COMPUTE_SAMPLED}},
+               },
+               {
+                   .name = "read again",
+                   .type = PassType::COMPUTE,
+                   .images = {{0, ImageAccess::COMPUTE_SAMPLED}},
+               },
+           },
+   };
+   RenderGraphPlan plan = plan_render_graph(desc);
+
+   std::vector<GraphBarrier> barriers = barriers_of(plan, 0);
+   REQUIRE(barriers.size() == 2);
+   CHECK(barriers[0].pass == 0);
+   CHECK(barriers[1].pass == 1);
+}
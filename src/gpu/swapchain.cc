@@ -46,9 +46,23 @@ VkSurfaceFormatKHR best_surface_format(const std::vector<VkSurfaceFormatKHR> &fo
    return formats.at(0);
 }
 
-VkPresentModeKHR best_present_mode(const std::vector<VkPresentModeKHR> &present_modes) {
-   for (const auto mode : present_modes) {
-      if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
+VkPresentModeKHR
+best_present_mode(const std::vector<VkPresentModeKHR> &present_modes, PresentProfile profile) {
+   std::vector<VkPresentModeKHR> preferred;
+   switch (profile) {
+   case PresentProfile::BALANCED:
+      preferred = {VK_PRESENT_MODE_MAILBOX_KHR};
+      break;
+   case PresentProfile::LOW_LATENCY:
+   case PresentProfile::THROUGHPUT:
+      preferred = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+      break;
+   case PresentProfile::POWER_SAVING:
+      break;
+   }
+
+   for (const auto mode : preferred) {
+      if (std::find(present_modes.begin(), present_modes.end(), mode) != present_modes.end()) {
          return mode;
       }
    }
@@ -56,6 +70,18 @@ VkPresentModeKHR best_present_mode(const std::vector<VkPresentModeKHR> &present_
    return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+uint32_t image_count(const VkSurfaceCapabilitiesKHR &capa, PresentProfile profile) {
+   uint32_t count = capa.minImageCount;
+   if (profile != PresentProfile::LOW_LATENCY) {
+      ++count;
+   }
+
+   if (capa.maxImageCount != 0 && count > capa.maxImageCount) {
+      count = capa.maxImageCount;
+   }
+   return count;
+}
+
 VkExtent2D
 create_swap_extent(const VkSurfaceCapabilitiesKHR &capa, uint32_t width, uint32_t height) {
    VkExtent2D result = capa.currentExtent;
@@ -70,7 +96,8 @@ create_swap_extent(const VkSurfaceCapabilitiesKHR &capa, uint32_t width, uint32_
 
 Swapchain::Swapchain(
     const std::vector<uint32_t> &queue_families, VkPhysicalDevice physical_device, VkDevice device,
-    VkSurfaceKHR surface, uint32_t width, uint32_t height
+    VkSurfaceKHR surface, uint32_t width, uint32_t height, PresentProfile profile,
+    VkSwapchainKHR old_swapchain
 )
     : device_(device), swapchain_(VK_NULL_HANDLE) {
 
@@ -91,20 +118,16 @@ Swapchain::Swapchain(
    VkSurfaceCapabilitiesKHR capabilities;
    VKAD_VK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &capabilities));
 
-   uint32_t image_count = capabilities.minImageCount + 1;
-   if (capabilities.maxImageCount != 0 && image_count > capabilities.maxImageCount) {
-      image_count = capabilities.maxImageCount;
-   }
-
    VkSurfaceFormatKHR format = best_surface_format(surface_formats);
    img_format_ = format.format;
 
    extent_ = create_swap_extent(capabilities, width, height);
+   present_mode_ = best_present_mode(present_modes, profile);
 
    VkSwapchainCreateInfoKHR create_info = {
        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
        .surface = surface,
-       .minImageCount = image_count,
+       .minImageCount = image_count(capabilities, profile),
        .imageFormat = format.format,
        .imageColorSpace = format.colorSpace,
        .imageExtent = extent_,
@@ -112,8 +135,9 @@ Swapchain::Swapchain(
        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
        .preTransform = capabilities.currentTransform,
        .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-       .presentMode = best_present_mode(present_modes),
+       .presentMode = present_mode_,
        .clipped = VK_TRUE,
+       .oldSwapchain = old_swapchain,
    };
 
    if (queue_families.at(0) != queue_families.at(1)) {
@@ -147,6 +171,18 @@ Swapchain::Swapchain(
    }
 }
 
+Swapchain::Swapchain(Swapchain &&other)
+    : device_(other.device_),
+      swapchain_(other.swapchain_),
+      images_(std::move(other.images_)),
+      image_views_(std::move(other.image_views_)),
+      img_format_(other.img_format_),
+      extent_(other.extent_),
+      present_mode_(other.present_mode_) {
+   other.image_views_.clear();
+   other.swapchain_ = VK_NULL_HANDLE;
+}
+
 Swapchain &Swapchain::operator=(Swapchain &&other) {
    for (const VkImageView img_view : image_views_) {
       vkDestroyImageView(device_, img_view, nullptr);
@@ -161,6 +197,7 @@ Swapchain &Swapchain::operator=(Swapchain &&other) {
    swapchain_ = other.swapchain_;
    img_format_ = other.img_format_;
    extent_ = other.extent_;
+   present_mode_ = other.present_mode_;
 
    other.image_views_.clear();
    other.swapchain_ = VK_NULL_HANDLE;
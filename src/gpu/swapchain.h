@@ -6,13 +6,36 @@
 
 namespace vkad {
 
+/// Trades latency, frame rate and power against each other through the present mode and the number
+/// of swapchain images. Modes the surface doesn't support fall back to FIFO, which is always there.
+enum class PresentProfile {
+   /// MAILBOX with one image more than the surface's minimum
+   BALANCED,
+   /// IMMEDIATE, or else MAILBOX, with the surface's minimum number of images, so that as few
+   /// frames as possible queue up ahead of the display. IMMEDIATE may tear.
+   LOW_LATENCY,
+   /// FIFO, which caps the frame rate at the display's refresh rate and lets the GPU idle
+   POWER_SAVING,
+   /// IMMEDIATE, or else MAILBOX, with one image more than the minimum so that acquiring rarely
+   /// blocks. The frame rate is uncapped, for benchmarking.
+   THROUGHPUT,
+};
+
 class Swapchain {
 public:
+   /// Passing the swapchain being replaced as `old_swapchain` lets the presentation engine finish
+   /// showing its images while the new one is created. The old swapchain must still be destroyed.
    Swapchain(
        const std::vector<uint32_t> &queue_families, VkPhysicalDevice physical_device,
-       VkDevice device, VkSurfaceKHR surface, uint32_t width, uint32_t height
+       VkDevice device, VkSurfaceKHR surface, uint32_t width, uint32_t height,
+       PresentProfile profile = PresentProfile::BALANCED,
+       VkSwapchainKHR old_swapchain = VK_NULL_HANDLE
    );
 
+   Swapchain(const Swapchain &other) = delete;
+
+   Swapchain(Swapchain &&other);
+
    Swapchain &operator=(const Swapchain &other) = delete;
 
    Swapchain &operator=(Swapchain &&other);
@@ -27,6 +50,10 @@ public:
       return images_.size();
    }
 
+   inline VkImage image(int index) const {
+      return images_[index];
+   }
+
    inline VkImageView image_view(int index) const {
       return image_views_[index];
    }
@@ -39,6 +66,10 @@ public:
       return extent_;
    }
 
+   inline VkPresentModeKHR present_mode() const {
+      return present_mode_;
+   }
+
    static bool is_supported_on(VkPhysicalDevice device, VkSurfaceKHR surface);
 
 private:
@@ -48,6 +79,7 @@ private:
    std::vector<VkImageView> image_views_;
    VkFormat img_format_;
    VkExtent2D extent_;
+   VkPresentModeKHR present_mode_;
 };
 
 } // namespace vkad
@@ -1,17 +1,149 @@
+#include <chrono>
 #include <exception>
+#include <format>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "app.h"
+#include "util/stats.h"
+#include "util/trace.h"
 
 using namespace vkad;
 
+namespace {
+
+PresentProfile parse_present_profile(std::string_view name) {
+   if (name == "balanced") {
+      return PresentProfile::BALANCED;
+   } else if (name == "low-latency") {
+      return PresentProfile::LOW_LATENCY;
+   } else if (name == "power-saving") {
+      return PresentProfile::POWER_SAVING;
+   } else if (name == "throughput") {
+      return PresentProfile::THROUGHPUT;
+   }
+   throw std::runtime_error(std::format("unknown present profile {}", name));
+}
+
+} // namespace
+
 int main(int argc, char **argv) {
    try {
-      App app;
+      int frames_in_flight = Renderer::kDefaultFramesInFlight;
+      bool visualize_overdraw = false;
+      bool dump_render_graph = false;
+      bool profile_gpu = false;
+      bool late_latch_camera = true;
+      bool gpu_cull = false;
+      bool measure_latency = false;
+      bool report_frame_pacing = false;
+      PresentProfile present_profile = PresentProfile::BALANCED;
+      std::string trace_path;
+
+      for (int i = 1; i < argc; ++i) {
+         constexpr std::string_view kFramesInFlight = "--frames-in-flight=";
+         constexpr std::string_view kTrace = "--trace=";
+         constexpr std::string_view kPresent = "--present=";
+         std::string_view arg = argv[i];
+
+         if (arg.starts_with(kFramesInFlight)) {
+            frames_in_flight = std::stoi(std::string(arg.substr(kFramesInFlight.size())));
+            if (frames_in_flight < 1) {
+               throw std::runtime_error("need at least 1 frame in flight");
+            }
+         } else if (arg == "--visualize-overdraw") {
+            visualize_overdraw = true;
+         } else if (arg == "--dump-render-graph") {
+            dump_render_graph = true;
+         } else if (arg == "--profile-gpu") {
+            profile_gpu = true;
+         } else if (arg == "--no-late-latch") {
+            late_latch_camera = false;
+         } else if (arg == "--gpu-cull") {
+            gpu_cull = true;
+         } else if (arg == "--measure-latency") {
+            measure_latency = true;
+         } else if (arg.starts_with(kTrace)) {
+            trace_path = arg.substr(kTrace.size());
+         } else if (arg.starts_with(kPresent)) {
+            present_profile = parse_present_profile(arg.substr(kPresent.size()));
+         } else if (arg == "--frame-pacing") {
+            report_frame_pacing = true;
+         }
+      }
+
+      if (!trace_path.empty()) {
+#ifndef VKAD_TRACING
+         std::cerr << "Built without VKAD_TRACING, the trace will be empty\n";
+#endif
+         VKAD_TRACE_THREAD_NAME("main");
+         Trace::set_enabled(true);
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      App app(
+          frames_in_flight, visualize_overdraw, profile_gpu, late_latch_camera, present_profile,
+          gpu_cull
+      );
+      std::chrono::duration<float, std::milli> startup = std::chrono::steady_clock::now() - start;
+
+      std::cout << std::format(
+          "Started in {:.1f} ms, {:.1f} ms creating pipelines (pipeline cache {})\n",
+          startup.count(), app.renderer().pipeline_creation_ms(),
+          app.renderer().pipeline_cache_seeded() ? "hit" : "miss"
+      );
+
+      // Input to present of every frame, and submit to present, which late latching can't shorten
+      std::vector<float> latency_ms;
+      std::vector<float> present_ms;
+      if (measure_latency) {
+         app.renderer().set_latency_hook([&](const FrameLatency &frame) {
+            using Ms = std::chrono::duration<float, std::milli>;
+            latency_ms.push_back(Ms(frame.present_time - frame.input_time).count());
+            present_ms.push_back(Ms(frame.present_time - frame.submit_time).count());
+         });
+      }
 
       while (app.poll()) {
          app.draw();
-         app.renderer().wait_idle();
+      }
+
+      if (measure_latency) {
+         TimingSummary latency = summarize_timings(latency_ms);
+         TimingSummary present = summarize_timings(present_ms);
+         std::cout << std::format(
+             "Input to present ({}): mean {:.2f} ms, p50 {:.2f}, p95 {:.2f}, p99 {:.2f}, "
+             "submit to present mean {:.2f} ms\n",
+             late_latch_camera ? "late latched" : "not late latched", latency.mean, latency.p50,
+             latency.p95, latency.p99, present.mean
+         );
+      }
+      if (report_frame_pacing) {
+         FramePacingStats pacing = app.renderer().frame_pacing();
+         std::cout << std::format(
+             "Present interval: mean {:.2f} ms, p50 {:.2f}, p99 {:.2f}, max {:.2f}, {} presents, "
+             "{} missed vblanks at {:.2f} ms per refresh\n",
+             pacing.interval_ms.mean, pacing.interval_ms.p50, pacing.interval_ms.p99,
+             pacing.interval_ms.max, pacing.presents, pacing.missed_vblanks,
+             pacing.refresh_interval_ms
+         );
+      }
+      if (dump_render_graph) {
+         std::cout << app.renderer().render_graph_report();
+      }
+      if (const GpuProfiler *profiler = app.renderer().gpu_profiler()) {
+         std::cout << profiler->dump_csv();
+      }
+      if (!trace_path.empty()) {
+         Trace::set_enabled(false);
+         std::ofstream(trace_path) << Trace::to_json();
+         if (Trace::dropped() != 0) {
+            std::cerr << std::format("{} trace events didn't fit in memory\n", Trace::dropped());
+         }
       }
    } catch (const std::exception &e) {
       std::cerr << "Unhandled exception: " << e.what() << "\n";
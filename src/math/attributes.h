@@ -5,6 +5,8 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include "math/vec4.h"
+
 namespace vkad {
 
 #define VKAD_ATTRIBUTE(index, type, member)                                                        \
@@ -13,6 +15,26 @@ namespace vkad {
       .offset = offsetof(type, member),                                                            \
    }
 
+/// Like VKAD_ATTRIBUTE, but for per-instance data, which is read from binding 1
+#define VKAD_INSTANCE_ATTRIBUTE(index, type, member)                                               \
+   VkVertexInputAttributeDescription {                                                             \
+      .location = index, .binding = 1, .format = decltype(type::member)::kFormat,                  \
+      .offset = offsetof(type, member),                                                            \
+   }
+
+#define VKAD_INSTANCE_COLUMN_ATTRIBUTE(index, type, member, column)                                \
+   VkVertexInputAttributeDescription {                                                             \
+      .location = index + column, .binding = 1, .format = Vec4::kFormat,                           \
+      .offset = static_cast<uint32_t>(offsetof(type, member) + column * sizeof(Vec4)),             \
+   }
+
+/// A per-instance Mat4 takes up four consecutive locations starting at `index`, one per column
+#define VKAD_INSTANCE_MAT4_ATTRIBUTES(index, type, member)                                         \
+   VKAD_INSTANCE_COLUMN_ATTRIBUTE(index, type, member, 0),                                         \
+       VKAD_INSTANCE_COLUMN_ATTRIBUTE(index, type, member, 1),                                     \
+       VKAD_INSTANCE_COLUMN_ATTRIBUTE(index, type, member, 2),                                     \
+       VKAD_INSTANCE_COLUMN_ATTRIBUTE(index, type, member, 3)
+
 } // namespace vkad
 
 #endif // !VKAD_MATH_SIZES_H_
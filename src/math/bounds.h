@@ -0,0 +1,65 @@
+#ifndef VKAD_MATH_BOUNDS_H_
+#define VKAD_MATH_BOUNDS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "vec3.h"
+
+namespace vkad {
+
+/// Axis-aligned bounding box
+struct Aabb {
+   Vec3 min;
+   Vec3 max;
+
+   inline Vec3 center() const {
+      return (min + max) * 0.5f;
+   }
+
+   inline void expand(Vec3 point) {
+      min = Vec3(std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z));
+      max = Vec3(std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z));
+   }
+};
+
+struct BoundingSphere {
+   Vec3 center;
+   float radius;
+};
+
+/// Box and sphere around the `pos` of every vertex. The sphere is centered on the box, which is
+/// looser than the minimal sphere but takes a single pass to compute. Both are empty at the
+/// origin if there are no vertices.
+struct Bounds {
+   Aabb box;
+   BoundingSphere sphere;
+
+   template <class Vertex> static Bounds of_vertices(const std::vector<Vertex> &vertices) {
+      if (vertices.empty()) {
+         return Bounds{};
+      }
+
+      Aabb box = {.min = vertices[0].pos, .max = vertices[0].pos};
+      for (const Vertex &vertex : vertices) {
+         box.expand(vertex.pos);
+      }
+
+      Vec3 center = box.center();
+      float radius_squared = 0;
+      for (const Vertex &vertex : vertices) {
+         Vec3 offset = Vec3(vertex.pos) - center;
+         radius_squared = std::max(radius_squared, offset.dot(offset));
+      }
+
+      return Bounds{
+          .box = box,
+          .sphere = {.center = center, .radius = std::sqrt(radius_squared)},
+      };
+   }
+};
+
+} // namespace vkad
+
+#endif // !VKAD_MATH_BOUNDS_H_
@@ -0,0 +1,160 @@
+#ifndef VKAD_MATH_FRUSTUM_H_
+#define VKAD_MATH_FRUSTUM_H_
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VKAD_FRUSTUM_SSE
+#endif
+
+#include "bounds.h"
+#include "mat4.h"
+#include "vec3.h"
+#include "vec4.h"
+
+namespace vkad {
+
+/// The six planes bounding what a view-projection matrix maps into clip space. Each plane is
+/// stored as (a, b, c, d) with its normal pointing inwards, so a point is inside when
+/// a*x + b*y + c*z + d >= 0 for every plane.
+struct Frustum {
+   static constexpr int kNumPlanes = 6;
+
+   /// Extracts the planes from the rows of `view_proj`. Clip space depth is [0, w] as in Vulkan.
+   static Frustum from_matrix(const Mat4 &view_proj) {
+      Vec4 x = view_proj.row(0);
+      Vec4 y = view_proj.row(1);
+      Vec4 z = view_proj.row(2);
+      Vec4 w = view_proj.row(3);
+
+      auto add = [](Vec4 a, Vec4 b) { return Vec4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); };
+      auto sub = [](Vec4 a, Vec4 b) { return Vec4(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w); };
+
+      return Frustum{.planes = {add(w, x), sub(w, x), add(w, y), sub(w, y), z, sub(w, z)}};
+   }
+
+   /// Whether any part of the box may be inside. Boxes near a frustum corner can be reported
+   /// visible even though they are outside, but visible boxes are never rejected.
+   bool intersects(const Aabb &box) const {
+      for (const Vec4 &plane : planes) {
+         // The corner furthest along the plane normal is the last one to leave the frustum
+         float x = plane.x >= 0 ? box.max.x : box.min.x;
+         float y = plane.y >= 0 ? box.max.y : box.min.y;
+         float z = plane.z >= 0 ? box.max.z : box.min.z;
+         if ((plane.x * x + plane.y * y) + (plane.z * z + plane.w) < 0) {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   std::array<Vec4, kNumPlanes> planes;
+};
+
+/// Boxes stored as one array per coordinate, so that several of them can be tested against a
+/// plane at once. The arrays are padded to a multiple of kLanes.
+class AabbBatch {
+public:
+   static constexpr size_t kLanes = 4;
+
+   inline size_t size() const {
+      return size_;
+   }
+
+   void clear() {
+      for (std::vector<float> &coord : coords_) {
+         coord.clear();
+      }
+      size_ = 0;
+   }
+
+   void push(const Aabb &box) {
+      if (size_ % kLanes == 0) {
+         for (std::vector<float> &coord : coords_) {
+            coord.resize(size_ + kLanes, 0);
+         }
+      }
+
+      coords_[0][size_] = box.min.x;
+      coords_[1][size_] = box.min.y;
+      coords_[2][size_] = box.min.z;
+      coords_[3][size_] = box.max.x;
+      coords_[4][size_] = box.max.y;
+      coords_[5][size_] = box.max.z;
+      ++size_;
+   }
+
+   /// Replaces `visible` with the indices, in push order, of the boxes that may intersect the
+   /// frustum. The result is the same as calling Frustum::intersects() on every box.
+   void cull(const Frustum &frustum, std::vector<uint32_t> &visible) const {
+      visible.clear();
+
+      // Picking the furthest corner only depends on the sign of the plane normal, which is the
+      // same for every box, so it selects whole arrays instead of individual coordinates
+      const float *corners[Frustum::kNumPlanes][3];
+      for (int p = 0; p < Frustum::kNumPlanes; ++p) {
+         const Vec4 &plane = frustum.planes[p];
+         corners[p][0] = coords_[plane.x >= 0 ? 3 : 0].data();
+         corners[p][1] = coords_[plane.y >= 0 ? 4 : 1].data();
+         corners[p][2] = coords_[plane.z >= 0 ? 5 : 2].data();
+      }
+
+      for (size_t base = 0; base < size_; base += kLanes) {
+         uint32_t inside = test_lanes(frustum, corners, base);
+         if (size_ - base < kLanes) {
+            inside &= (1u << (size_ - base)) - 1;
+         }
+         while (inside != 0) {
+            uint32_t lane = std::countr_zero(inside);
+            visible.push_back(static_cast<uint32_t>(base + lane));
+            inside &= inside - 1;
+         }
+      }
+   }
+
+private:
+   /// Bit `i` of the result is set if box `base + i` is inside every plane
+   static uint32_t test_lanes(
+       const Frustum &frustum, const float *const corners[][3], size_t base
+   ) {
+#ifdef VKAD_FRUSTUM_SSE
+      __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+      for (int p = 0; p < Frustum::kNumPlanes; ++p) {
+         const Vec4 &plane = frustum.planes[p];
+         __m128 x = _mm_mul_ps(_mm_set1_ps(plane.x), _mm_loadu_ps(corners[p][0] + base));
+         __m128 y = _mm_mul_ps(_mm_set1_ps(plane.y), _mm_loadu_ps(corners[p][1] + base));
+         __m128 z = _mm_mul_ps(_mm_set1_ps(plane.z), _mm_loadu_ps(corners[p][2] + base));
+         __m128 dist = _mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, _mm_set1_ps(plane.w)));
+         inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+      }
+      return static_cast<uint32_t>(_mm_movemask_ps(inside));
+#else
+      uint32_t inside = (1u << kLanes) - 1;
+      for (int p = 0; p < Frustum::kNumPlanes; ++p) {
+         const Vec4 &plane = frustum.planes[p];
+         for (size_t lane = 0; lane < kLanes; ++lane) {
+            float dist = (plane.x * corners[p][0][base + lane] +
+                          plane.y * corners[p][1][base + lane]) +
+                         (plane.z * corners[p][2][base + lane] + plane.w);
+            if (dist < 0) {
+               inside &= ~(1u << lane);
+            }
+         }
+      }
+      return inside;
+#endif
+   }
+
+   /// min x, min y, min z, max x, max y, max z
+   std::array<std::vector<float>, 6> coords_;
+   size_t size_ = 0;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_MATH_FRUSTUM_H_
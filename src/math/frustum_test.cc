@@ -0,0 +1,86 @@
+#include "frustum.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "angle.h"
+#include "bounds.h"
+#include "mat4.h"
+#include "vendor/doctest.h"
+
+using namespace vkad;
+
+namespace {
+
+Aabb box_at(Vec3 center, float half_size) {
+   Vec3 half(half_size, half_size, half_size);
+   return Aabb{.min = center - half, .max = center + half};
+}
+
+// Looks down -z from the origin, like the player's camera with no rotation
+Frustum test_frustum() {
+   return Frustum::from_matrix(Mat4::perspective(1, deg_to_rad(90), 0.1, 100));
+}
+
+} // namespace
+
+TEST_CASE("Frustum::intersects") {
+   Frustum frustum = test_frustum();
+
+   CHECK(frustum.intersects(box_at(Vec3(0, 0, -10), 1)));
+   // Straddling the left plane
+   CHECK(frustum.intersects(box_at(Vec3(-10.5, 0, -10), 1)));
+
+   CHECK_FALSE(frustum.intersects(box_at(Vec3(0, 0, 10), 1)));
+   CHECK_FALSE(frustum.intersects(box_at(Vec3(-20, 0, -10), 1)));
+   CHECK_FALSE(frustum.intersects(box_at(Vec3(0, 20, -10), 1)));
+   CHECK_FALSE(frustum.intersects(box_at(Vec3(0, 0, -200), 1)));
+   CHECK_FALSE(frustum.intersects(box_at(Vec3(0, 0, -0.01), 0.005)));
+}
+
+TEST_CASE("AabbBatch::cull matches Frustum::intersects") {
+   Frustum frustum = test_frustum();
+   std::mt19937 rng(3);
+   std::uniform_real_distribution<float> coord(-50, 50);
+   std::uniform_real_distribution<float> size(0.1, 5);
+
+   // Not a multiple of the lane count, so the last group is partially padding
+   AabbBatch batch;
+   std::vector<uint32_t> expected;
+   for (uint32_t i = 0; i < 1003; ++i) {
+      Aabb box = box_at(Vec3(coord(rng), coord(rng), coord(rng)), size(rng));
+      batch.push(box);
+      if (frustum.intersects(box)) {
+         expected.push_back(i);
+      }
+   }
+   REQUIRE(!expected.empty());
+
+   std::vector<uint32_t> visible;
+   batch.cull(frustum, visible);
+   CHECK(visible == expected);
+
+   batch.clear();
+   batch.cull(frustum, visible);
+   CHECK(visible.empty());
+}
+
+TEST_CASE("Bounds::of_vertices") {
+   struct Vertex {
+      Vec3 pos;
+   };
+   std::vector<Vertex> vertices = {{Vec3(-1, 0, 2)}, {Vec3(3, 4, 2)}, {Vec3(1, -2, 0)}};
+
+   Bounds bounds = Bounds::of_vertices(vertices);
+   CHECK(bounds.box.min.x == -1);
+   CHECK(bounds.box.min.y == -2);
+   CHECK(bounds.box.min.z == 0);
+   CHECK(bounds.box.max.x == 3);
+   CHECK(bounds.box.max.y == 4);
+   CHECK(bounds.box.max.z == 2);
+   CHECK(bounds.sphere.center.x == 1);
+   CHECK(bounds.sphere.center.y == 1);
+   CHECK(bounds.sphere.center.z == 1);
+   CHECK(bounds.sphere.radius == doctest::Approx(std::sqrt(14.0f)));
+}
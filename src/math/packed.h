@@ -0,0 +1,161 @@
+#ifndef VKAD_MATH_PACKED_H_
+#define VKAD_MATH_PACKED_H_
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+#include <vulkan/vulkan_core.h>
+
+#include "math/vec2.h"
+#include "math/vec3.h"
+
+namespace vkad {
+
+/// Nearest half-precision float, ties to even. Too large values become infinity.
+inline uint16_t float_to_half(float value) {
+   uint32_t bits = std::bit_cast<uint32_t>(value);
+   uint32_t sign = (bits >> 16) & 0x8000;
+   uint32_t float_exponent = (bits >> 23) & 0xff;
+   uint32_t mantissa = bits & 0x7fffff;
+
+   if (float_exponent == 0xff) {
+      // Infinity stays infinity, NaN stays NaN
+      return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+   }
+
+   int exponent = static_cast<int>(float_exponent) - 127 + 15;
+   if (exponent >= 31) {
+      return static_cast<uint16_t>(sign | 0x7c00);
+   }
+
+   if (exponent <= 0) {
+      // Subnormal, the implicit leading bit becomes explicit
+      if (exponent < -10) {
+         return static_cast<uint16_t>(sign);
+      }
+      mantissa |= 0x800000;
+      uint32_t shift = 14 - exponent;
+      uint32_t half = mantissa >> shift;
+      uint32_t rest = mantissa & ((1u << shift) - 1);
+      uint32_t halfway = 1u << (shift - 1);
+      if (rest > halfway || (rest == halfway && (half & 1) != 0)) {
+         ++half;
+      }
+      return static_cast<uint16_t>(sign | half);
+   }
+
+   uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+   uint32_t rest = mantissa & 0x1fff;
+   // A carry out of the mantissa correctly bumps the exponent
+   if (rest > 0x1000 || (rest == 0x1000 && (half & 1) != 0)) {
+      ++half;
+   }
+   return static_cast<uint16_t>(half);
+}
+
+inline float half_to_float(uint16_t half) {
+   uint32_t sign = (half & 0x8000u) << 16;
+   uint32_t exponent = (half >> 10) & 0x1f;
+   uint32_t mantissa = half & 0x3ff;
+
+   if (exponent == 0) {
+      float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+      return sign != 0 ? -magnitude : magnitude;
+   }
+
+   uint32_t bits = exponent == 31 ? sign | 0x7f800000 | (mantissa << 13)
+                                  : sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+   return std::bit_cast<float>(bits);
+}
+
+/// Vec3 without the padding to 16 bytes, for vertex attributes
+struct PackedVec3 {
+   PackedVec3() : x(0), y(0), z(0) {}
+   PackedVec3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+   PackedVec3(const Vec3 &v) : x(v.x), y(v.y), z(v.z) {}
+
+   inline operator Vec3() const {
+      return Vec3(x, y, z);
+   }
+
+   float x;
+   float y;
+   float z;
+
+   static constexpr VkFormat kFormat = VK_FORMAT_R32G32B32_SFLOAT;
+};
+
+/// Unit vector in 32 bits. The sphere is projected onto an octahedron, whose lower half is folded
+/// over the upper half, and the square that results is stored as two snorm16. Shaders undo it with
+/// decode_normal(). The angular error stays below a hundredth of a degree.
+struct OctNormal {
+   OctNormal() : x(0), y(0) {}
+
+   /// `normal` doesn't need to be normalized, but mustn't be zero
+   OctNormal(const Vec3 &normal) : x(0), y(0) {
+      float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+      if (l1 == 0) {
+         return;
+      }
+
+      float u = normal.x / l1;
+      float v = normal.y / l1;
+      if (normal.z < 0) {
+         float folded_u = (1 - std::abs(v)) * sign_not_zero(u);
+         float folded_v = (1 - std::abs(u)) * sign_not_zero(v);
+         u = folded_u;
+         v = folded_v;
+      }
+      x = to_snorm16(u);
+      y = to_snorm16(v);
+   }
+
+   /// The normalized vector, what the shaders see
+   Vec3 decode() const {
+      float u = std::max(x / 32767.0f, -1.0f);
+      float v = std::max(y / 32767.0f, -1.0f);
+      Vec3 n(u, v, 1 - std::abs(u) - std::abs(v));
+
+      float t = std::max(-n.z, 0.0f);
+      n.x += n.x >= 0 ? -t : t;
+      n.y += n.y >= 0 ? -t : t;
+      return n * (1 / std::sqrt(n.dot(n)));
+   }
+
+   int16_t x;
+   int16_t y;
+
+   static constexpr VkFormat kFormat = VK_FORMAT_R16G16_SNORM;
+
+private:
+   static inline float sign_not_zero(float value) {
+      return value >= 0 ? 1.0f : -1.0f;
+   }
+
+   static inline int16_t to_snorm16(float value) {
+      return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+   }
+};
+
+/// Two half-precision floats, which hold texture coordinates of images up to 2048 texels wide
+/// exactly
+struct Half2 {
+   Half2() : x(0), y(0) {}
+   Half2(float x_, float y_) : x(float_to_half(x_)), y(float_to_half(y_)) {}
+   Half2(const Vec2 &v) : Half2(v.x, v.y) {}
+
+   Vec2 decode() const {
+      return Vec2(half_to_float(x), half_to_float(y));
+   }
+
+   uint16_t x;
+   uint16_t y;
+
+   static constexpr VkFormat kFormat = VK_FORMAT_R16G16_SFLOAT;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_MATH_PACKED_H_
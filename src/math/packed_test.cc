@@ -0,0 +1,59 @@
+#include "packed.h"
+
+#include "vendor/doctest.h"
+
+#include <cmath>
+#include <limits>
+
+#include "geometry/geometry.h"
+#include "ui/ui.h"
+
+using namespace vkad;
+
+TEST_CASE("Vertex formats are tightly packed") {
+   CHECK(sizeof(ModelVertex) == 16);
+   CHECK(sizeof(UiVertex) == 16);
+}
+
+TEST_CASE("float_to_half rounds to the nearest half") {
+   CHECK(float_to_half(0.0f) == 0x0000);
+   CHECK(float_to_half(-0.0f) == 0x8000);
+   CHECK(float_to_half(1.0f) == 0x3c00);
+   CHECK(float_to_half(-2.0f) == 0xc000);
+   CHECK(float_to_half(65504.0f) == 0x7bff);
+   CHECK(float_to_half(1e6f) == 0x7c00);
+   CHECK(float_to_half(std::numeric_limits<float>::infinity()) == 0x7c00);
+   CHECK(std::isnan(half_to_float(float_to_half(std::nanf("")))));
+   // Smallest subnormal, and a value halfway between 1 and the next half that rounds to even
+   CHECK(float_to_half(std::ldexp(1.0f, -24)) == 0x0001);
+   CHECK(float_to_half(1.0f + std::ldexp(1.0f, -11)) == 0x3c00);
+
+   // Texture coordinates of a 1024 texel atlas survive exactly
+   for (int texel = 0; texel <= 1024; ++texel) {
+      float coord = texel / 1024.0f;
+      CHECK(half_to_float(float_to_half(coord)) == coord);
+   }
+}
+
+namespace {
+
+float degrees_between(const Vec3 &a, const Vec3 &b) {
+   Vec3 cross(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+   return std::atan2(std::sqrt(cross.dot(cross)), a.dot(b)) * 180.0f / 3.14159265f;
+}
+
+} // namespace
+
+TEST_CASE("OctNormal decodes close to the normalized input") {
+   for (int i = 0; i < 1000; ++i) {
+      float theta = i * 0.37f;
+      float phi = i * 0.011f;
+      Vec3 normal(
+          std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)
+      );
+      CHECK(degrees_between(OctNormal(normal * 3.0f).decode(), normal) < 0.01f);
+   }
+
+   Vec3 down = OctNormal(Vec3(0, 0, -1)).decode();
+   CHECK(down.z == doctest::Approx(-1));
+}
@@ -13,6 +13,22 @@ struct alignas(16) Vec3 {
       return {-x, -y, -z};
    }
 
+   inline Vec3 operator+(const Vec3 &other) const {
+      return {x + other.x, y + other.y, z + other.z};
+   }
+
+   inline Vec3 operator-(const Vec3 &other) const {
+      return {x - other.x, y - other.y, z - other.z};
+   }
+
+   inline Vec3 operator*(float scalar) const {
+      return {x * scalar, y * scalar, z * scalar};
+   }
+
+   inline float dot(const Vec3 &other) const {
+      return x * other.x + y * other.y + z * other.z;
+   }
+
    float x;
    float y;
    float z;
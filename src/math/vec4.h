@@ -1,6 +1,8 @@
 #ifndef VKAD_MATH_VEC4_H_
 #define VKAD_MATH_VEC4_H_
 
+#include <vulkan/vulkan_core.h>
+
 #include "util/assert.h"
 
 namespace vkad {
@@ -47,6 +49,8 @@ struct alignas(16) Vec4 {
    float y;
    float z;
    float w;
+
+   static constexpr VkFormat kFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
 };
 
 } // namespace vkad
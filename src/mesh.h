@@ -2,6 +2,7 @@
 #define VKAD_MESH_H_
 
 #include "gpu/buffer.h"
+#include "math/bounds.h"
 
 #include <vector>
 
@@ -35,12 +36,19 @@ public:
       return id_;
    }
 
+   /// Bounds of the vertices as of the last Renderer::init_mesh(), init_dynamic_mesh() or
+   /// update_mesh()
+   inline const Bounds &bounds() const {
+      return bounds_;
+   }
+
 protected:
    std::vector<Vertex> vertices_;
    std::vector<VertexIndexBuffer::IndexType> indices_;
 
 private:
    int id_;
+   Bounds bounds_;
 
    friend class vkad::Renderer;
 };
@@ -0,0 +1,131 @@
+#ifndef VKAD_RENDER_QUEUE_H_
+#define VKAD_RENDER_QUEUE_H_
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include "util/assert.h"
+#include "util/radix_sort.h"
+
+namespace vkad {
+
+/// One draw for Renderer::draw_parallel() and the render queue
+struct DrawItem {
+   int material_id;
+   uint32_t uniform_offset;
+   int mesh_id;
+};
+
+/// State changes recorded in a frame, and how many were skipped because the state was already bound
+struct BindStats {
+   uint32_t num_draws;
+   /// Indirect commands written by the occlusion culler. With VK_KHR_draw_indirect_count only the
+   /// visible ones are drawn, otherwise culled ones draw nothing. Not part of num_draws,
+   /// Renderer::cull_stats() tells how many were visible.
+   uint32_t num_culled_commands;
+   uint32_t pipeline_binds;
+   uint32_t pipeline_binds_saved;
+   uint32_t descriptor_binds;
+   uint32_t descriptor_binds_saved;
+   /// Vertex and index buffers are bound together
+   uint32_t vertex_binds;
+   uint32_t vertex_binds_saved;
+   /// Viewport and scissor are set once per command buffer rather than with every pipeline bind
+   uint32_t viewport_binds_saved;
+
+   BindStats &operator+=(const BindStats &other) {
+      num_draws += other.num_draws;
+      num_culled_commands += other.num_culled_commands;
+      pipeline_binds += other.pipeline_binds;
+      pipeline_binds_saved += other.pipeline_binds_saved;
+      descriptor_binds += other.descriptor_binds;
+      descriptor_binds_saved += other.descriptor_binds_saved;
+      vertex_binds += other.vertex_binds;
+      vertex_binds_saved += other.vertex_binds_saved;
+      viewport_binds_saved += other.viewport_binds_saved;
+      return *this;
+   }
+};
+
+/// Collects draws and orders them by a packed 64-bit key so that draws sharing a pipeline and
+/// geometry buffers end up next to each other. From the most to the least significant bits the key
+/// holds the layer, the material, the geometry (which buffers the mesh lives in) and the depth.
+class RenderQueue {
+public:
+   static constexpr int kLayerBits = 8;
+   static constexpr int kMaterialBits = 12;
+   static constexpr int kGeometryBits = 20;
+   static constexpr int kDepthBits = 24;
+
+   /// Layers are drawn in increasing order regardless of material, e.g. UI on top of the scene.
+   /// `geometry` only has to be equal for meshes sharing buffers, it is truncated to fit. Draws
+   /// with a smaller `depth` come first; negative depths are treated as 0.
+   static uint64_t sort_key(int layer, int material_id, uint32_t geometry, float depth) {
+      VKAD_ASSERT(layer >= 0 && layer < (1 << kLayerBits), "render queue layer out of range");
+      VKAD_ASSERT(
+          material_id >= 0 && material_id < (1 << kMaterialBits),
+          "too many materials for the render queue sort key"
+      );
+
+      // The bits of a non-negative float sort the same way as the float itself
+      uint32_t depth_bits = std::bit_cast<uint32_t>(depth > 0 ? depth : 0.0f) >> (32 - kDepthBits);
+      uint64_t key = static_cast<uint64_t>(layer);
+      key = (key << kMaterialBits) | static_cast<uint64_t>(material_id);
+      key = (key << kGeometryBits) | (geometry & ((1u << kGeometryBits) - 1));
+      key = (key << kDepthBits) | depth_bits;
+      return key;
+   }
+
+   void push(uint64_t key, const DrawItem &item) {
+      entries_.push_back({.key = key, .index = static_cast<uint32_t>(items_.size())});
+      items_.push_back(item);
+   }
+
+   /// Sorts the queued draws by key. Draws with equal keys stay in the order they were pushed.
+   void sort() {
+      radix_sort(entries_, scratch_, [](const Entry &entry) {
+         return entry.key;
+      });
+
+      sorted_.resize(entries_.size());
+      for (size_t i = 0; i < entries_.size(); ++i) {
+         sorted_[i] = items_[entries_[i].index];
+      }
+   }
+
+   /// The draws in sorted order, only valid after sort()
+   inline const std::vector<DrawItem> &sorted() const {
+      return sorted_;
+   }
+
+   inline size_t size() const {
+      return items_.size();
+   }
+
+   inline bool empty() const {
+      return items_.empty();
+   }
+
+   void clear() {
+      entries_.clear();
+      items_.clear();
+      sorted_.clear();
+   }
+
+private:
+   struct Entry {
+      uint64_t key;
+      uint32_t index;
+   };
+
+   std::vector<Entry> entries_;
+   std::vector<Entry> scratch_;
+   std::vector<DrawItem> items_;
+   std::vector<DrawItem> sorted_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_RENDER_QUEUE_H_
@@ -0,0 +1,35 @@
+#include "render_queue.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "vendor/doctest.h"
+
+using namespace vkad;
+
+TEST_CASE("RenderQueue sort keys order by layer, material, geometry, then depth") {
+   CHECK(RenderQueue::sort_key(0, 5, 5, 100.0f) < RenderQueue::sort_key(1, 0, 0, 0.0f));
+   CHECK(RenderQueue::sort_key(0, 1, 5, 100.0f) < RenderQueue::sort_key(0, 2, 0, 0.0f));
+   CHECK(RenderQueue::sort_key(0, 1, 1, 100.0f) < RenderQueue::sort_key(0, 1, 2, 0.0f));
+   CHECK(RenderQueue::sort_key(0, 1, 1, 0.5f) < RenderQueue::sort_key(0, 1, 1, 2.0f));
+   CHECK(RenderQueue::sort_key(0, 1, 1, -1.0f) == RenderQueue::sort_key(0, 1, 1, 0.0f));
+}
+
+TEST_CASE("RenderQueue groups draws by material and keeps submission order for equal keys") {
+   RenderQueue queue;
+   queue.push(RenderQueue::sort_key(1, 0, 0, 0), {.material_id = 0, .mesh_id = 10});
+   queue.push(RenderQueue::sort_key(0, 2, 0, 0), {.material_id = 2, .mesh_id = 11});
+   queue.push(RenderQueue::sort_key(0, 1, 0, 0), {.material_id = 1, .mesh_id = 12});
+   queue.push(RenderQueue::sort_key(0, 2, 0, 0), {.material_id = 2, .mesh_id = 13});
+   queue.push(RenderQueue::sort_key(1, 0, 0, 0), {.material_id = 0, .mesh_id = 14});
+   queue.sort();
+
+   std::vector<int> meshes;
+   for (const DrawItem &item : queue.sorted()) {
+      meshes.push_back(item.mesh_id);
+   }
+   CHECK(meshes == std::vector<int>{12, 11, 13, 10, 14});
+
+   queue.clear();
+   CHECK(queue.empty());
+}
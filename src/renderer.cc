@@ -1,82 +1,88 @@
 #include "renderer.h"
 
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <exception>
 #include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
-#include <fmod.h>
 #include <vulkan/vulkan_core.h>
 
 #include "gpu/buffer.h"
 #include "gpu/instance.h"
 #include "gpu/physical_device.h"
 #include "gpu/pipeline.h"
+#include "gpu/pipeline_cache.h"
 #include "gpu/status.h"
 #include "gpu/swapchain.h"
 #include "mesh.h"
 #include "util/assert.h"
 #include "util/memory.h"
+#include "util/ring_allocator.h"
+#include "util/trace.h"
 
 using namespace vkad;
 
 Renderer::Renderer(
-    Instance &vk_instance, VkSurfaceKHR surface, uint32_t initial_width, uint32_t initial_height
+    Instance &vk_instance, VkSurfaceKHR surface, uint32_t initial_width, uint32_t initial_height,
+    int frames_in_flight, bool visualize_overdraw, PresentProfile present_profile
 )
     : vk_instance_(vk_instance),
       physical_device_(vk_instance_, surface),
       device_(physical_device_),
-      swapchain_(
-          {physical_device_.graphics_queue(), physical_device_.present_queue()},
-          physical_device_.handle(), device_.handle(), surface, initial_width, initial_height
-      ),
-      render_pass_(VK_NULL_HANDLE),
+      allocator_(device_.handle(), physical_device_),
+      pipeline_cache_(device_.handle(), physical_device_, kPipelineCachePath),
+      pipeline_creation_ms_(0),
+      present_profile_(present_profile),
+      render_graph_(allocator_),
+      graph_swapchain_(-1),
+      graph_depth_(-1),
+      scene_pass_(-1),
+      hiz_pass_(-1),
+      visualize_overdraw_(visualize_overdraw),
+      depth_format_(physical_device_.find_depth_format()),
+      input_time_(std::chrono::steady_clock::now()),
+      occlusion_culling_requested_(false),
+      cull_stats_(),
+      frame_scope_(-1),
+      material_scope_(-1),
+      bindless_layout_(VK_NULL_HANDLE),
       meshes_(16),
-      staging_buffer_(1024 * 1024 * 8, device_.handle(), physical_device_) {
-
-   VkAttachmentDescription color_attachment = {
-       .format = swapchain_.img_format(),
-       .samples = VK_SAMPLE_COUNT_1_BIT,
-       .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-       .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-       .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-       .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-       .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-       .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-   };
-
-   VkAttachmentReference color_attachment_ref = {
-       .attachment = 0,
-       .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-   };
-
-   VkSubpassDescription subpass = {
-       .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-       .colorAttachmentCount = 1,
-       .pColorAttachments = &color_attachment_ref,
-   };
-
-   VkSubpassDependency subpass_dependency = {
-       .srcSubpass = VK_SUBPASS_EXTERNAL,
-       .dstSubpass = 0,
-       .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-       .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-       .srcAccessMask = 0,
-       .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-   };
-
-   VkRenderPassCreateInfo render_create = {
-       .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-       .attachmentCount = 1,
-       .pAttachments = &color_attachment,
-       .subpassCount = 1,
-       .pSubpasses = &subpass,
-       .dependencyCount = 1,
-       .pDependencies = &subpass_dependency,
-   };
-
-   VKAD_VK(vkCreateRenderPass(device_.handle(), &render_create, nullptr, &render_pass_));
+      instance_buffers_(16),
+      upload_cmd_buf_(VK_NULL_HANDLE),
+      upload_serial_(0),
+      frames_(frames_in_flight),
+      current_frame_(0),
+      current_frame_ready_(false),
+      frame_serial_(0),
+      primary_command_buffer_(VK_NULL_HANDLE),
+      command_buffer_(VK_NULL_HANDLE),
+      bound_(kNothingBound),
+      bind_stats_(),
+      last_bind_stats_(),
+      secondary_recording_(false),
+      staging_buffer_(kStagingCapacity, allocator_),
+      uniform_ring_(std::in_place, kInitialUniformRingSize, frames_in_flight, allocator_) {
+
+   if (surface != VK_NULL_HANDLE) {
+      std::vector<uint32_t> queue_families = {
+          physical_device_.graphics_queue(), physical_device_.present_queue()
+      };
+      swapchain_.emplace(
+          queue_families, physical_device_.handle(), device_.handle(), surface, initial_width,
+          initial_height, present_profile_
+      );
+   } else {
+      offscreen_.emplace(allocator_, initial_width, initial_height, frames_in_flight);
+   }
 
-   create_framebuffers();
+   build_render_graph();
 
    VkSamplerCreateInfo sampler_create = {
        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
@@ -89,92 +95,199 @@ Renderer::Renderer(
    };
    VKAD_VK(vkCreateSampler(device_.handle(), &sampler_create, nullptr, &sampler_));
 
-   command_pool_.init(device_.handle(), physical_device_.graphics_queue());
-   command_buffer_ = command_pool_.allocate();
+   if (physical_device_.descriptor_indexing_supported()) {
+      bindless_.emplace(
+          device_.handle(), physical_device_.max_bindless_images(),
+          physical_device_.max_bindless_buffers()
+      );
+
+      VkDescriptorSetLayout set_layout = bindless_->layout();
+      VkPushConstantRange push_constant_range = {
+          .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+          .offset = 0,
+          .size = kBindlessPushConstantSize,
+      };
+      VkPipelineLayoutCreateInfo layout_create = {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+          .setLayoutCount = 1,
+          .pSetLayouts = &set_layout,
+          .pushConstantRangeCount = 1,
+          .pPushConstantRanges = &push_constant_range,
+      };
+      VKAD_VK(
+          vkCreatePipelineLayout(device_.handle(), &layout_create, nullptr, &bindless_layout_)
+      );
+   }
 
    VkSemaphoreCreateInfo semaphore_create = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
    VkFenceCreateInfo fence_create = {
        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, .flags = VK_FENCE_CREATE_SIGNALED_BIT
    };
 
-   if (vkCreateSemaphore(device_.handle(), &semaphore_create, nullptr, &sem_img_avail) !=
-           VK_SUCCESS ||
-       vkCreateSemaphore(device_.handle(), &semaphore_create, nullptr, &sem_render_complete) !=
-           VK_SUCCESS ||
-       vkCreateFence(device_.handle(), &fence_create, nullptr, &draw_cycle_complete) !=
-           VK_SUCCESS) {
-      throw std::runtime_error("failed to create semaphore(s)");
+   for (Frame &frame : frames_) {
+      frame.command_pool.init(device_.handle(), physical_device_.graphics_queue());
+      frame.secondary_pool.init(
+          device_.handle(), physical_device_.graphics_queue(), VK_COMMAND_BUFFER_LEVEL_SECONDARY
+      );
+      frame.cull_command_buffer = VK_NULL_HANDLE;
+      frame.num_cull_objects = 0;
+      frame.count_culled_draws = false;
+      frame.num_indirect_commands = 0;
+      frame.serial = 0;
+
+      if (vkCreateSemaphore(device_.handle(), &semaphore_create, nullptr, &frame.sem_img_avail) !=
+              VK_SUCCESS ||
+          vkCreateSemaphore(
+              device_.handle(), &semaphore_create, nullptr, &frame.sem_render_complete
+          ) != VK_SUCCESS ||
+          vkCreateFence(device_.handle(), &fence_create, nullptr, &frame.draw_cycle_complete) !=
+              VK_SUCCESS) {
+         throw std::runtime_error("failed to create semaphore(s)");
+      }
    }
 }
 
 Renderer::~Renderer() {
    device_.wait_idle();
 
+   if (!pipeline_cache_.save()) {
+      std::cerr << "Failed to write " << kPipelineCachePath << "\n";
+   }
+
    for (const Material &mat : materials_) {
-      vkDestroyDescriptorSetLayout(device_.handle(), mat.descriptor_set_layout, nullptr);
+      if (mat.descriptor_set_layout != VK_NULL_HANDLE) {
+         vkDestroyDescriptorSetLayout(device_.handle(), mat.descriptor_set_layout, nullptr);
+      }
    }
 
    for (const auto &kv : shaders_) {
       vkDestroyShaderModule(device_.handle(), kv.second.module, nullptr);
    }
 
-   vkDestroySemaphore(device_.handle(), sem_img_avail, nullptr);
-   vkDestroySemaphore(device_.handle(), sem_render_complete, nullptr);
-   vkDestroyFence(device_.handle(), draw_cycle_complete, nullptr);
+   for (UploadBatch &batch : pending_uploads_) {
+      vkDestroyFence(device_.handle(), batch.fence, nullptr);
+      batch.command_pool.deinit();
+   }
 
-   vkDestroySampler(device_.handle(), sampler_, nullptr);
+   for (CommandPool &pool : free_upload_pools_) {
+      pool.deinit();
+   }
+   upload_pool_.deinit();
 
-   for (const VkFramebuffer framebuffer : framebuffers_) {
-      vkDestroyFramebuffer(device_.handle(), framebuffer, nullptr);
+   for (const VkFence fence : free_upload_fences_) {
+      vkDestroyFence(device_.handle(), fence, nullptr);
    }
 
-   command_pool_.deinit();
+   for (const VkSemaphore semaphore : pending_upload_semaphores_) {
+      vkDestroySemaphore(device_.handle(), semaphore, nullptr);
+   }
 
-   if (render_pass_ != VK_NULL_HANDLE) {
-      vkDestroyRenderPass(device_.handle(), render_pass_, nullptr);
+   for (const VkSemaphore semaphore : free_upload_semaphores_) {
+      vkDestroySemaphore(device_.handle(), semaphore, nullptr);
+   }
+
+   for (Frame &frame : frames_) {
+      frame.command_pool.deinit();
+      frame.secondary_pool.deinit();
+      for (CommandPool &pool : frame.worker_pools) {
+         pool.deinit();
+      }
+      vkDestroySemaphore(device_.handle(), frame.sem_img_avail, nullptr);
+      vkDestroySemaphore(device_.handle(), frame.sem_render_complete, nullptr);
+      vkDestroyFence(device_.handle(), frame.draw_cycle_complete, nullptr);
+
+      for (const VkSemaphore semaphore : frame.upload_semaphores) {
+         vkDestroySemaphore(device_.handle(), semaphore, nullptr);
+      }
+   }
+
+   vkDestroySampler(device_.handle(), sampler_, nullptr);
+
+   if (bindless_layout_ != VK_NULL_HANDLE) {
+      vkDestroyPipelineLayout(device_.handle(), bindless_layout_, nullptr);
    }
 }
 
 int Renderer::do_create_pipeline(
     uint32_t vertex_size, const std::vector<VkVertexInputAttributeDescription> &attrs,
     const std::vector<std::string> &shader_paths,
-    const std::vector<VkDescriptorSetLayoutBinding> &bindings
+    const std::vector<VkDescriptorSetLayoutBinding> &bindings, uint32_t instance_size,
+    const PipelineOptions &options
 ) {
-   VkVertexInputBindingDescription binding = {
+   VKAD_ASSERT(
+       options.push_constant_size <= physical_device_.properties().limits.maxPushConstantsSize,
+       "push constants exceed maxPushConstantsSize"
+   );
+
+   std::vector<VkVertexInputBindingDescription> vertex_bindings = {{
        .binding = 0,
        .stride = vertex_size,
        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-   };
+   }};
+
+   if (instance_size != 0) {
+      vertex_bindings.push_back({
+          .binding = 1,
+          .stride = instance_size,
+          .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+      });
+   }
 
+   PipelineOptions pipeline_options = options;
    std::vector<Shader> shaders;
    for (const std::string &path : shader_paths) {
       ensure_shader_loaded(path);
       shaders.push_back(shaders_[path]);
    }
 
-   VkDescriptorSetLayoutCreateInfo layout_create = {
-       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-       .bindingCount = static_cast<uint32_t>(bindings.size()),
-       .pBindings = bindings.data(),
-   };
-   VkDescriptorSetLayout layout;
-   VKAD_VK(vkCreateDescriptorSetLayout(device_.handle(), &layout_create, nullptr, &layout));
-
-   std::vector<VkDescriptorPoolSize> sizes;
-   sizes.reserve(bindings.size());
-   for (const auto &binding : bindings) {
-      sizes.push_back({
-          .type = binding.descriptorType,
-          .descriptorCount = binding.descriptorCount,
-      });
+   if (visualize_overdraw_) {
+      ensure_shader_loaded(kOverdrawShaderPath);
+      for (Shader &shader : shaders) {
+         if (shader.type == VK_SHADER_STAGE_FRAGMENT_BIT) {
+            shader = shaders_[kOverdrawShaderPath];
+         }
+      }
+      pipeline_options.blend = BlendMode::ADDITIVE;
+   }
+
+   // Bindless materials share their layout, so all they need is the pipeline
+   bool bindless = options.shared_layout != VK_NULL_HANDLE;
+   VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+   std::optional<DescriptorPool> descriptor_pool;
+   if (!bindless) {
+      VkDescriptorSetLayoutCreateInfo layout_create = {
+          .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+          .bindingCount = static_cast<uint32_t>(bindings.size()),
+          .pBindings = bindings.data(),
+      };
+      VKAD_VK(vkCreateDescriptorSetLayout(device_.handle(), &layout_create, nullptr, &layout));
+
+      descriptor_pool.emplace(device_.handle(), layout, DescriptorPool::pool_sizes(bindings), 1);
    }
 
+   VkShaderStageFlags push_constant_stages = VK_SHADER_STAGE_VERTEX_BIT;
+   if (bindless) {
+      push_constant_stages |= VK_SHADER_STAGE_FRAGMENT_BIT;
+   }
+
+   auto start = std::chrono::steady_clock::now();
    materials_.emplace_back(Material{
+       .name = shader_paths[0].substr(0, shader_paths[0].find("-vert")),
        .descriptor_set_layout = layout,
-       .pipeline = Pipeline(device_.handle(), binding, attrs, shaders, layout, render_pass_),
-       .descriptor_pool = DescriptorPool(device_.handle(), layout, sizes, 1),
+       .bindings = bindless ? std::vector<VkDescriptorSetLayoutBinding>() : bindings,
+       .pipeline = Pipeline(
+           device_.handle(), vertex_bindings, attrs, shaders, layout,
+           render_graph_.render_pass(scene_pass_), pipeline_cache_.handle(), pipeline_options
+       ),
+       .descriptor_pool = std::move(descriptor_pool),
        .descriptor_set = VK_NULL_HANDLE,
+       .uniform_ring_range = 0,
+       .push_constant_stages = push_constant_stages,
+       .bindless = bindless,
    });
+   std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+   pipeline_creation_ms_ += elapsed.count();
+
    return materials_.size() - 1;
 }
 
@@ -188,6 +301,8 @@ void Renderer::ensure_shader_loaded(const std::string &path) {
       shader.type = VK_SHADER_STAGE_VERTEX_BIT;
    } else if (path.find("frag") != std::string::npos) {
       shader.type = VK_SHADER_STAGE_FRAGMENT_BIT;
+   } else if (path.find("comp") != std::string::npos) {
+      shader.type = VK_SHADER_STAGE_COMPUTE_BIT;
    } else {
       VKAD_PANIC("couldn't determine shader type of {}", path);
    }
@@ -215,195 +330,1252 @@ void Renderer::ensure_shader_loaded(const std::string &path) {
 }
 
 void Renderer::recreate_swapchain(uint32_t width, uint32_t height, VkSurfaceKHR surface) {
-   swapchain_ = std::move(Swapchain(
-       {physical_device_.graphics_queue(), physical_device_.present_queue()},
-       physical_device_.handle(), device_.handle(), surface, width, height
-   ));
+   VKAD_ASSERT(swapchain_.has_value(), "headless renderers have no swapchain");
+   // The render graph's transient images are recreated, so no frame may still render into them.
+   // The presentation engine keeps showing the old swapchain's images meanwhile.
+   wait_for_frames();
+
+   Swapchain old_swapchain = std::move(*swapchain_);
+   swapchain_.emplace(
+       std::vector<uint32_t>{physical_device_.graphics_queue(), physical_device_.present_queue()},
+       physical_device_.handle(), device_.handle(), surface, width, height, present_profile_,
+       old_swapchain.handle()
+   );
+   retire(std::move(old_swapchain));
+   frame_pacing_.reset();
 
-   for (const VkFramebuffer framebuffer : framebuffers_) {
-      vkDestroyFramebuffer(device_.handle(), framebuffer, nullptr);
+   render_graph_.resize(swapchain_->extent());
+   if (occlusion_culler_.has_value()) {
+      occlusion_culler_->resize(render_graph_.image(graph_depth_));
    }
-
-   create_framebuffers();
 }
 
-void Renderer::begin_preframe() {
-   preframe_cmd_buf_ = command_pool_.allocate();
+std::vector<uint8_t> Renderer::read_pixels() {
+   VKAD_ASSERT(offscreen_.has_value(), "only headless renderers can read back their frames");
+   VKAD_ASSERT(frame_serial_ > 0, "no frame has been drawn yet");
 
-   VkCommandBufferBeginInfo begin_info = {
+   VkExtent2D extent = offscreen_->extent();
+   VkDeviceSize size = VkDeviceSize(extent.width) * extent.height * 4;
+   Buffer readback(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::READBACK, allocator_);
+
+   CommandPool pool;
+   pool.init(device_.handle(), physical_device_.graphics_queue());
+   VkCommandBuffer cmd_buf = pool.acquire();
+   VkCommandBufferBeginInfo cmd_begin = {
        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
    };
-   VKAD_VK(vkBeginCommandBuffer(preframe_cmd_buf_, &begin_info));
-}
+   VKAD_VK(vkBeginCommandBuffer(cmd_buf, &cmd_begin));
+   // end_draw() left the index of the last frame's image behind
+   offscreen_->record_copy(cmd_buf, current_framebuffer_, readback.buffer());
+   VKAD_VK(vkEndCommandBuffer(cmd_buf));
 
-void Renderer::buffer_copy(const StagingBuffer &src, Buffer &dst) {
-   VkBufferCopy copy_region = {
-       .srcOffset = 0,
-       .dstOffset = 0,
-       .size = src.size(),
-   };
-   vkCmdCopyBuffer(preframe_cmd_buf_, src.buffer(), dst.buffer(), 1, &copy_region);
-}
-
-void Renderer::upload_texture(const StagingBuffer &src, Image &image) {
-   VkBufferImageCopy region = {
-       .imageSubresource =
-           {
-               .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-               .mipLevel = 0,
-               .baseArrayLayer = 0,
-               .layerCount = 1,
-           },
-       .imageExtent =
-           {
-               .width = static_cast<uint32_t>(image.width()),
-               .height = static_cast<uint32_t>(image.height()),
-               .depth = 1,
-           },
+   VkSubmitInfo submit_info = {
+       .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+       .commandBufferCount = 1,
+       .pCommandBuffers = &cmd_buf,
    };
+   VKAD_VK(vkQueueSubmit(device_.graphics_queue(), 1, &submit_info, VK_NULL_HANDLE));
+   device_.wait_idle();
+   pool.deinit();
 
-   vkCmdCopyBufferToImage(
-       preframe_cmd_buf_, src.buffer(), image.handle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-       &region
-   );
+   readback.invalidate(0, size);
+   const uint8_t *pixels = reinterpret_cast<const uint8_t *>(readback.mapped());
+   return std::vector<uint8_t>(pixels, pixels + size);
+}
+
+void Renderer::upload_buffer(const void *data, size_t size, Buffer &dst, VkDeviceSize dst_offset) {
+   const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+
+   for (size_t copied = 0; copied < size;) {
+      size_t chunk_size = std::min<size_t>(size - copied, kMaxUploadChunk);
+      VkDeviceSize src_offset = stage(bytes + copied, chunk_size, 4);
+
+      VkBufferCopy copy_region = {
+          .srcOffset = src_offset,
+          .dstOffset = dst_offset + copied,
+          .size = chunk_size,
+      };
+      vkCmdCopyBuffer(
+          upload_command_buffer(), staging_buffer_.buffer(), dst.buffer(), 1, &copy_region
+      );
+
+      // Staging may have flushed the batch, so the buffer is tracked per chunk. Concurrent buffers
+      // need no ownership transfer.
+      if (!dst.concurrent() &&
+          std::find(upload_dst_buffers_.begin(), upload_dst_buffers_.end(), dst.buffer()) ==
+              upload_dst_buffers_.end()) {
+         upload_dst_buffers_.push_back(dst.buffer());
+      }
+
+      copied += chunk_size;
+   }
+}
+
+const void *Renderer::index_data(
+    const std::vector<VertexIndexBuffer::IndexType> &indices, VkIndexType type
+) {
+   if (type == VK_INDEX_TYPE_UINT32) {
+      return indices.data();
+   }
+
+   index_scratch_.resize(indices.size());
+   write_indices(indices, type, index_scratch_.data());
+   return index_scratch_.data();
+}
+
+void Renderer::upload_image(const void *data, size_t size, Image &image) {
+   const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+   size_t row_size = size / image.height();
+   uint32_t rows_per_chunk = static_cast<uint32_t>(std::max<size_t>(kMaxUploadChunk / row_size, 1));
+
+   transfer_image_layout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+   for (uint32_t row = 0; row < image.height(); row += rows_per_chunk) {
+      uint32_t num_rows = std::min(rows_per_chunk, image.height() - row);
+      VkDeviceSize src_offset = stage(bytes + row * row_size, num_rows * row_size, 16);
+
+      VkBufferImageCopy region = {
+          .bufferOffset = src_offset,
+          .imageSubresource =
+              {
+                  .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                  .mipLevel = 0,
+                  .baseArrayLayer = 0,
+                  .layerCount = 1,
+              },
+          .imageOffset = {0, static_cast<int32_t>(row), 0},
+          .imageExtent =
+              {
+                  .width = image.width(),
+                  .height = num_rows,
+                  .depth = 1,
+              },
+      };
+
+      vkCmdCopyBufferToImage(
+          upload_command_buffer(), staging_buffer_.buffer(), image.handle(),
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region
+      );
+   }
+
+   if (separate_transfer_queue()) {
+      pending_image_acquires_.push_back(image.queue_release(
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, physical_device_.transfer_queue(),
+          physical_device_.graphics_queue(), upload_command_buffer()
+      ));
+   } else {
+      transfer_image_layout(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+   }
 }
 
-void Renderer::end_preframe() {
-   vkEndCommandBuffer(preframe_cmd_buf_);
+void Renderer::flush_uploads() {
+   if (upload_cmd_buf_ == VK_NULL_HANDLE) {
+      return;
+   }
+
+   bool separate_queue = separate_transfer_queue();
+
+   if (separate_queue) {
+      // Hand the written buffers over to the graphics queue, which acquires them in the next frame
+      std::vector<VkBufferMemoryBarrier> releases;
+      releases.reserve(upload_dst_buffers_.size());
+      for (const VkBuffer buffer : upload_dst_buffers_) {
+         VkBufferMemoryBarrier barrier = {
+             .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+             .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+             .dstAccessMask = 0,
+             .srcQueueFamilyIndex = physical_device_.transfer_queue(),
+             .dstQueueFamilyIndex = physical_device_.graphics_queue(),
+             .buffer = buffer,
+             .offset = 0,
+             .size = VK_WHOLE_SIZE,
+         };
+         releases.push_back(barrier);
+
+         barrier.srcAccessMask = 0;
+         barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+         pending_buffer_acquires_.push_back(barrier);
+      }
+
+      vkCmdPipelineBarrier(
+          upload_cmd_buf_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+          0, nullptr, releases.size(), releases.data(), 0, nullptr
+      );
+   } else {
+      // Make the copies visible to vertex input of every later submission
+      VkMemoryBarrier barrier = {
+          .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+          .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+          .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+      };
+      vkCmdPipelineBarrier(
+          upload_cmd_buf_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+          1, &barrier, 0, nullptr, 0, nullptr
+      );
+   }
+
+   upload_dst_buffers_.clear();
+   VKAD_VK(vkEndCommandBuffer(upload_cmd_buf_));
+
+   VkFence fence;
+   if (free_upload_fences_.empty()) {
+      VkFenceCreateInfo fence_create = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+      VKAD_VK(vkCreateFence(device_.handle(), &fence_create, nullptr, &fence));
+   } else {
+      fence = free_upload_fences_.back();
+      free_upload_fences_.pop_back();
+   }
 
    VkSubmitInfo submit_info = {
        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
        .commandBufferCount = 1,
-       .pCommandBuffers = &preframe_cmd_buf_,
+       .pCommandBuffers = &upload_cmd_buf_,
    };
-   vkQueueSubmit(device_.graphics_queue(), 1, &submit_info, VK_NULL_HANDLE);
-   vkQueueWaitIdle(device_.graphics_queue());
+
+   if (separate_queue) {
+      // The next frame waits on this before acquiring the uploaded resources
+      VkSemaphore semaphore;
+      if (free_upload_semaphores_.empty()) {
+         VkSemaphoreCreateInfo semaphore_create = {
+             .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+         };
+         VKAD_VK(vkCreateSemaphore(device_.handle(), &semaphore_create, nullptr, &semaphore));
+      } else {
+         semaphore = free_upload_semaphores_.back();
+         free_upload_semaphores_.pop_back();
+      }
+
+      pending_upload_semaphores_.push_back(semaphore);
+      submit_info.signalSemaphoreCount = 1;
+      submit_info.pSignalSemaphores = &pending_upload_semaphores_.back();
+   }
+
+   VKAD_VK(vkQueueSubmit(device_.transfer_queue(), 1, &submit_info, fence));
+
+   ++upload_serial_;
+   staging_buffer_.close_batch(upload_serial_);
+   pending_uploads_.push_back({
+       .command_pool = std::move(upload_pool_),
+       .fence = fence,
+       .serial = upload_serial_,
+   });
+   upload_pool_ = CommandPool();
+   upload_cmd_buf_ = VK_NULL_HANDLE;
 }
 
-bool Renderer::begin_draw() {
-   vkWaitForFences(device_.handle(), 1, &draw_cycle_complete, VK_TRUE, UINT64_MAX);
+VkCommandBuffer Renderer::upload_command_buffer() {
+   if (upload_cmd_buf_ != VK_NULL_HANDLE) {
+      return upload_cmd_buf_;
+   }
+
+   reclaim_uploads();
+
+   if (free_upload_pools_.empty()) {
+      upload_pool_.init(device_.handle(), physical_device_.transfer_queue());
+   } else {
+      upload_pool_ = std::move(free_upload_pools_.back());
+      free_upload_pools_.pop_back();
+   }
+   upload_cmd_buf_ = upload_pool_.acquire();
+
+   VkCommandBufferBeginInfo begin_info = {
+       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+       .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+   };
+   VKAD_VK(vkBeginCommandBuffer(upload_cmd_buf_, &begin_info));
+
+   // Frames in flight may still be reading buffers that are about to be overwritten. A dedicated
+   // transfer queue can't wait on vertex input, update_mesh() waits for the device instead.
+   if (!separate_transfer_queue()) {
+      vkCmdPipelineBarrier(
+          upload_cmd_buf_, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+          0, nullptr, 0, nullptr, 0, nullptr
+      );
+   }
+
+   return upload_cmd_buf_;
+}
+
+VkDeviceSize Renderer::stage(const void *data, size_t size, VkDeviceSize alignment) {
+   VkDeviceSize offset = staging_buffer_.write(data, size, alignment);
+
+   while (offset == RingAllocator::kInvalidOffset) {
+      // The ring is full. Submit what has been recorded so far and wait for the oldest batch of
+      // copies to finish so its space can be reused.
+      flush_uploads();
+      VKAD_ASSERT(!pending_uploads_.empty(), "upload chunk is larger than the staging ring");
+
+      UploadBatch &oldest = pending_uploads_.front();
+      vkWaitForFences(device_.handle(), 1, &oldest.fence, VK_TRUE, UINT64_MAX);
+      reclaim_uploads();
+
+      offset = staging_buffer_.write(data, size, alignment);
+   }
+
+   return offset;
+}
+
+void Renderer::reclaim_uploads() {
+   while (!pending_uploads_.empty()) {
+      UploadBatch &batch = pending_uploads_.front();
+      if (vkGetFenceStatus(device_.handle(), batch.fence) != VK_SUCCESS) {
+         break;
+      }
+
+      staging_buffer_.release_until(batch.serial);
+      vkResetFences(device_.handle(), 1, &batch.fence);
+      free_upload_fences_.push_back(batch.fence);
+      batch.command_pool.reset();
+      free_upload_pools_.emplace_back(std::move(batch.command_pool));
+      pending_uploads_.pop_front();
+   }
+}
+
+void Renderer::wait_for_frames() {
+   std::vector<VkFence> fences;
+   for (int i = 0; i < frames_.size(); ++i) {
+      // The fence of the frame being recorded is reset and only signals after its submission
+      if (i != current_frame_ || primary_command_buffer_ == VK_NULL_HANDLE) {
+         fences.push_back(frames_[i].draw_cycle_complete);
+      }
+   }
+   if (fences.empty()) {
+      return;
+   }
+   vkWaitForFences(device_.handle(), fences.size(), fences.data(), VK_TRUE, UINT64_MAX);
+}
+
+void Renderer::wait_for_current_frame() {
+   if (current_frame_ready_) {
+      return;
+   }
+   current_frame_ready_ = true;
+
+   Frame &frame = frames_[current_frame_];
+   {
+      VKAD_TRACE_ZONE("wait for frame fence");
+      vkWaitForFences(device_.handle(), 1, &frame.draw_cycle_complete, VK_TRUE, UINT64_MAX);
+   }
+
+   free_upload_semaphores_.insert(
+       free_upload_semaphores_.end(), frame.upload_semaphores.begin(), frame.upload_semaphores.end()
+   );
+   frame.upload_semaphores.clear();
+
+   frame.command_pool.reset();
+   frame.secondary_pool.reset();
+   for (CommandPool &pool : frame.worker_pools) {
+      pool.reset();
+   }
+   frame.secondaries.clear();
+   frame.cull_command_buffer = VK_NULL_HANDLE;
+   frame.num_indirect_commands = 0;
+   deletion_queue_.release_until(frame.serial);
+
+   if (gpu_profiler_.has_value()) {
+      gpu_profiler_->collect(current_frame_);
+   }
+
+   if (occlusion_culler_.has_value()) {
+      std::optional<CullStats> stats = occlusion_culler_->read_stats(current_frame_);
+      if (stats.has_value()) {
+         cull_stats_ = *stats;
+      }
+   }
+}
+
+CommandPoolStats Renderer::command_pool_stats() const {
+   CommandPoolStats stats = upload_pool_.stats();
 
-   VkResult next_image_res = vkAcquireNextImageKHR(
-       device_.handle(), swapchain_.handle(), UINT64_MAX, sem_img_avail, VK_NULL_HANDLE,
-       &current_framebuffer_
+   for (const UploadBatch &batch : pending_uploads_) {
+      stats += batch.command_pool.stats();
+   }
+
+   for (const CommandPool &pool : free_upload_pools_) {
+      stats += pool.stats();
+   }
+
+   for (const Frame &frame : frames_) {
+      stats += frame.command_pool.stats();
+      stats += frame.secondary_pool.stats();
+      for (const CommandPool &pool : frame.worker_pools) {
+         stats += pool.stats();
+      }
+   }
+
+   return stats;
+}
+
+void Renderer::begin_frame() {
+   wait_for_current_frame();
+   uniform_ring_->reset(current_frame_);
+   late_latch_offsets_.clear();
+}
+
+void Renderer::do_link_uniform_ring(int material_id, uint32_t range) {
+   Material &mat = materials_[material_id];
+   VKAD_ASSERT(!mat.bindless, "bindless materials take per-draw data from push constants");
+   if (mat.descriptor_set == VK_NULL_HANDLE) {
+      mat.descriptor_set = mat.descriptor_pool->allocate(mat.descriptor_set_layout);
+   }
+
+   mat.uniform_ring_range = range;
+   mat.descriptor_pool->write(
+       mat.descriptor_set, {DescriptorPool::write_uniform_ring(*uniform_ring_, range)}
+   );
+}
+
+uint32_t Renderer::write_uniform(const void *data, size_t size) {
+   uint32_t offset = uniform_ring_->allocate(size);
+   if (offset == UniformRing::kInvalidOffset) {
+      grow_uniform_ring(uniform_ring_->used() + size + physical_device_.min_uniform_alignment());
+      offset = uniform_ring_->allocate(size);
+   }
+
+   uniform_ring_->write(offset, data, size);
+   return offset;
+}
+
+void Renderer::grow_uniform_ring(VkDeviceSize min_frame_capacity) {
+   VKAD_TRACE_ZONE("grow uniform ring");
+   VkDeviceSize capacity =
+       std::bit_ceil(std::max(uniform_ring_->frame_capacity() * 2, min_frame_capacity));
+   UniformRing grown(capacity, frames_.size(), allocator_);
+   grown.copy_current_frame(*uniform_ring_);
+
+   // Frames in flight and the draws recorded so far keep reading the old ring through the old
+   // descriptor sets, so neither is touched. The old ring is retired by end_draw().
+   outgrown_rings_.push_back(std::move(*uniform_ring_));
+   uniform_ring_.emplace(std::move(grown));
+
+   for (int i = 0; i < materials_.size(); ++i) {
+      if (materials_[i].uniform_ring_range != 0) {
+         replace_uniform_ring_set(i);
+      }
+   }
+   bound_.descriptor_material_id = -1;
+}
+
+void Renderer::replace_uniform_ring_set(int material_id) {
+   Material &mat = materials_[material_id];
+   DescriptorPool pool(
+       device_.handle(), mat.descriptor_set_layout, DescriptorPool::pool_sizes(mat.bindings), 1
+   );
+   VkDescriptorSet set = pool.allocate(mat.descriptor_set_layout);
+
+   // Everything but the ring at binding 0 stays as link_material() wrote it
+   std::vector<VkCopyDescriptorSet> copies;
+   for (const VkDescriptorSetLayoutBinding &binding : mat.bindings) {
+      if (binding.binding != 0) {
+         copies.push_back({
+             .sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET,
+             .srcSet = mat.descriptor_set,
+             .srcBinding = binding.binding,
+             .dstSet = set,
+             .dstBinding = binding.binding,
+             .descriptorCount = binding.descriptorCount,
+         });
+      }
+   }
+   vkUpdateDescriptorSets(
+       device_.handle(), 0, nullptr, static_cast<uint32_t>(copies.size()), copies.data()
    );
+   pool.write(set, {DescriptorPool::write_uniform_ring(*uniform_ring_, mat.uniform_ring_range)});
+
+   retire(std::move(*mat.descriptor_pool));
+   mat.descriptor_pool.emplace(std::move(pool));
+   mat.descriptor_set = set;
+}
 
-   if (next_image_res == VK_ERROR_OUT_OF_DATE_KHR) {
-      return false;
+bool Renderer::begin_draw() {
+   VKAD_TRACE_ZONE("Renderer::begin_draw");
+   if (occlusion_culling_requested_ && !occlusion_culler_.has_value()) {
+      enable_occlusion_culling();
    }
 
-   VKAD_VK(next_image_res);
+   flush_uploads();
+   reclaim_uploads();
+
+   wait_for_current_frame();
+   Frame &frame = frames_[current_frame_];
+
+   if (swapchain_.has_value()) {
+      VkResult next_image_res;
+      {
+         VKAD_TRACE_ZONE("vkAcquireNextImageKHR");
+         next_image_res = vkAcquireNextImageKHR(
+             device_.handle(), swapchain_->handle(), UINT64_MAX, frame.sem_img_avail,
+             VK_NULL_HANDLE, &current_framebuffer_
+         );
+      }
+
+      if (next_image_res == VK_ERROR_OUT_OF_DATE_KHR) {
+         return false;
+      }
+
+      VKAD_VK(next_image_res);
+   } else {
+      // The frame's fence has signalled, so nothing reads its offscreen image anymore
+      current_framebuffer_ = current_frame_;
+   }
 
-   vkResetFences(device_.handle(), 1, &draw_cycle_complete);
-   vkResetCommandBuffer(command_buffer_, 0);
+   vkResetFences(device_.handle(), 1, &frame.draw_cycle_complete);
+   primary_command_buffer_ = frame.command_pool.acquire();
+   secondary_recording_ = recording_pool_ != nullptr;
+   bound_ = kNothingBound;
+   bind_stats_ = {};
 
    VkCommandBufferBeginInfo cmd_begin = {
        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
    };
-   VKAD_VK(vkBeginCommandBuffer(command_buffer_, &cmd_begin));
-
-   VkClearValue clear_color = {.color = {0.4f, 0.4f, 0.4f, 1.0f}};
-   VkRenderPassBeginInfo render_begin = {
-       .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-       .renderPass = render_pass_,
-       .framebuffer = framebuffers_[current_framebuffer_],
-       .renderArea =
-           {
-               .extent = swapchain_.extent(),
-           },
-       .clearValueCount = 1,
-       .pClearValues = &clear_color,
-   };
+   VKAD_VK(vkBeginCommandBuffer(primary_command_buffer_, &cmd_begin));
 
-   vkCmdBeginRenderPass(command_buffer_, &render_begin, VK_SUBPASS_CONTENTS_INLINE);
+   if (gpu_profiler_.has_value()) {
+      gpu_profiler_->begin_frame(primary_command_buffer_, current_frame_);
+      frame_scope_ = gpu_profiler_->begin_scope(primary_command_buffer_, "frame");
+      material_scope_ = -1;
+   }
+
+   if (!pending_buffer_acquires_.empty() || !pending_image_acquires_.empty()) {
+      VkPipelineStageFlags stages =
+          VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+      vkCmdPipelineBarrier(
+          primary_command_buffer_, stages, stages, 0, 0, nullptr, pending_buffer_acquires_.size(),
+          pending_buffer_acquires_.data(), pending_image_acquires_.size(),
+          pending_image_acquires_.data()
+      );
+      pending_buffer_acquires_.clear();
+      pending_image_acquires_.clear();
+   }
+
+   if (swapchain_.has_value()) {
+      render_graph_.bind_image(
+          graph_swapchain_, swapchain_->image(current_framebuffer_),
+          swapchain_->image_view(current_framebuffer_)
+      );
+   } else {
+      render_graph_.bind_image(
+          graph_swapchain_, offscreen_->image(current_framebuffer_),
+          offscreen_->image_view(current_framebuffer_)
+      );
+   }
+
+   if (!secondary_recording_) {
+      render_graph_.begin_pass(primary_command_buffer_, scene_pass_);
+      command_buffer_ = primary_command_buffer_;
+      record_viewport(command_buffer_);
+      return true;
+   }
+
+   render_graph_.begin_pass(
+       primary_command_buffer_, scene_pass_, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+   );
+   command_buffer_ = frame.secondary_pool.acquire();
+   begin_secondary(command_buffer_);
+   frame.secondaries.push_back(command_buffer_);
    return true;
 }
 
-void Renderer::set_material(int material_id) {
-   Material &mat = materials_[material_id];
-   vkCmdBindPipeline(command_buffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, mat.pipeline.handle());
+void Renderer::begin_secondary(VkCommandBuffer cmd_buf) {
+   VkCommandBufferInheritanceInfo inheritance = {
+       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+       .renderPass = render_graph_.render_pass(scene_pass_),
+       .subpass = 0,
+       .framebuffer = render_graph_.framebuffer(),
+   };
+
+   VkCommandBufferBeginInfo begin_info = {
+       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+       .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+       .pInheritanceInfo = &inheritance,
+   };
+   VKAD_VK(vkBeginCommandBuffer(cmd_buf, &begin_info));
+   record_viewport(cmd_buf);
+}
+
+void Renderer::set_recording_threads(int num_threads) {
+   if (num_threads > 1) {
+      recording_pool_ = std::make_unique<ThreadPool>(num_threads);
+   } else {
+      recording_pool_.reset();
+   }
+}
 
+void Renderer::record_viewport(VkCommandBuffer cmd_buf) {
    VkViewport viewport = {
-       .width = static_cast<float>(swapchain_.extent().width),
-       .height = static_cast<float>(swapchain_.extent().height),
+       .width = static_cast<float>(target_extent().width),
+       .height = static_cast<float>(target_extent().height),
        .maxDepth = 1.0f,
    };
-   vkCmdSetViewport(command_buffer_, 0, 1, &viewport);
+   vkCmdSetViewport(cmd_buf, 0, 1, &viewport);
 
    VkRect2D scissor = {
-       .extent = swapchain_.extent(),
+       .extent = target_extent(),
    };
-   vkCmdSetScissor(command_buffer_, 0, 1, &scissor);
+   vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
+}
+
+void Renderer::set_material(int material_id) {
+   record_material(command_buffer_, material_id, bound_, bind_stats_);
+}
+
+void Renderer::record_material(
+    VkCommandBuffer cmd_buf, int material_id, BoundState &bound, BindStats &stats
+) {
+   if (bound.material_id == material_id) {
+      ++stats.pipeline_binds_saved;
+      return;
+   }
+
+   Material &mat = materials_[material_id];
+   // Workers' secondary command buffers aren't timed, their draws count towards the pass
+   if (gpu_profiler_.has_value() && cmd_buf == primary_command_buffer_) {
+      gpu_profiler_->end_scope(cmd_buf, material_scope_);
+      material_scope_ = gpu_profiler_->begin_scope(cmd_buf, mat.name);
+   }
+
+   vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, mat.pipeline.handle());
+   bound.material_id = material_id;
+   // Every material has its own set layout, so the bound set may have been disturbed
+   bound.descriptor_material_id = -1;
+   ++stats.pipeline_binds;
+   ++stats.viewport_binds_saved;
+
+   // Bindless materials share a layout, so the set stays bound while switching between them
+   if (!mat.bindless) {
+      return;
+   }
+
+   if (bound.bindless_set) {
+      ++stats.descriptor_binds_saved;
+      return;
+   }
+
+   VkDescriptorSet set = bindless_->set();
+   vkCmdBindDescriptorSets(
+       cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, bindless_layout_, 0, 1, &set, 0, nullptr
+   );
+   bound.bindless_set = true;
+   ++stats.descriptor_binds;
 }
 
 void Renderer::set_uniform(int material_id, uint32_t offset) {
+   record_uniform(command_buffer_, material_id, offset, bound_, bind_stats_);
+}
+
+void Renderer::record_uniform(
+    VkCommandBuffer cmd_buf, int material_id, uint32_t offset, BoundState &bound,
+    BindStats &stats
+) {
+   if (bound.descriptor_material_id == material_id && bound.uniform_offset == offset) {
+      ++stats.descriptor_binds_saved;
+      return;
+   }
+
    Material &mat = materials_[material_id];
+   VKAD_ASSERT(!mat.bindless, "bindless materials take per-draw data from push constants");
+   bound.descriptor_material_id = material_id;
+   bound.uniform_offset = offset;
+   // Binding a set of another layout disturbs the bindless set
+   bound.bindless_set = false;
+
+   // Uniform ring offsets are relative to the current frame's slice
+   if (mat.uniform_ring_range != 0) {
+      offset += uniform_ring_->frame_base(current_frame_);
+   }
 
    uint32_t offsets[] = {offset};
    vkCmdBindDescriptorSets(
-       command_buffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, mat.pipeline.layout(), 0, 1,
+       cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, mat.pipeline.layout(), 0, 1,
        &mat.descriptor_set, 1, offsets
    );
+   ++stats.descriptor_binds;
+}
+
+void Renderer::bind_geometry(
+    VkCommandBuffer cmd_buf, VkBuffer vertex_buffer, VkBuffer index_buffer,
+    VkDeviceSize index_offset, VkIndexType index_type, BoundState &bound, BindStats &stats
+) {
+   if (bound.vertex_buffer == vertex_buffer && bound.index_buffer == index_buffer &&
+       bound.index_offset == index_offset) {
+      ++stats.vertex_binds_saved;
+      return;
+   }
+
+   VkDeviceSize offsets[] = {0};
+   vkCmdBindVertexBuffers(cmd_buf, 0, 1, &vertex_buffer, offsets);
+   vkCmdBindIndexBuffer(cmd_buf, index_buffer, index_offset, index_type);
+   bound.vertex_buffer = vertex_buffer;
+   bound.index_buffer = index_buffer;
+   bound.index_offset = index_offset;
+   ++stats.vertex_binds;
+}
+
+void Renderer::bind_mesh(
+    VkCommandBuffer cmd_buf, int mesh_id, VkDrawIndexedIndirectCommand *command,
+    BoundState &bound, BindStats &stats
+) {
+   GpuMesh &gpu_mesh = meshes_.get(mesh_id);
+   VkBuffer vertex_buffer;
+   VkBuffer index_buffer;
+   VkDeviceSize index_offset;
+   VkIndexType index_type;
+
+   if (gpu_mesh.arena != -1) {
+      GeometryArena &arena = arenas_[gpu_mesh.arena];
+      vertex_buffer = arena.vertex_buffer().buffer();
+      index_buffer = arena.index_buffer().buffer();
+      index_offset = 0;
+      index_type = GeometryArena::kIndexType;
+
+      command->indexCount = gpu_mesh.range.num_indices;
+      command->firstIndex = gpu_mesh.range.first_index;
+      command->vertexOffset = static_cast<int32_t>(gpu_mesh.range.first_vertex);
+   } else {
+      VertexIndexBuffer &buffer = *gpu_mesh.buffer;
+      vertex_buffer = buffer.buffer();
+      index_buffer = buffer.buffer();
+      index_offset = buffer.index_offset();
+      index_type = buffer.index_type();
+
+      command->indexCount = buffer.num_indices();
+      command->firstIndex = 0;
+      command->vertexOffset = 0;
+   }
+
+   bind_geometry(cmd_buf, vertex_buffer, index_buffer, index_offset, index_type, bound, stats);
 }
 
 void Renderer::draw(int mesh_id) {
-   VertexIndexBuffer &buffer = meshes_.get(mesh_id);
+   VkDrawIndexedIndirectCommand command;
+   bind_mesh(command_buffer_, mesh_id, &command, bound_, bind_stats_);
+   ++bind_stats_.num_draws;
+   vkCmdDrawIndexed(
+       command_buffer_, command.indexCount, 1, command.firstIndex, command.vertexOffset, 0
+   );
+}
+
+void Renderer::push_constants(int material_id, const void *data, uint32_t size) {
+   const Material &mat = materials_[material_id];
+   vkCmdPushConstants(
+       command_buffer_, mat.pipeline.layout(), mat.push_constant_stages, 0, size, data
+   );
+}
+
+void Renderer::draw_instanced(int mesh_id, int instances_id) {
+   InstanceBuffer &instances = instance_buffers_.get(instances_id);
 
-   VkBuffer buffers[] = {buffer.buffer()};
+   VkDrawIndexedIndirectCommand command;
+   bind_mesh(command_buffer_, mesh_id, &command, bound_, bind_stats_);
+   ++bind_stats_.num_draws;
+
+   VkBuffer buffers[] = {instances.buffer()};
    VkDeviceSize offsets[] = {0};
-   vkCmdBindVertexBuffers(command_buffer_, 0, 1, buffers, offsets);
-   vkCmdBindIndexBuffer(
-       command_buffer_, buffer.buffer(), buffer.index_offset(), VK_INDEX_TYPE_UINT16
+   vkCmdBindVertexBuffers(command_buffer_, 1, 1, buffers, offsets);
+
+   vkCmdDrawIndexed(
+       command_buffer_, command.indexCount, instances.num_instances(), command.firstIndex,
+       command.vertexOffset, 0
+   );
+}
+
+void Renderer::draw_parallel(const std::vector<DrawItem> &items) {
+   if (!secondary_recording_) {
+      record_draws(command_buffer_, items.data(), items.size(), bound_, bind_stats_);
+      return;
+   }
+
+   // Close the main thread's secondary buffer so the workers' buffers execute after it
+   VKAD_VK(vkEndCommandBuffer(command_buffer_));
+
+   Frame &frame = frames_[current_frame_];
+   int num_workers = recording_pool_->num_workers();
+   while (frame.worker_pools.size() < num_workers) {
+      frame.worker_pools.emplace_back();
+      frame.worker_pools.back().init(
+          device_.handle(), physical_device_.graphics_queue(), VK_COMMAND_BUFFER_LEVEL_SECONDARY
+      );
+   }
+
+   size_t first_secondary = frame.secondaries.size();
+   frame.secondaries.resize(first_secondary + num_workers);
+   std::vector<std::exception_ptr> errors(num_workers);
+   std::vector<BindStats> worker_stats(num_workers);
+
+   recording_pool_->run([&](int worker) {
+      VKAD_TRACE_ZONE("record draws");
+      size_t begin = items.size() * worker / num_workers;
+      size_t end = items.size() * (worker + 1) / num_workers;
+
+      // Exceptions can't leave a worker thread, they're rethrown on this one instead
+      try {
+         VkCommandBuffer cmd_buf = frame.worker_pools[worker].acquire();
+         begin_secondary(cmd_buf);
+         BoundState bound = kNothingBound;
+         record_draws(cmd_buf, items.data() + begin, end - begin, bound, worker_stats[worker]);
+         VKAD_VK(vkEndCommandBuffer(cmd_buf));
+
+         frame.secondaries[first_secondary + worker] = cmd_buf;
+      } catch (...) {
+         errors[worker] = std::current_exception();
+      }
+   });
+
+   for (const std::exception_ptr &error : errors) {
+      if (error != nullptr) {
+         std::rethrow_exception(error);
+      }
+   }
+
+   for (const BindStats &stats : worker_stats) {
+      bind_stats_ += stats;
+   }
+
+   command_buffer_ = frame.secondary_pool.acquire();
+   bound_ = kNothingBound;
+   begin_secondary(command_buffer_);
+   frame.secondaries.push_back(command_buffer_);
+}
+
+void Renderer::record_draws(
+    VkCommandBuffer cmd_buf, const DrawItem *items, size_t num_items, BoundState &bound,
+    BindStats &stats
+) {
+   for (size_t i = 0; i < num_items; ++i) {
+      const DrawItem &item = items[i];
+      record_material(cmd_buf, item.material_id, bound, stats);
+      record_uniform(cmd_buf, item.material_id, item.uniform_offset, bound, stats);
+
+      VkDrawIndexedIndirectCommand command;
+      bind_mesh(cmd_buf, item.mesh_id, &command, bound, stats);
+      ++stats.num_draws;
+      vkCmdDrawIndexed(
+          cmd_buf, command.indexCount, 1, command.firstIndex, command.vertexOffset, 0
+      );
+   }
+}
+
+void Renderer::retire_mesh_buffer(int mesh_id) {
+   GpuMesh &gpu_mesh = meshes_.get(mesh_id);
+   VkBuffer buffer = gpu_mesh.buffer->buffer();
+   std::erase_if(pending_buffer_acquires_, [buffer](const VkBufferMemoryBarrier &barrier) {
+      return barrier.buffer == buffer;
+   });
+   retire(std::move(*gpu_mesh.buffer));
+   gpu_mesh.buffer.reset();
+}
+
+void Renderer::delete_instances(int instances_id) {
+   // Recorded uploads may write to the buffer, submitting them lets the next frame cover them
+   flush_uploads();
+
+   InstanceBuffer &instances = instance_buffers_.get(instances_id);
+   VkBuffer buffer = instances.buffer();
+   std::erase_if(pending_buffer_acquires_, [buffer](const VkBufferMemoryBarrier &barrier) {
+      return barrier.buffer == buffer;
+   });
+   retire(std::move(instances));
+   instance_buffers_.release(instances_id);
+}
+
+void Renderer::draw_indirect(const std::vector<int> &mesh_ids) {
+   arena_draws_.resize(arenas_.size());
+
+   for (const int mesh_id : mesh_ids) {
+      GpuMesh &gpu_mesh = meshes_.get(mesh_id);
+      if (gpu_mesh.arena == -1) {
+         draw(mesh_id);
+         continue;
+      }
+
+      const ArenaRange &range = gpu_mesh.range;
+      arena_draws_[gpu_mesh.arena].push_back({
+          .indexCount = range.num_indices,
+          .instanceCount = 1,
+          .firstIndex = range.first_index,
+          .vertexOffset = static_cast<int32_t>(range.first_vertex),
+          .firstInstance = 0,
+      });
+   }
+
+   // Without multiDrawIndirect every indirect draw is limited to a single command
+   uint32_t max_draw_count = physical_device_.features().multiDrawIndirect
+                                 ? physical_device_.properties().limits.maxDrawIndirectCount
+                                 : 1;
+   Frame &frame = frames_[current_frame_];
+
+   for (int arena_id = 0; arena_id < arenas_.size(); ++arena_id) {
+      std::vector<VkDrawIndexedIndirectCommand> &commands = arena_draws_[arena_id];
+      if (commands.empty()) {
+         continue;
+      }
+
+      uint32_t num_commands = commands.size();
+      reserve_indirect_commands(num_commands);
+      IndirectBuffer &indirect = *frame.indirect_buffer;
+      uint32_t first_command = frame.num_indirect_commands;
+      std::copy(commands.begin(), commands.end(), indirect.commands() + first_command);
+      indirect.flush(
+          first_command * sizeof(VkDrawIndexedIndirectCommand),
+          num_commands * sizeof(VkDrawIndexedIndirectCommand)
+      );
+      frame.num_indirect_commands += num_commands;
+      commands.clear();
+
+      GeometryArena &arena = arenas_[arena_id];
+      bind_geometry(
+          command_buffer_, arena.vertex_buffer().buffer(), arena.index_buffer().buffer(), 0,
+          GeometryArena::kIndexType, bound_, bind_stats_
+      );
+      bind_stats_.num_draws += num_commands;
+
+      for (uint32_t i = 0; i < num_commands; i += max_draw_count) {
+         vkCmdDrawIndexedIndirect(
+             command_buffer_, indirect.buffer(),
+             (first_command + i) * sizeof(VkDrawIndexedIndirectCommand),
+             std::min(num_commands - i, max_draw_count), sizeof(VkDrawIndexedIndirectCommand)
+         );
+      }
+   }
+}
+
+void Renderer::remove_bindless_image(uint32_t index) {
+   deletion_queue_.retire_call(retire_serial(), [this, index] { bindless_->remove_image(index); });
+}
+
+void Renderer::remove_bindless_buffer(uint32_t index) {
+   deletion_queue_.retire_call(retire_serial(), [this, index] {
+      bindless_->remove_storage_buffer(index);
+   });
+}
+
+void Renderer::draw_culled(const std::vector<int> &mesh_ids, const Mat4 &view_proj) {
+   Frame &frame = frames_[current_frame_];
+   VKAD_ASSERT(
+       frame.cull_command_buffer == VK_NULL_HANDLE, "draw_culled() can only be called once a frame"
+   );
+
+   // The render graph gains the Hi-Z pass between frames, until then nothing is culled
+   if (!occlusion_culler_.has_value()) {
+      occlusion_culling_requested_ = true;
+      draw_indirect(mesh_ids);
+      return;
+   }
+
+   OcclusionCuller::Object *objects =
+       occlusion_culler_->objects(current_frame_, static_cast<uint32_t>(mesh_ids.size()));
+   uint32_t num_objects = 0;
+   int arena_id = -1;
+
+   for (const int mesh_id : mesh_ids) {
+      GpuMesh &gpu_mesh = meshes_.get(mesh_id);
+      if (gpu_mesh.arena == -1) {
+         draw(mesh_id);
+         continue;
+      }
+
+      VKAD_ASSERT(
+          arena_id == -1 || arena_id == gpu_mesh.arena, "culled meshes must share an arena"
+      );
+      arena_id = gpu_mesh.arena;
+
+      const Aabb &box = gpu_mesh.bounds;
+      const ArenaRange &range = gpu_mesh.range;
+      objects[num_objects++] = {
+          .box_min = {box.min.x, box.min.y, box.min.z, 1},
+          .box_max = {box.max.x, box.max.y, box.max.z, 1},
+          .index_count = range.num_indices,
+          .first_index = range.first_index,
+          .vertex_offset = static_cast<int32_t>(range.first_vertex),
+          .padding = 0,
+      };
+   }
+
+   if (num_objects == 0) {
+      return;
+   }
+
+   // A single count draw covers every command, which takes multiDrawIndirect
+   uint32_t max_draw_count = physical_device_.features().multiDrawIndirect
+                                 ? physical_device_.properties().limits.maxDrawIndirectCount
+                                 : 1;
+   bool count_draws = device_.draw_indexed_indirect_count() != nullptr &&
+                      num_objects <= max_draw_count;
+
+   // The cull is recorded by end_draw(), with the late latched camera if there is one
+   frame.cull_command_buffer = frame.command_pool.acquire();
+   frame.num_cull_objects = num_objects;
+   frame.cull_view_proj = view_proj;
+   frame.count_culled_draws = count_draws;
+
+   GeometryArena &arena = arenas_[arena_id];
+   bind_geometry(
+       command_buffer_, arena.vertex_buffer().buffer(), arena.index_buffer().buffer(), 0,
+       GeometryArena::kIndexType, bound_, bind_stats_
+   );
+   bind_stats_.num_culled_commands += num_objects;
+
+   // The visible meshes are compacted to the front. The GPU draws only those when it reads their
+   // count, otherwise the remaining commands draw no instances.
+   VkBuffer commands = occlusion_culler_->commands(current_frame_);
+   if (count_draws) {
+      device_.draw_indexed_indirect_count()(
+          command_buffer_, commands, 0, occlusion_culler_->draw_count(current_frame_), 0,
+          num_objects, sizeof(VkDrawIndexedIndirectCommand)
+      );
+      return;
+   }
+
+   // Without multiDrawIndirect every indirect draw is limited to a single command
+   for (uint32_t i = 0; i < num_objects; i += max_draw_count) {
+      vkCmdDrawIndexedIndirect(
+          command_buffer_, commands, i * sizeof(VkDrawIndexedIndirectCommand),
+          std::min(num_objects - i, max_draw_count), sizeof(VkDrawIndexedIndirectCommand)
+      );
+   }
+}
+
+void Renderer::reserve_indirect_commands(uint32_t count) {
+   Frame &frame = frames_[current_frame_];
+   if (frame.indirect_buffer.has_value() &&
+       frame.num_indirect_commands + count <= frame.indirect_buffer->capacity()) {
+      return;
+   }
+
+   // Draws already recorded this frame still read from the old buffer
+   if (frame.indirect_buffer.has_value()) {
+      retire(std::move(*frame.indirect_buffer));
+   }
+
+   frame.indirect_buffer.emplace(
+       std::max(std::bit_ceil(count), kInitialIndirectCommands), allocator_
    );
+   frame.num_indirect_commands = 0;
+}
+
+void Renderer::submit(const DrawItem &item, float depth, int layer) {
+   GpuMesh &gpu_mesh = meshes_.get(item.mesh_id);
+   // Meshes in the same arena share buffers, every other mesh has buffers of its own
+   uint32_t geometry = gpu_mesh.arena != -1 ? gpu_mesh.arena : arenas_.size() + item.mesh_id;
+   render_queue_.push(RenderQueue::sort_key(layer, item.material_id, geometry, depth), item);
+}
+
+void Renderer::draw_queue() {
+   if (render_queue_.empty()) {
+      return;
+   }
 
-   vkCmdDrawIndexed(command_buffer_, buffer.num_indices(), 1, 0, 0, 0);
+   render_queue_.sort();
+   draw_parallel(render_queue_.sorted());
+   render_queue_.clear();
 }
 
 void Renderer::end_draw() {
-   vkCmdEndRenderPass(command_buffer_);
-   VKAD_VK(vkEndCommandBuffer(command_buffer_));
+   VKAD_TRACE_ZONE("Renderer::end_draw");
+   draw_queue();
+   last_bind_stats_ = bind_stats_;
+
+   VKAD_TRACE_COUNTER("draws", bind_stats_.num_draws);
+   VKAD_TRACE_COUNTER("culled draw commands", bind_stats_.num_culled_commands);
+   VKAD_TRACE_COUNTER("upload batches in flight", pending_uploads_.size());
+   VKAD_TRACE_COUNTER("staging bytes", staging_buffer_.used());
+   VKAD_TRACE_COUNTER("uniform bytes", uniform_ring_->used());
+   VKAD_TRACE_COUNTER("allocations", allocator_.stats().num_allocations);
+
+   Frame &frame = frames_[current_frame_];
+
+   if (secondary_recording_) {
+      VKAD_VK(vkEndCommandBuffer(command_buffer_));
+      vkCmdExecuteCommands(
+          primary_command_buffer_, frame.secondaries.size(), frame.secondaries.data()
+      );
+   }
+
+   if (gpu_profiler_.has_value()) {
+      gpu_profiler_->end_scope(primary_command_buffer_, material_scope_);
+   }
+   render_graph_.end_pass(primary_command_buffer_);
+   if (hiz_pass_ != -1) {
+      render_graph_.begin_pass(primary_command_buffer_, hiz_pass_);
+      occlusion_culler_->build_hiz(primary_command_buffer_);
+      render_graph_.end_pass(primary_command_buffer_);
+   }
+   if (gpu_profiler_.has_value()) {
+      gpu_profiler_->end_scope(primary_command_buffer_, frame_scope_);
+   }
+   VKAD_VK(vkEndCommandBuffer(primary_command_buffer_));
+
+   // Uploads submitted before this frame must finish before their acquire barriers execute
+   std::vector<VkSemaphore> wait_semaphores;
+   std::vector<VkPipelineStageFlags> wait_stages;
+   if (swapchain_.has_value()) {
+      wait_semaphores.push_back(frame.sem_img_avail);
+      wait_stages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+   }
+   for (const VkSemaphore semaphore : pending_upload_semaphores_) {
+      wait_semaphores.push_back(semaphore);
+      wait_stages.push_back(
+          VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+      );
+   }
+   frame.upload_semaphores = std::move(pending_upload_semaphores_);
+   pending_upload_semaphores_.clear();
+   frame.serial = ++frame_serial_;
+
+   // Culling runs first so its draw commands are ready by the time the render pass reads them
+   std::vector<VkCommandBuffer> command_buffers;
+   if (frame.cull_command_buffer != VK_NULL_HANDLE) {
+      command_buffers.push_back(frame.cull_command_buffer);
+   }
+   command_buffers.push_back(primary_command_buffer_);
 
-   VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
    VkSubmitInfo submit_info = {
        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-       .waitSemaphoreCount = 1,
-       .pWaitSemaphores = &sem_img_avail,
-       .pWaitDstStageMask = wait_stages,
-       .commandBufferCount = 1,
-       .pCommandBuffers = &command_buffer_,
-       .signalSemaphoreCount = 1,
-       .pSignalSemaphores = &sem_render_complete,
-   };
-   VKAD_VK(vkQueueSubmit(device_.graphics_queue(), 1, &submit_info, draw_cycle_complete));
-
-   VkSwapchainKHR swap_chains[] = {swapchain_.handle()};
-   VkPresentInfoKHR present_info = {
-       .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-       .waitSemaphoreCount = 1,
-       .pWaitSemaphores = &sem_render_complete,
-       .swapchainCount = VKAD_ARRAY_LEN(swap_chains),
-       .pSwapchains = swap_chains,
-       .pImageIndices = &current_framebuffer_,
+       .waitSemaphoreCount = static_cast<uint32_t>(wait_semaphores.size()),
+       .pWaitSemaphores = wait_semaphores.data(),
+       .pWaitDstStageMask = wait_stages.data(),
+       .commandBufferCount = static_cast<uint32_t>(command_buffers.size()),
+       .pCommandBuffers = command_buffers.data(),
    };
-   vkQueuePresentKHR(device_.present_queue(), &present_info);
-}
-
-void Renderer::create_framebuffers() {
-   framebuffers_.resize(swapchain_.num_images());
-   for (int i = 0; i < swapchain_.num_images(); ++i) {
-      VkImageView attachments[] = {swapchain_.image_view(i)};
-
-      VkExtent2D extent = swapchain_.extent();
-      VkFramebufferCreateInfo create_info = {
-          .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-          .renderPass = render_pass_,
-          .attachmentCount = VKAD_ARRAY_LEN(attachments),
-          .pAttachments = attachments,
-          .width = extent.width,
-          .height = extent.height,
-          .layers = 1,
+   // A headless frame isn't presented, so nothing would wait on the semaphore
+   if (swapchain_.has_value()) {
+      submit_info.signalSemaphoreCount = 1;
+      submit_info.pSignalSemaphores = &frame.sem_render_complete;
+   }
+
+   // Everything else about the frame is recorded, so the camera is sampled as late as the CPU can
+   // still change what the GPU reads. Host writes before vkQueueSubmit() are visible to the frame.
+   std::chrono::steady_clock::time_point input_time = input_time_;
+   if (camera_source_ != nullptr) {
+      VKAD_TRACE_ZONE("late latch");
+      CameraSample camera = camera_source_();
+      frame.cull_view_proj = camera.view_proj;
+      for (const uint32_t offset : late_latch_offsets_) {
+         uniform_ring_->write(offset, &camera.view_proj, sizeof(Mat4));
+         for (UniformRing &ring : outgrown_rings_) {
+            if (offset + sizeof(Mat4) <= ring.used()) {
+               ring.write(offset, &camera.view_proj, sizeof(Mat4));
+            }
+         }
+      }
+      input_time = camera.input_time;
+   }
+   uniform_ring_->flush_current_frame();
+   for (UniformRing &ring : outgrown_rings_) {
+      ring.flush_current_frame();
+      deletion_queue_.retire(frame.serial, std::move(ring));
+   }
+   outgrown_rings_.clear();
+
+   if (frame.cull_command_buffer != VK_NULL_HANDLE) {
+      VkCommandBufferBeginInfo cmd_begin = {
+          .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+          .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
       };
-      VKAD_VK(vkCreateFramebuffer(device_.handle(), &create_info, nullptr, &framebuffers_[i]));
+      VKAD_VK(vkBeginCommandBuffer(frame.cull_command_buffer, &cmd_begin));
+      occlusion_culler_->record_cull(
+          frame.cull_command_buffer, current_frame_, frame.num_cull_objects,
+          frame.cull_view_proj, frame.count_culled_draws
+      );
+      VKAD_VK(vkEndCommandBuffer(frame.cull_command_buffer));
+   }
+
+   auto submit_time = std::chrono::steady_clock::now();
+   VKAD_VK(vkQueueSubmit(device_.graphics_queue(), 1, &submit_info, frame.draw_cycle_complete));
+
+   primary_command_buffer_ = VK_NULL_HANDLE;
+
+   if (swapchain_.has_value()) {
+      VkSwapchainKHR swap_chains[] = {swapchain_->handle()};
+      VkPresentInfoKHR present_info = {
+          .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+          .waitSemaphoreCount = 1,
+          .pWaitSemaphores = &frame.sem_render_complete,
+          .swapchainCount = VKAD_ARRAY_LEN(swap_chains),
+          .pSwapchains = swap_chains,
+          .pImageIndices = &current_framebuffer_,
+      };
+      {
+         VKAD_TRACE_ZONE("vkQueuePresentKHR");
+         vkQueuePresentKHR(device_.present_queue(), &present_info);
+      }
+      frame_pacing_.record_present(std::chrono::steady_clock::now());
+   }
+
+   if (latency_hook_ != nullptr) {
+      latency_hook_({
+          .input_time = input_time,
+          .submit_time = submit_time,
+          .present_time = std::chrono::steady_clock::now(),
+      });
+   }
+
+   current_frame_ = (current_frame_ + 1) % frames_.size();
+   current_frame_ready_ = false;
+}
+
+bool Renderer::enable_gpu_profiler() {
+   if (!gpu_profiler_.has_value()) {
+      if (!GpuProfiler::supported(physical_device_)) {
+         return false;
+      }
+      gpu_profiler_.emplace(device_.handle(), physical_device_, frames_.size());
+      render_graph_.set_profiler(&*gpu_profiler_);
+   }
+   return true;
+}
+
+void Renderer::build_render_graph() {
+   render_graph_.reset();
+
+   // Overdraw is counted up from black
+   float background = visualize_overdraw_ ? 0.0f : 0.4f;
+   VkClearValue clear_color = {.color = {background, background, background, 1.0f}};
+   if (swapchain_.has_value()) {
+      graph_swapchain_ = render_graph_.import_image(
+          "swapchain", swapchain_->img_format(), VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, clear_color
+      );
+   } else {
+      graph_swapchain_ = render_graph_.import_image(
+          "offscreen", offscreen_->img_format(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, clear_color
+      );
+   }
+   graph_depth_ = render_graph_.create_image(
+       "depth", depth_format_, {.depthStencil = {.depth = 1.0f, .stencil = 0}}
+   );
+
+   scene_pass_ = render_graph_.add_pass(
+       "scene", PassType::GRAPHICS,
+       {
+           {.image = graph_swapchain_, .access = ImageAccess::COLOR_ATTACHMENT},
+           {.image = graph_depth_, .access = ImageAccess::DEPTH_ATTACHMENT},
+       }
+   );
+
+   // Without the Hi-Z build reading it, depth never leaves the render pass and needs no memory on
+   // tiled GPUs
+   hiz_pass_ = -1;
+   if (occlusion_culling_requested_) {
+      hiz_pass_ = render_graph_.add_pass(
+          "hiz", PassType::COMPUTE,
+          {{.image = graph_depth_, .access = ImageAccess::COMPUTE_SAMPLED}}
+      );
    }
+
+   render_graph_.compile(target_extent());
+}
+
+void Renderer::enable_occlusion_culling() {
+   device_.wait_idle();
+   build_render_graph();
+
+   ensure_shader_loaded(OcclusionCuller::kHiZShaderPath);
+   ensure_shader_loaded(OcclusionCuller::kCullShaderPath);
+   occlusion_culler_.emplace(
+       allocator_, pipeline_cache_.handle(), shaders_.at(OcclusionCuller::kHiZShaderPath),
+       shaders_.at(OcclusionCuller::kCullShaderPath), render_graph_.image(graph_depth_),
+       frames_.size()
+   );
 }
@@ -1,107 +1,376 @@
 #ifndef VKAD_GPU_VK_GPU_H_
 #define VKAD_GPU_VK_GPU_H_
 
+#include <chrono>
 #include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
-#include <fmod.h>
 #include <vulkan/vulkan_core.h>
 
+#include "gpu/bindless_set.h"
 #include "gpu/buffer.h"
 #include "gpu/command_pool.h"
 #include "gpu/descriptor_pool.h"
 #include "gpu/device.h"
+#include "gpu/geometry_arena.h"
+#include "gpu/gpu_profiler.h"
 #include "gpu/image.h"
 #include "gpu/instance.h"
+#include "gpu/memory_allocator.h"
+#include "gpu/occlusion_culler.h"
+#include "gpu/offscreen_target.h"
 #include "gpu/physical_device.h"
 #include "gpu/pipeline.h"
+#include "gpu/pipeline_cache.h"
+#include "gpu/render_graph.h"
 #include "gpu/swapchain.h"
+#include "math/bounds.h"
+#include "math/mat4.h"
 #include "mesh.h"
+#include "render_queue.h"
+#include "util/assert.h"
+#include "util/deletion_queue.h"
+#include "util/frame_pacing.h"
 #include "util/slab.h"
+#include "util/thread_pool.h"
 
 namespace vkad {
 
+/// The camera as it was when a frame was submitted, see Renderer::set_camera_source()
+struct CameraSample {
+   Mat4 view_proj;
+   /// When the input that placed the camera was read
+   std::chrono::steady_clock::time_point input_time;
+};
+
+/// How long one frame took from reading the input it shows to being handed to the display. What
+/// happens after vkQueuePresentKHR() returns, such as waiting for vblank, isn't included.
+struct FrameLatency {
+   std::chrono::steady_clock::time_point input_time;
+   std::chrono::steady_clock::time_point submit_time;
+   std::chrono::steady_clock::time_point present_time;
+};
+
 class Renderer {
 public:
+   static constexpr int kDefaultFramesInFlight = 2;
+   static constexpr const char *kPipelineCachePath = "pipeline_cache.bin";
+   /// Fragment shader every pipeline uses when visualizing overdraw
+   static constexpr const char *kOverdrawShaderPath = "overdraw-frag.spv";
+   /// Push constant bytes available to bindless materials, the least every device supports
+   static constexpr uint32_t kBindlessPushConstantSize = 128;
+
+   /// With `visualize_overdraw`, every material is created with a fragment shader that adds a
+   /// constant to the color attachment, so brighter pixels were shaded more often.
+   ///
+   /// A null `surface` makes the renderer headless: frames are drawn into offscreen images of the
+   /// initial size instead of a swapchain and are never presented, so it runs without a window on
+   /// any Vulkan implementation. The instance then needs no extensions. See read_pixels().
+   /// `present_profile` is used for every swapchain the renderer creates.
    explicit Renderer(
-       Instance &vk_instance, VkSurfaceKHR surface, uint32_t initial_width, uint32_t initial_height
+       Instance &vk_instance, VkSurfaceKHR surface, uint32_t initial_width, uint32_t initial_height,
+       int frames_in_flight = kDefaultFramesInFlight, bool visualize_overdraw = false,
+       PresentProfile present_profile = PresentProfile::BALANCED
    );
    ~Renderer();
 
+   /// Opaque geometry should set `options.depth_test` and be submitted front to back, so that
+   /// hidden fragments are rejected before they are shaded
    template <class Vertex>
    int create_material(
        const std::vector<std::string> &shader_paths,
-       const std::vector<VkDescriptorSetLayoutBinding> &bindings
+       const std::vector<VkDescriptorSetLayoutBinding> &bindings, const PipelineOptions &options = {}
+   ) {
+      std::vector<VkVertexInputAttributeDescription> attrs(
+          Vertex::kAttributes.begin(), Vertex::kAttributes.end()
+      );
+
+      return do_create_pipeline(sizeof(Vertex), attrs, shader_paths, bindings, 0, options);
+   }
+
+   /// Like create_material(), but the pipeline also reads one `Instance` per instance from
+   /// binding 1. Draw with draw_instanced().
+   template <class Vertex, class Instance>
+   int create_instanced_material(
+       const std::vector<std::string> &shader_paths,
+       const std::vector<VkDescriptorSetLayoutBinding> &bindings, const PipelineOptions &options = {}
+   ) {
+      std::vector<VkVertexInputAttributeDescription> attrs(
+          Vertex::kAttributes.begin(), Vertex::kAttributes.end()
+      );
+      attrs.insert(attrs.end(), Instance::kAttributes.begin(), Instance::kAttributes.end());
+
+      return do_create_pipeline(
+          sizeof(Vertex), attrs, shader_paths, bindings, sizeof(Instance), options
+      );
+   }
+
+   /// Like create_material(), but every draw also gets a `PushConstants` from push_constants().
+   /// Pushing small per-draw data such as a transform and a color skips the uniform ring entirely.
+   template <class Vertex, class PushConstants>
+   int create_push_constant_material(
+       const std::vector<std::string> &shader_paths,
+       const std::vector<VkDescriptorSetLayoutBinding> &bindings, PipelineOptions options = {}
    ) {
       std::vector<VkVertexInputAttributeDescription> attrs(
           Vertex::kAttributes.begin(), Vertex::kAttributes.end()
       );
 
-      return do_create_pipeline(sizeof(Vertex), attrs, shader_paths, bindings);
+      options.push_constant_size = sizeof(PushConstants);
+      return do_create_pipeline(sizeof(Vertex), attrs, shader_paths, bindings, 0, options);
    }
 
+   /// Like create_push_constant_material(), but the shaders find their images and storage buffers
+   /// in the bindless set (set 0, see BindlessSet) by indices passed in `PushConstants`, which are
+   /// visible to the vertex and fragment stages. Every bindless material shares one pipeline
+   /// layout, so creating one builds only the pipeline, and drawing with it never binds
+   /// descriptors past the first bindless material of a command buffer. Needs bindless().
+   template <class Vertex, class PushConstants>
+   int create_bindless_material(
+       const std::vector<std::string> &shader_paths, PipelineOptions options = {}
+   ) {
+      static_assert(
+          sizeof(PushConstants) <= kBindlessPushConstantSize,
+          "push constants exceed kBindlessPushConstantSize"
+      );
+      VKAD_ASSERT(bindless(), "the device doesn't support bindless descriptors");
+
+      std::vector<VkVertexInputAttributeDescription> attrs(
+          Vertex::kAttributes.begin(), Vertex::kAttributes.end()
+      );
+
+      options.push_constant_size = sizeof(PushConstants);
+      options.shared_layout = bindless_layout_;
+      return do_create_pipeline(sizeof(Vertex), attrs, shader_paths, {}, 0, options);
+   }
+
+   /// `instance_size` of 0 means the pipeline has no per-instance binding
    int do_create_pipeline(
        uint32_t vertex_size, const std::vector<VkVertexInputAttributeDescription> &attrs,
        const std::vector<std::string> &shader_paths,
-       const std::vector<VkDescriptorSetLayoutBinding> &bindings
+       const std::vector<VkDescriptorSetLayoutBinding> &bindings, uint32_t instance_size = 0,
+       const PipelineOptions &options = {}
    );
 
    void link_material(int material_id, const std::vector<DescriptorWrite> &writes) {
       Material &mat = materials_[material_id];
-      mat.descriptor_set = mat.descriptor_pool.allocate(mat.descriptor_set_layout);
-      mat.descriptor_pool.write(mat.descriptor_set, writes);
+      VKAD_ASSERT(!mat.bindless, "bindless materials have no descriptor set of their own");
+      mat.descriptor_set = mat.descriptor_pool->allocate(mat.descriptor_set_layout);
+      mat.descriptor_pool->write(mat.descriptor_set, writes);
+   }
+
+   /// Whether the device supports descriptor indexing, which bindless materials need. Without it
+   /// every material uses descriptor sets of its own.
+   inline bool bindless() const {
+      return bindless_.has_value();
+   }
+
+   /// Adds the image to the bindless set and returns the index shaders read it at. The image must
+   /// be initialized already.
+   inline uint32_t add_bindless_image(const Image &image) {
+      return bindless_->add_image(sampler_, image);
    }
 
+   /// Frees the image's slot once the frames that may draw with it have completed
+   void remove_bindless_image(uint32_t index);
+
+   inline uint32_t add_bindless_buffer(const Buffer &buffer) {
+      return bindless_->add_storage_buffer(buffer);
+   }
+
+   void remove_bindless_buffer(uint32_t index);
+
+   /// Points the material's dynamic uniform buffer at binding 0 to the uniform ring. Offsets given
+   /// to set_uniform() and DrawItem for the material are then ones returned by write_uniform().
+   template <class T> void link_uniform_ring(int material_id) {
+      do_link_uniform_ring(material_id, sizeof(T));
+   }
+
+   void do_link_uniform_ring(int material_id, uint32_t range);
+
+   /// Copies `data` into the current frame's slice of the uniform ring and returns the offset to
+   /// draw with. A full ring grows without waiting for the GPU, also while a frame is recorded.
+   template <class T> uint32_t write_uniform(const T &data) {
+      return write_uniform(&data, sizeof(T));
+   }
+
+   uint32_t write_uniform(const void *data, size_t size);
+
    void ensure_shader_loaded(const std::string &path);
 
-   template <class Vertex> inline void init_mesh(Mesh<Vertex> &mesh) {
-      mesh.id_ = meshes_.emplace(
-          mesh.vertices_.size(), sizeof(Vertex), mesh.indices_.size(), device_.handle(),
-          physical_device_
+   /// Creates a vertex and index buffer pair that meshes of `Vertex` can be placed in with
+   /// init_mesh(), so that draw_indirect() can draw them together.
+   template <class Vertex> int create_geometry_arena(uint32_t max_vertices, uint32_t max_indices) {
+      std::vector<uint32_t> queue_families = {
+          physical_device_.graphics_queue(), physical_device_.transfer_queue()
+      };
+      arenas_.emplace_back(sizeof(Vertex), max_vertices, max_indices, queue_families, allocator_);
+      return arenas_.size() - 1;
+   }
+
+   /// Uploads the mesh into its own buffer, or into `arena` if it has room left
+   template <class Vertex> inline void init_mesh(Mesh<Vertex> &mesh, int arena = -1) {
+      mesh.id_ = meshes_.emplace();
+      mesh.bounds_ = Bounds::of_vertices(mesh.vertices_);
+      GpuMesh &gpu_mesh = meshes_.get(mesh.id_);
+      gpu_mesh.bounds = mesh.bounds_.box;
+      gpu_mesh.arena = -1;
+
+      if (arena != -1) {
+         GeometryArena &target = arenas_[arena];
+         VKAD_ASSERT(target.vertex_size() == sizeof(Vertex), "arena vertex size mismatch");
+         if (target.allocate(mesh.vertices_.size(), mesh.indices_.size(), &gpu_mesh.range)) {
+            gpu_mesh.arena = arena;
+         }
+      }
+
+      if (gpu_mesh.arena == -1) {
+         gpu_mesh.buffer.emplace(
+             mesh.vertices_.size(), sizeof(Vertex), mesh.indices_.size(), allocator_
+         );
+      }
+
+      gpu_mesh.dynamic = false;
+      upload_mesh(mesh);
+   }
+
+   /// Creates a mesh that is expected to change often. Where the device has memory that is both
+   /// device local and host visible, its buffer lives there and update_mesh() writes to it
+   /// directly instead of going through the staging buffer.
+   template <class Vertex> inline void init_dynamic_mesh(Mesh<Vertex> &mesh) {
+      mesh.id_ = meshes_.emplace();
+      mesh.bounds_ = Bounds::of_vertices(mesh.vertices_);
+      GpuMesh &gpu_mesh = meshes_.get(mesh.id_);
+      gpu_mesh.bounds = mesh.bounds_.box;
+      gpu_mesh.arena = -1;
+      gpu_mesh.dynamic = true;
+      gpu_mesh.buffer.emplace(
+          mesh.vertices_.size(), sizeof(Vertex), mesh.indices_.size(), allocator_,
+          MemoryUsage::DYNAMIC
       );
-      update_mesh(mesh);
+
+      if (gpu_mesh.buffer->host_visible()) {
+         write_mesh(mesh, *gpu_mesh.buffer);
+      } else {
+         upload_mesh(mesh);
+      }
    }
 
+   /// Frees the mesh's GPU memory once the frames that may draw it have completed
    template <class Vertex> inline void delete_mesh(Mesh<Vertex> &mesh) {
+      // Recorded uploads may write to the buffer, submitting them lets the next frame cover them
+      flush_uploads();
+
+      GpuMesh &gpu_mesh = meshes_.get(mesh.id_);
+      if (gpu_mesh.arena != -1) {
+         int arena = gpu_mesh.arena;
+         ArenaRange range = gpu_mesh.range;
+         deletion_queue_.retire_call(retire_serial(), [this, arena, range] {
+            arenas_[arena].free(range);
+         });
+      } else {
+         retire_mesh_buffer(mesh.id_);
+      }
       meshes_.release(mesh.id_);
 #ifdef VKAD_DEBUG
       mesh.id_ = -1;
 #endif
    }
 
+   /// Uploads per-instance data for draw_instanced() and returns its id
+   template <class Instance> int init_instances(const std::vector<Instance> &instances) {
+      int id = instance_buffers_.emplace(instances.size(), sizeof(Instance), allocator_);
+      upload_buffer(
+          instances.data(), instances.size() * sizeof(Instance), instance_buffers_.get(id), 0
+      );
+      return id;
+   }
+
+   void delete_instances(int instances_id);
+
    template <class T> UniformBuffer create_uniform_buffer(size_t num_elements) {
-      return UniformBuffer(sizeof(T), num_elements, device_.handle(), physical_device_);
+      return UniformBuffer(sizeof(T), num_elements, frames_.size(), allocator_);
    }
 
-   Image create_image(uint32_t width, uint32_t height) const {
+   Image create_image(uint32_t width, uint32_t height) {
       return Image(
-          physical_device_, device_.handle(),
-          VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_FORMAT_R8G8B8A8_SRGB,
-          width, height
+          allocator_, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+          VK_FORMAT_R8G8B8A8_SRGB, width, height
       );
    }
 
    void init_image(Image &image, unsigned char *img_data, size_t size) {
-      staging_buffer_.upload_raw(img_data, size);
-      begin_preframe();
-      transfer_image_layout(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-      upload_texture(staging_buffer_, image);
-      transfer_image_layout(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-      end_preframe();
+      upload_image(img_data, size, image);
       image.init_view();
    }
 
+   /// Uploads the mesh's current contents. Meshes not created with init_dynamic_mesh() must keep
+   /// their number of vertices and indices.
    template <class Vertex> void update_mesh(Mesh<Vertex> &mesh) {
-      VertexIndexBuffer &buf = meshes_.get(mesh.id_);
-      staging_buffer_.upload_mesh(
-          mesh.vertices_.data(), sizeof(Vertex) * mesh.vertices_.size(), mesh.indices_.data(),
-          mesh.indices_.size()
+      mesh.bounds_ = Bounds::of_vertices(mesh.vertices_);
+      GpuMesh &gpu_mesh = meshes_.get(mesh.id_);
+      gpu_mesh.bounds = mesh.bounds_.box;
+      if (gpu_mesh.dynamic) {
+         // Frames in flight may still read the old buffer, so the new contents go to a fresh one,
+         // which also lets the mesh change size
+         retire(std::move(*gpu_mesh.buffer));
+         gpu_mesh.buffer.reset();
+         gpu_mesh.buffer.emplace(
+             mesh.vertices_.size(), sizeof(Vertex), mesh.indices_.size(), allocator_,
+             MemoryUsage::DYNAMIC
+         );
+
+         if (gpu_mesh.buffer->host_visible()) {
+            write_mesh(mesh, *gpu_mesh.buffer);
+         } else {
+            upload_mesh(mesh);
+         }
+         return;
+      }
+
+      // num_vertices() of a buffer is in bytes
+      uint32_t num_vertices = gpu_mesh.arena != -1
+                                  ? gpu_mesh.range.num_vertices
+                                  : gpu_mesh.buffer->num_vertices() / sizeof(Vertex);
+      uint32_t num_indices = gpu_mesh.arena != -1 ? gpu_mesh.range.num_indices
+                                                  : gpu_mesh.buffer->num_indices();
+      VKAD_ASSERT(
+          mesh.vertices_.size() == num_vertices && mesh.indices_.size() == num_indices,
+          "only dynamic meshes can change their number of vertices or indices"
       );
-      begin_preframe();
-      buffer_copy(staging_buffer_, buf);
-      end_preframe();
+
+      if (separate_transfer_queue()) {
+         // Frames in flight may still be drawing the old contents and nothing orders the graphics
+         // queue's reads before the transfer queue's writes, so the new contents go to fresh memory
+         // and the old memory is retired with those frames. Recorded uploads may still write the
+         // old memory, submitting them lets the next frame cover them.
+         flush_uploads();
+         ArenaRange range;
+         if (gpu_mesh.arena == -1) {
+            retire_mesh_buffer(mesh.id_);
+            gpu_mesh.buffer.emplace(num_vertices, sizeof(Vertex), num_indices, allocator_);
+         } else if (arenas_[gpu_mesh.arena].allocate(num_vertices, num_indices, &range)) {
+            int arena = gpu_mesh.arena;
+            ArenaRange old_range = gpu_mesh.range;
+            deletion_queue_.retire_call(retire_serial(), [this, arena, old_range] {
+               arenas_[arena].free(old_range);
+            });
+            gpu_mesh.range = range;
+         } else {
+            // The arena has no room for a second copy, so the old one is overwritten once no
+            // frame draws it anymore
+            wait_for_frames();
+         }
+      }
+
+      upload_mesh(mesh);
    }
 
    inline Device &device() {
@@ -112,67 +381,522 @@ public:
       return physical_device_;
    }
 
+   inline MemoryAllocator &allocator() {
+      return allocator_;
+   }
+
+   /// Summed over every command pool: the frames' primary, secondary and worker pools and the
+   /// upload pools
+   CommandPoolStats command_pool_stats() const;
+
+   inline MemoryStats memory_stats() const {
+      return allocator_.stats();
+   }
+
+   /// Whether pipelines were created from a valid cache file written by an earlier run
+   inline bool pipeline_cache_seeded() const {
+      return pipeline_cache_.seeded();
+   }
+
+   /// Milliseconds spent creating material pipelines so far
+   inline float pipeline_creation_ms() const {
+      return pipeline_creation_ms_;
+   }
+
    inline VkSampler image_sampler() const {
       return sampler_;
    }
 
+   /// Not available to headless renderers. Only waits for the frames in flight, the old swapchain
+   /// is passed as oldSwapchain and destroyed once the next frame has completed.
    void recreate_swapchain(uint32_t width, uint32_t height, VkSurfaceKHR surface);
 
-   void begin_preframe();
+   inline PresentProfile present_profile() const {
+      return present_profile_;
+   }
+
+   /// Present mode of the swapchain, which may differ from what the profile prefers if the
+   /// surface doesn't support it
+   inline VkPresentModeKHR present_mode() const {
+      VKAD_ASSERT(swapchain_.has_value(), "headless renderers have no swapchain");
+      return swapchain_->present_mode();
+   }
+
+   /// Present intervals since the swapchain was last created. Refreshes are only counted as
+   /// missed once the refresh rate is set with set_refresh_rate().
+   inline FramePacingStats frame_pacing() const {
+      return frame_pacing_.stats();
+   }
 
-   void buffer_copy(const StagingBuffer &src, Buffer &dst);
+   /// `hz` of 0 means unknown
+   inline void set_refresh_rate(float hz) {
+      frame_pacing_.set_refresh_rate(hz);
+   }
+
+   inline bool headless() const {
+      return offscreen_.has_value();
+   }
 
-   void upload_texture(const StagingBuffer &src, Image &image);
+   /// Waits for the device and returns the last frame a headless renderer drew as tightly packed
+   /// RGBA8 rows, top row first
+   std::vector<uint8_t> read_pixels();
 
-   inline void transfer_image_layout(Image &image, VkImageLayout layout) const {
-      image.queue_transfer_layout(layout, preframe_cmd_buf_);
+   /// Records a copy of `data` into `dst` through the staging ring. Nothing waits on the copy; it
+   /// is submitted with the other uploads of this frame before the frame's draw commands. Uploads
+   /// recorded after begin_draw() become visible with the next frame.
+   ///
+   /// With a dedicated transfer queue `dst` changes queue family ownership, which leaves any bytes
+   /// that weren't written by the upload undefined.
+   void upload_buffer(const void *data, size_t size, Buffer &dst, VkDeviceSize dst_offset);
+
+   /// Like upload_buffer(), but also moves the image into VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+   void upload_image(const void *data, size_t size, Image &image);
+
+   inline void transfer_image_layout(Image &image, VkImageLayout layout) {
+      image.queue_transfer_layout(layout, upload_command_buffer());
    }
 
-   void end_preframe();
+   /// Submits all uploads recorded so far. Called automatically by begin_draw().
+   void flush_uploads();
+
+   /// Waits until the GPU is done with the current frame's resources. Per-frame data such as
+   /// uniform slices may only be written after this returns. begin_draw() does the same wait if
+   /// this wasn't called for the frame.
+   void begin_frame();
 
    bool begin_draw();
 
+   /// Binds the material's pipeline unless it is already bound
    void set_material(int material_id);
 
+   /// Binds the material's descriptor set at `offset` unless it is already bound
    void set_uniform(int material_id, uint32_t offset);
 
    void draw(int mesh_id);
 
+   /// Sets the push constants of a material made with create_push_constant_material() or
+   /// create_bindless_material() for the following draws
+   template <class T> void push_constants(int material_id, const T &data) {
+      push_constants(material_id, &data, sizeof(T));
+   }
+
+   void push_constants(int material_id, const void *data, uint32_t size);
+
+   /// Draws every mesh in `mesh_ids` with the bound material and uniforms. Meshes that share a
+   /// geometry arena are drawn with a single vkCmdDrawIndexedIndirect, the others one by one.
+   void draw_indirect(const std::vector<int> &mesh_ids);
+
+   /// Like draw_indirect(), but which meshes are drawn is decided on the GPU: a compute pass tests
+   /// each mesh's bounds transformed by `view_proj` against the view frustum and against the
+   /// depth of the previous frame, and writes draw commands for the visible ones only. Meshes must
+   /// share one geometry arena, meshes outside arenas are drawn without culling. Where
+   /// VK_KHR_draw_indirect_count is supported, the GPU reads how many meshes to draw. Can be called
+   /// once per frame, and `view_proj` should be the transform the bound material draws with. A
+   /// late latched frame culls with the camera sampled at submission instead, like the matrices
+   /// passed to late_latch(). The first call only enables culling for the following frames and
+   /// draws like draw_indirect().
+   void draw_culled(const std::vector<int> &mesh_ids, const Mat4 &view_proj);
+
+   /// Counts from the last completed frame that called draw_culled()
+   inline const CullStats &cull_stats() const {
+      return cull_stats_;
+   }
+
+   /// Starts timing the frame, each render graph pass and each material batch on the GPU. Returns
+   /// false if the device can't write timestamps. Must be called between frames.
+   bool enable_gpu_profiler();
+
+   /// nullptr unless enable_gpu_profiler() succeeded. Results lag frames_in_flight frames behind.
+   inline const GpuProfiler *gpu_profiler() const {
+      return gpu_profiler_.has_value() ? &*gpu_profiler_ : nullptr;
+   }
+
+   /// The frame's passes with their barriers and attachments, see RenderGraph::describe()
+   inline std::string render_graph_report() const {
+      return render_graph_.describe();
+   }
+
+   /// Draws the mesh once per instance in `instances_id` with a material from
+   /// create_instanced_material()
+   void draw_instanced(int mesh_id, int instances_id);
+
+   /// Records the items in order. With more than one recording thread the list is split evenly
+   /// between the workers, each recording into its own secondary command buffer. Bindless materials
+   /// can't be drawn this way, their per-draw data comes from push_constants().
+   void draw_parallel(const std::vector<DrawItem> &items);
+
+   /// Queues a draw for draw_queue(). Queued draws are ordered by `layer`, then grouped by material
+   /// and geometry buffers, then drawn front to back by `depth`.
+   void submit(const DrawItem &item, float depth = 0, int layer = 0);
+
+   /// Sorts and records every draw submitted since the last call. end_draw() draws anything that is
+   /// still queued.
+   void draw_queue();
+
+   /// Binds recorded and skipped during the last frame
+   inline const BindStats &bind_stats() const {
+      return last_bind_stats_;
+   }
+
+   /// Sets how many worker threads draw_parallel() uses, 1 records on the calling thread. Takes
+   /// effect from the next begin_draw(), so it must not be called while a frame is being recorded.
+   void set_recording_threads(int num_threads);
+
+   inline int recording_threads() const {
+      return recording_pool_ != nullptr ? recording_pool_->num_workers() : 1;
+   }
+
    void end_draw();
 
-   inline void wait_idle() const {
+   /// Late latching: with a camera source, end_draw() samples it right before submitting the frame
+   /// and writes its view-projection over every matrix passed to late_latch() that frame. The
+   /// frame then shows the camera as of submission rather than as of write_uniform(), which may
+   /// be a whole frame of input earlier, as long as the source reads the input that arrived in
+   /// the meantime. An empty function turns late latching off.
+   inline void set_camera_source(std::function<CameraSample()> source) {
+      camera_source_ = std::move(source);
+   }
+
+   inline bool late_latching() const {
+      return camera_source_ != nullptr;
+   }
+
+   /// Marks the Mat4 at `offset` in this frame's uniform ring, an offset returned by
+   /// write_uniform() plus the matrix's offset in the uniform, for late latching
+   inline void late_latch(uint32_t offset) {
+      late_latch_offsets_.push_back(offset);
+   }
+
+   /// When the input shown by the frame being recorded was read, for frames that aren't late
+   /// latched. Late latched frames take the time from their CameraSample.
+   inline void set_input_time(std::chrono::steady_clock::time_point time) {
+      input_time_ = time;
+   }
+
+   /// Called once every frame has been presented, to measure input latency with and without late
+   /// latching
+   inline void set_latency_hook(std::function<void(const FrameLatency &)> hook) {
+      latency_hook_ = std::move(hook);
+   }
+
+   /// Destroys `resource` once the frame being recorded, or the next one submitted if none is, has
+   /// completed, since draws and uploads recorded so far may still use it
+   template <class T> void retire(T &&resource) {
+      deletion_queue_.retire(retire_serial(), std::move(resource));
+   }
+
+   inline void wait_idle() {
       device_.wait_idle();
+      deletion_queue_.release_all();
+   }
+
+   inline int current_frame() const {
+      return current_frame_;
+   }
+
+   inline int frames_in_flight() const {
+      return frames_.size();
+   }
+
+   inline bool separate_transfer_queue() const {
+      return physical_device_.transfer_queue() != physical_device_.graphics_queue();
    }
 
 private:
-   void create_framebuffers();
+   static constexpr VkDeviceSize kStagingCapacity = 32 * 1024 * 1024;
+   static constexpr VkDeviceSize kMaxUploadChunk = kStagingCapacity / 4;
+   static constexpr uint32_t kInitialIndirectCommands = 1024;
+   /// Bytes per frame
+   static constexpr VkDeviceSize kInitialUniformRingSize = 64 * 1024;
+
+   /// Declares the frame's passes and compiles them for the swapchain extent. The device must be
+   /// idle.
+   void build_render_graph();
+
+   /// Adds the Hi-Z pass to the render graph and creates occlusion_culler_
+   void enable_occlusion_culling();
+
+   template <class Vertex> void upload_mesh(Mesh<Vertex> &mesh) {
+      GpuMesh &gpu_mesh = meshes_.get(mesh.id_);
+      size_t vertices_size = sizeof(Vertex) * mesh.vertices_.size();
+
+      if (gpu_mesh.arena != -1) {
+         GeometryArena &arena = arenas_[gpu_mesh.arena];
+         upload_buffer(
+             mesh.vertices_.data(), vertices_size, arena.vertex_buffer(),
+             gpu_mesh.range.first_vertex * sizeof(Vertex)
+         );
+         upload_buffer(
+             index_data(mesh.indices_, GeometryArena::kIndexType),
+             mesh.indices_.size() * index_size(GeometryArena::kIndexType), arena.index_buffer(),
+             gpu_mesh.range.first_index * index_size(GeometryArena::kIndexType)
+         );
+         return;
+      }
+
+      VertexIndexBuffer &buf = *gpu_mesh.buffer;
+      upload_buffer(mesh.vertices_.data(), vertices_size, buf, 0);
+      upload_buffer(
+          index_data(mesh.indices_, buf.index_type()),
+          mesh.indices_.size() * index_size(buf.index_type()), buf, buf.index_offset()
+      );
+   }
+
+   /// Copies the mesh straight into a host-visible buffer
+   template <class Vertex> void write_mesh(const Mesh<Vertex> &mesh, VertexIndexBuffer &buf) {
+      size_t vertices_size = sizeof(Vertex) * mesh.vertices_.size();
+      size_t indices_size = index_size(buf.index_type()) * mesh.indices_.size();
+      uint8_t *mapped = reinterpret_cast<uint8_t *>(buf.mapped());
+
+      std::memcpy(mapped, mesh.vertices_.data(), vertices_size);
+      write_indices(mesh.indices_, buf.index_type(), mapped + buf.index_offset());
+      buf.flush(0, vertices_size + indices_size);
+   }
+
+   /// `indices` as `type`, ready to stage. 16-bit indices are narrowed into index_scratch_, which
+   /// the next call overwrites.
+   const void *index_data(
+       const std::vector<VertexIndexBuffer::IndexType> &indices, VkIndexType type
+   );
+
+   /// Retires the mesh's own buffer. Uploads that write to it must have been flushed.
+   void retire_mesh_buffer(int mesh_id);
+
+   /// Serial of the next frame submission, which completes after everything submitted so far
+   inline uint64_t retire_serial() const {
+      return frame_serial_ + 1;
+   }
+
+   /// What is bound in a command buffer, so that binding the same state again can be skipped
+   struct BoundState {
+      int material_id;
+      int descriptor_material_id;
+      /// Whether the bindless set is bound at set 0 with the shared bindless layout
+      bool bindless_set;
+      uint32_t uniform_offset;
+      VkBuffer vertex_buffer;
+      VkBuffer index_buffer;
+      VkDeviceSize index_offset;
+   };
+
+   static constexpr BoundState kNothingBound = {
+       .material_id = -1,
+       .descriptor_material_id = -1,
+       .bindless_set = false,
+       .uniform_offset = 0,
+       .vertex_buffer = VK_NULL_HANDLE,
+       .index_buffer = VK_NULL_HANDLE,
+       .index_offset = 0,
+   };
+
+   /// Size of the swapchain images, or of the offscreen images when headless
+   inline VkExtent2D target_extent() const {
+      return swapchain_.has_value() ? swapchain_->extent() : offscreen_->extent();
+   }
+
+   /// Sets the viewport and scissor to target_extent(). Secondary command buffers don't
+   /// inherit them, so every command buffer that draws needs this once.
+   void record_viewport(VkCommandBuffer cmd_buf);
+
+   void record_material(
+       VkCommandBuffer cmd_buf, int material_id, BoundState &bound, BindStats &stats
+   );
+
+   void record_uniform(
+       VkCommandBuffer cmd_buf, int material_id, uint32_t offset, BoundState &bound,
+       BindStats &stats
+   );
+
+   void bind_geometry(
+       VkCommandBuffer cmd_buf, VkBuffer vertex_buffer, VkBuffer index_buffer,
+       VkDeviceSize index_offset, VkIndexType index_type, BoundState &bound, BindStats &stats
+   );
+
+   /// Binds the mesh's vertex and index buffers and fills in where the mesh starts in them
+   void bind_mesh(
+       VkCommandBuffer cmd_buf, int mesh_id, VkDrawIndexedIndirectCommand *command,
+       BoundState &bound, BindStats &stats
+   );
+
+   void record_draws(
+       VkCommandBuffer cmd_buf, const DrawItem *items, size_t num_items, BoundState &bound,
+       BindStats &stats
+   );
+
+   /// Begins a secondary command buffer that continues the current frame's render pass
+   void begin_secondary(VkCommandBuffer cmd_buf);
+
+   /// Grows the current frame's indirect buffer so `count` more commands fit
+   void reserve_indirect_commands(uint32_t count);
+
+   /// Replaces the uniform ring with one whose slices hold at least `min_frame_capacity` bytes,
+   /// and gives every material that reads it a new descriptor set. Works while recording.
+   void grow_uniform_ring(VkDeviceSize min_frame_capacity);
+   void replace_uniform_ring_set(int material_id);
+
+   VkCommandBuffer upload_command_buffer();
+
+   VkDeviceSize stage(const void *data, size_t size, VkDeviceSize alignment);
+
+   void reclaim_uploads();
+
+   /// Waits for the current frame's fence, then recycles its command buffers, releases what it
+   /// retired and reads back its queries. Does nothing if it already ran for this frame.
+   void wait_for_current_frame();
+   /// Waits until every submitted frame has completed, without waiting for presentation. A frame
+   /// being recorded is not waited for.
+   void wait_for_frames();
+
+   struct UploadBatch {
+      CommandPool command_pool;
+      VkFence fence;
+      uint64_t serial;
+   };
+
+   /// A mesh either owns its buffer or lives in a geometry arena
+   struct GpuMesh {
+      std::optional<VertexIndexBuffer> buffer;
+      /// Local-space bounds for draw_culled()
+      Aabb bounds;
+      int arena;
+      ArenaRange range;
+      /// Created with init_dynamic_mesh()
+      bool dynamic;
+   };
+
+   struct Frame {
+      CommandPool command_pool;
+      /// Secondary buffers for the main thread's draws when recording in parallel
+      CommandPool secondary_pool;
+      /// One secondary pool per draw_parallel() worker
+      std::vector<CommandPool> worker_pools;
+      /// Secondary buffers of this frame in the order they execute in the render pass
+      std::vector<VkCommandBuffer> secondaries;
+      /// Culling requested by draw_culled(), recorded by end_draw() and submitted ahead of the
+      /// frame's draws
+      VkCommandBuffer cull_command_buffer;
+      uint32_t num_cull_objects;
+      /// The view-projection passed to draw_culled(), replaced by the late latched camera
+      Mat4 cull_view_proj;
+      bool count_culled_draws;
+      VkSemaphore sem_img_avail;
+      VkSemaphore sem_render_complete;
+      VkFence draw_cycle_complete;
+      /// Upload semaphores waited on by this frame's submission, reusable once it completes
+      std::vector<VkSemaphore> upload_semaphores;
+      std::optional<IndirectBuffer> indirect_buffer;
+      uint32_t num_indirect_commands;
+      /// Value of frame_serial_ when this frame was last submitted
+      uint64_t serial;
+   };
 
    struct Material {
+      /// Profiler scope name: the path of the vertex shader up to "-vert"
+      std::string name;
+      /// VK_NULL_HANDLE for bindless materials, which only use the bindless set
       VkDescriptorSetLayout descriptor_set_layout;
+      /// Bindings of descriptor_set_layout, to make a new set when the uniform ring grows
+      std::vector<VkDescriptorSetLayoutBinding> bindings;
       Pipeline pipeline;
-      DescriptorPool descriptor_pool;
+      std::optional<DescriptorPool> descriptor_pool;
       VkDescriptorSet descriptor_set;
+      /// Bytes of uniforms a draw reads from the uniform ring, 0 if the material doesn't use it
+      uint32_t uniform_ring_range;
+      VkShaderStageFlags push_constant_stages;
+      bool bindless;
    };
 
    Instance &vk_instance_;
    PhysicalDevice physical_device_;
    Device device_;
-   Swapchain swapchain_;
-   VkRenderPass render_pass_;
+   MemoryAllocator allocator_;
+   PipelineCache pipeline_cache_;
+   float pipeline_creation_ms_;
+   /// Exactly one of the two is set, see headless()
+   std::optional<Swapchain> swapchain_;
+   std::optional<OffscreenTarget> offscreen_;
+   PresentProfile present_profile_;
+   FramePacing frame_pacing_;
+   /// The frame's passes, which own the depth image. Depth is shared by all frames in flight.
+   RenderGraph render_graph_;
+   int graph_swapchain_;
+   int graph_depth_;
+   int scene_pass_;
+   /// Builds the Hi-Z pyramid once occlusion culling is enabled, -1 before
+   int hiz_pass_;
+   bool visualize_overdraw_;
+   VkFormat depth_format_;
+   std::function<CameraSample()> camera_source_;
+   /// Uniform ring offsets of this frame's late latched matrices
+   std::vector<uint32_t> late_latch_offsets_;
+   std::chrono::steady_clock::time_point input_time_;
+   std::function<void(const FrameLatency &)> latency_hook_;
+   /// Set by the first draw_culled(), the next begin_draw() creates occlusion_culler_
+   bool occlusion_culling_requested_;
+   std::optional<OcclusionCuller> occlusion_culler_;
+   CullStats cull_stats_;
+   std::optional<GpuProfiler> gpu_profiler_;
+   /// Open profiler scopes of the frame and of the material batch being recorded
+   int frame_scope_;
+   int material_scope_;
    std::vector<Material> materials_;
+   /// Present when the device supports descriptor indexing
+   std::optional<BindlessSet> bindless_;
+   /// Shared by every bindless material: the bindless set and kBindlessPushConstantSize bytes of
+   /// push constants
+   VkPipelineLayout bindless_layout_;
    std::unordered_map<std::string, Shader> shaders_;
-   Slab<VertexIndexBuffer> meshes_;
-   std::vector<VkFramebuffer> framebuffers_;
+   Slab<GpuMesh> meshes_;
+   std::vector<GeometryArena> arenas_;
+   Slab<InstanceBuffer> instance_buffers_;
+   /// Scratch space for draw_indirect(), one list of commands per arena
+   std::vector<std::vector<VkDrawIndexedIndirectCommand>> arena_draws_;
+   /// Swapchain image of the frame being recorded
    uint32_t current_framebuffer_;
    VkSampler sampler_;
-   CommandPool command_pool_;
-   VkCommandBuffer preframe_cmd_buf_;
+   /// Pool of the upload batch being recorded, only valid while upload_cmd_buf_ is set
+   CommandPool upload_pool_;
+   VkCommandBuffer upload_cmd_buf_;
+   std::deque<UploadBatch> pending_uploads_;
+   std::vector<CommandPool> free_upload_pools_;
+   std::vector<VkFence> free_upload_fences_;
+   uint64_t upload_serial_;
+   /// Buffers written by the upload batch that is being recorded
+   std::vector<VkBuffer> upload_dst_buffers_;
+   /// Acquire halves of ownership transfers from the transfer queue, recorded in the next frame
+   std::vector<VkBufferMemoryBarrier> pending_buffer_acquires_;
+   std::vector<VkImageMemoryBarrier> pending_image_acquires_;
+   /// Signalled by submitted upload batches that no frame has waited on yet
+   std::vector<VkSemaphore> pending_upload_semaphores_;
+   std::vector<VkSemaphore> free_upload_semaphores_;
+   std::vector<Frame> frames_;
+   int current_frame_;
+   /// Whether wait_for_current_frame() ran since current_frame_ last advanced
+   bool current_frame_ready_;
+   /// Number of frames submitted so far, resources retired with a serial are destroyed once the
+   /// frame submitted with it completes
+   uint64_t frame_serial_;
+   VkCommandBuffer primary_command_buffer_;
+   /// Where draw commands from the main thread are recorded, the primary buffer unless the frame
+   /// records its render pass in secondary buffers
    VkCommandBuffer command_buffer_;
-   VkSemaphore sem_img_avail;
-   VkSemaphore sem_render_complete;
-   VkFence draw_cycle_complete;
+   /// What is bound in command_buffer_
+   BoundState bound_;
+   BindStats bind_stats_;
+   BindStats last_bind_stats_;
+   RenderQueue render_queue_;
+   bool secondary_recording_;
+   std::unique_ptr<ThreadPool> recording_pool_;
 
    StagingBuffer staging_buffer_;
+   /// Mesh indices narrowed to 16 bits on their way to the staging buffer
+   std::vector<uint16_t> index_scratch_;
+   std::optional<UniformRing> uniform_ring_;
+   /// Rings grow_uniform_ring() replaced since the last submission. Draws recorded before the
+   /// growth read them, so end_draw() late latches and flushes them before retiring them.
+   std::vector<UniformRing> outgrown_rings_;
+   /// Destroyed first, so that the resources it holds go before the allocator and device
+   DeletionQueue deletion_queue_;
 };
 
 }; // namespace vkad
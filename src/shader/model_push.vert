@@ -0,0 +1,29 @@
+#version 450
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec2 oct_normal;
+
+layout(push_constant) uniform PushConstants {
+    mat4 mvp;
+    vec3 color;
+} u;
+
+layout(location = 0) out vec3 pass_color;
+
+const vec3 sun = vec3(1, 1, 1);
+
+// Inverse of the octahedral encoding of OctNormal, whose two snorm16 arrive in [-1, 1]
+vec3 decode_normal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
+void main() {
+    vec3 normal = decode_normal(oct_normal);
+    gl_Position = u.mvp * vec4(pos, 1.0);
+    float brightness = dot(sun, normal);
+    float normalized_brightness = (brightness / 4) + 0.75;
+    pass_color = u.color * normalized_brightness;
+}
@@ -0,0 +1,8 @@
+#version 450
+
+layout(location = 0) out vec4 out_color;
+
+// Blended additively, so a pixel shaded 10 times ends up white
+void main() {
+    out_color = vec4(0.1, 0.1, 0.1, 1.0);
+}
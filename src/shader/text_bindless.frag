@@ -0,0 +1,21 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 pass_color;
+layout(location = 1) in vec2 pass_tex_coord;
+
+// The bindless set, see BindlessSet
+layout(set = 0, binding = 0) uniform sampler2D textures[];
+
+layout(push_constant) uniform PushConstants {
+    mat4 mvp;
+    vec3 color;
+    layout(offset = 80) uint texture_index;
+} pc;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    // Push constants are the same for the whole draw, so the index needs no nonuniformEXT()
+    out_color = texture(textures[pc.texture_index], pass_tex_coord).x * vec4(pass_color, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 450
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec2 tex_coord;
+
+// UiPushConstants, whose Vec3 is padded to 16 bytes
+layout(push_constant) uniform PushConstants {
+    mat4 mvp;
+    vec3 color;
+    layout(offset = 80) uint texture_index;
+} pc;
+
+layout(location = 0) out vec3 pass_color;
+layout(location = 1) out vec2 pass_tex_coord;
+
+void main() {
+    gl_Position = pc.mvp * vec4(pos, 1.0);
+    pass_color = pc.color;
+    pass_tex_coord = tex_coord;
+}
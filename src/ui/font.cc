@@ -1,7 +1,7 @@
 #include "font.h"
 #include "gpu/buffer.h"
 #include "gpu/image.h"
-#include "gpu/physical_device.h"
+#include "gpu/memory_allocator.h"
 #include "math/vec2.h"
 #include "ui/ui.h"
 #include "ui/widget.h"
@@ -18,12 +18,10 @@
 
 using namespace vkad;
 
-Font::Font(
-    const std::string &path, float height, const PhysicalDevice &physical_device, VkDevice device
-)
+Font::Font(const std::string &path, float height, MemoryAllocator &allocator)
     : height_(height),
       image_(
-          physical_device, device, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+          allocator, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
           VK_FORMAT_R8_UNORM, kBitmapWidth, kBitmapWidth
       ) {
 
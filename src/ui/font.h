@@ -5,7 +5,7 @@
 #include <string>
 
 #include "gpu/image.h"
-#include "gpu/physical_device.h"
+#include "gpu/memory_allocator.h"
 #include "ui/widget.h"
 #include "vendor/stb_truetype.h"
 
@@ -13,9 +13,7 @@ namespace vkad {
 
 class Font {
 public:
-   Font(
-       const std::string &path, float height, const PhysicalDevice &physical_device, VkDevice device
-   );
+   Font(const std::string &path, float height, MemoryAllocator &allocator);
 
    Widget create_text(const std::string &text);
 
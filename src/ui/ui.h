@@ -2,19 +2,21 @@
 #define VKAD_UI_UI_H_
 
 #include <array>
+#include <cstdint>
 
 #include <vulkan/vulkan_core.h>
 
 #include "math/attributes.h"
 #include "math/mat4.h"
-#include "math/vec2.h"
+#include "math/packed.h"
 #include "math/vec3.h"
 
 namespace vkad {
 
+/// 16 bytes
 struct UiVertex {
-   Vec3 pos;
-   Vec2 tex_coord;
+   PackedVec3 pos;
+   Half2 tex_coord;
 
    static const std::array<VkVertexInputAttributeDescription, 2> kAttributes;
 };
@@ -29,6 +31,13 @@ struct UiUniform {
    Vec3 color;
 };
 
+/// Per-draw data of the bindless text material, which samples the bindless image `texture_index`
+struct UiPushConstants {
+   Mat4 mvp;
+   Vec3 color;
+   uint32_t texture_index;
+};
+
 } // namespace vkad
 
 #endif // !VKAD_UI_UI_H_
@@ -0,0 +1,144 @@
+#ifndef VKAD_UTIL_BUDDY_ALLOCATOR_H_
+#define VKAD_UTIL_BUDDY_ALLOCATOR_H_
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace vkad {
+
+/// Hands out power-of-two sized ranges of a fixed capacity. Every range is aligned to its own size,
+/// and freeing a range merges it with its buddy whenever both halves are free again.
+class BuddyAllocator {
+public:
+   static constexpr uint64_t kInvalidOffset = UINT64_MAX;
+
+   /// `capacity` and `min_block_size` must be powers of two
+   explicit BuddyAllocator(uint64_t capacity, uint64_t min_block_size)
+       : capacity_(capacity), min_block_size_(min_block_size), allocated_bytes_(0),
+         requested_bytes_(0) {
+      int num_levels = std::countr_zero(capacity) - std::countr_zero(min_block_size) + 1;
+      free_blocks_.resize(num_levels);
+      free_blocks_[0].insert(0);
+   }
+
+   uint64_t allocate(uint64_t size, uint64_t alignment) {
+      uint64_t block_size = std::bit_ceil(std::max({size, alignment, min_block_size_}));
+      if (block_size > capacity_) {
+         return kInvalidOffset;
+      }
+
+      int level = level_of(block_size);
+      int available = level;
+      while (available >= 0 && free_blocks_[available].empty()) {
+         --available;
+      }
+
+      if (available < 0) {
+         return kInvalidOffset;
+      }
+
+      uint64_t offset = *free_blocks_[available].begin();
+      free_blocks_[available].erase(free_blocks_[available].begin());
+
+      // Split the block in halves until it's the requested size, keeping the upper halves free
+      while (available < level) {
+         ++available;
+         free_blocks_[available].insert(offset + block_size_at(available));
+      }
+
+      allocations_[offset] = {.level = level, .requested = size};
+      allocated_bytes_ += block_size;
+      requested_bytes_ += size;
+      return offset;
+   }
+
+   void free(uint64_t offset) {
+      auto it = allocations_.find(offset);
+      if (it == allocations_.end()) {
+         return;
+      }
+
+      int level = it->second.level;
+      allocated_bytes_ -= block_size_at(level);
+      requested_bytes_ -= it->second.requested;
+      allocations_.erase(it);
+
+      while (level > 0) {
+         uint64_t buddy = offset ^ block_size_at(level);
+         auto buddy_it = free_blocks_[level].find(buddy);
+         if (buddy_it == free_blocks_[level].end()) {
+            break;
+         }
+
+         free_blocks_[level].erase(buddy_it);
+         offset = std::min(offset, buddy);
+         --level;
+      }
+
+      free_blocks_[level].insert(offset);
+   }
+
+   inline uint64_t capacity() const {
+      return capacity_;
+   }
+
+   /// Bytes taken up by allocated blocks, including the padding to a power of two
+   inline uint64_t allocated_bytes() const {
+      return allocated_bytes_;
+   }
+
+   /// Bytes that were actually asked for
+   inline uint64_t requested_bytes() const {
+      return requested_bytes_;
+   }
+
+   inline uint64_t free_bytes() const {
+      return capacity_ - allocated_bytes_;
+   }
+
+   inline size_t num_allocations() const {
+      return allocations_.size();
+   }
+
+   inline bool empty() const {
+      return allocations_.empty();
+   }
+
+   uint64_t largest_free_block() const {
+      for (int level = 0; level < free_blocks_.size(); ++level) {
+         if (!free_blocks_[level].empty()) {
+            return block_size_at(level);
+         }
+      }
+      return 0;
+   }
+
+private:
+   struct AllocationInfo {
+      int level;
+      uint64_t requested;
+   };
+
+   inline uint64_t block_size_at(int level) const {
+      return capacity_ >> level;
+   }
+
+   inline int level_of(uint64_t block_size) const {
+      return std::countr_zero(capacity_) - std::countr_zero(block_size);
+   }
+
+   uint64_t capacity_;
+   uint64_t min_block_size_;
+   uint64_t allocated_bytes_;
+   uint64_t requested_bytes_;
+   std::vector<std::set<uint64_t>> free_blocks_;
+   std::unordered_map<uint64_t, AllocationInfo> allocations_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_UTIL_BUDDY_ALLOCATOR_H_
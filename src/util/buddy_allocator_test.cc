@@ -0,0 +1,49 @@
+#include "buddy_allocator.h"
+
+#include "vendor/doctest.h"
+
+using namespace vkad;
+
+TEST_CASE("BuddyAllocator splits and merges blocks") {
+   BuddyAllocator buddy(1024, 64);
+
+   uint64_t a = buddy.allocate(100, 1);
+   uint64_t b = buddy.allocate(64, 1);
+   uint64_t c = buddy.allocate(64, 1);
+
+   CHECK(a == 0);
+   CHECK(b == 128);
+   CHECK(c == 192);
+   CHECK(buddy.allocated_bytes() == 256);
+   CHECK(buddy.requested_bytes() == 228);
+   CHECK(buddy.largest_free_block() == 512);
+
+   buddy.free(b);
+   buddy.free(c);
+   buddy.free(a);
+
+   CHECK(buddy.empty());
+   CHECK(buddy.largest_free_block() == 1024);
+   CHECK(buddy.allocate(1024, 1) == 0);
+}
+
+TEST_CASE("BuddyAllocator respects alignment") {
+   BuddyAllocator buddy(4096, 64);
+
+   buddy.allocate(64, 1);
+   uint64_t aligned = buddy.allocate(64, 1024);
+
+   CHECK(aligned % 1024 == 0);
+   CHECK(aligned != 0);
+}
+
+TEST_CASE("BuddyAllocator reports exhaustion") {
+   BuddyAllocator buddy(256, 64);
+
+   CHECK(buddy.allocate(512, 1) == BuddyAllocator::kInvalidOffset);
+   for (int i = 0; i < 4; ++i) {
+      CHECK(buddy.allocate(64, 1) != BuddyAllocator::kInvalidOffset);
+   }
+   CHECK(buddy.allocate(64, 1) == BuddyAllocator::kInvalidOffset);
+   CHECK(buddy.free_bytes() == 0);
+}
@@ -0,0 +1,99 @@
+#ifndef VKAD_UTIL_DELETION_QUEUE_H_
+#define VKAD_UTIL_DELETION_QUEUE_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace vkad {
+
+/// Keeps resources alive until the GPU work that may still use them has completed. Every resource
+/// is tagged with the serial of the last submission that can use it, and is destroyed once
+/// release_until() reaches that serial.
+class DeletionQueue {
+public:
+   DeletionQueue() = default;
+
+   DeletionQueue(const DeletionQueue &other) = delete;
+
+   DeletionQueue &operator=(const DeletionQueue &other) = delete;
+
+   /// Takes ownership of `resource`, whose destructor frees it. Serials must not decrease.
+   template <class T> void retire(uint64_t serial, T &&resource) {
+      static_assert(!std::is_lvalue_reference_v<T>, "resources must be moved into the queue");
+      entries_.push_back({
+          .serial = serial,
+          .resource = std::make_unique<Holder<std::decay_t<T>>>(std::move(resource)),
+      });
+   }
+
+   /// Calls `destroy` once `serial` has completed, for handles that don't free themselves
+   void retire_call(uint64_t serial, std::function<void()> destroy) {
+      retire(serial, DeferredCall(std::move(destroy)));
+   }
+
+   /// Destroys everything retired with a serial up to and including `serial`
+   void release_until(uint64_t serial) {
+      while (!entries_.empty() && entries_.front().serial <= serial) {
+         entries_.pop_front();
+      }
+   }
+
+   /// Destroys everything, for when the device is known to be idle
+   void release_all() {
+      while (!entries_.empty()) {
+         entries_.pop_front();
+      }
+   }
+
+   inline size_t size() const {
+      return entries_.size();
+   }
+
+   inline bool empty() const {
+      return entries_.empty();
+   }
+
+private:
+   struct Retired {
+      virtual ~Retired() = default;
+   };
+
+   template <class T> struct Holder : Retired {
+      explicit Holder(T &&resource) : resource(std::move(resource)) {}
+
+      T resource;
+   };
+
+   class DeferredCall {
+   public:
+      explicit DeferredCall(std::function<void()> &&destroy) : destroy_(std::move(destroy)) {}
+
+      explicit DeferredCall(DeferredCall &&other) : destroy_(std::move(other.destroy_)) {
+         other.destroy_ = nullptr;
+      }
+
+      ~DeferredCall() {
+         if (destroy_) {
+            destroy_();
+         }
+      }
+
+   private:
+      std::function<void()> destroy_;
+   };
+
+   struct Entry {
+      uint64_t serial;
+      std::unique_ptr<Retired> resource;
+   };
+
+   std::deque<Entry> entries_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_UTIL_DELETION_QUEUE_H_
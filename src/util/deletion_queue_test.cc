@@ -0,0 +1,53 @@
+#include "deletion_queue.h"
+
+#include <memory>
+#include <vector>
+
+#include "vendor/doctest.h"
+
+using namespace vkad;
+
+TEST_CASE("DeletionQueue destroys resources once their serial completes") {
+   DeletionQueue queue;
+   std::vector<int> destroyed;
+
+   queue.retire_call(1, [&destroyed] { destroyed.push_back(1); });
+   queue.retire_call(2, [&destroyed] { destroyed.push_back(2); });
+   queue.retire_call(2, [&destroyed] { destroyed.push_back(3); });
+   CHECK(queue.size() == 3);
+
+   queue.release_until(0);
+   CHECK(destroyed.empty());
+
+   queue.release_until(1);
+   CHECK(destroyed == std::vector<int>{1});
+
+   queue.release_until(5);
+   CHECK(destroyed == std::vector<int>{1, 2, 3});
+   CHECK(queue.empty());
+}
+
+TEST_CASE("DeletionQueue owns move-only resources") {
+   DeletionQueue queue;
+   auto resource = std::make_shared<int>(7);
+   std::weak_ptr<int> weak = resource;
+
+   // unique_ptr can't be copied, so this checks nothing needs to be
+   queue.retire(3, std::make_unique<std::shared_ptr<int>>(std::move(resource)));
+   CHECK(!weak.expired());
+
+   queue.release_until(2);
+   CHECK(!weak.expired());
+
+   queue.release_all();
+   CHECK(weak.expired());
+}
+
+TEST_CASE("DeletionQueue destroys what is left when it is destroyed") {
+   bool destroyed = false;
+   {
+      DeletionQueue queue;
+      queue.retire_call(1, [&destroyed] { destroyed = true; });
+   }
+   CHECK(destroyed);
+}
@@ -0,0 +1,101 @@
+#ifndef VKAD_UTIL_FRAME_PACING_H_
+#define VKAD_UTIL_FRAME_PACING_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "util/stats.h"
+
+namespace vkad {
+
+struct FramePacingStats {
+   /// Milliseconds between consecutive presents, over the last FramePacing::capacity() presents
+   TimingSummary interval_ms;
+   /// 0 if the refresh rate isn't known
+   float refresh_interval_ms;
+   int presents;
+   /// Refreshes that showed the previous frame again because the next one wasn't presented in
+   /// time, since the last reset(). Always 0 if the refresh rate isn't known.
+   int missed_vblanks;
+};
+
+/// Present intervals measured on the CPU when presents are queued. Without a present timing
+/// extension this is the closest the application gets to when frames reach the display, and with
+/// FIFO the queue blocks often enough that presents follow the refreshes. An interval of about n
+/// refreshes counts n - 1 missed vblanks.
+class FramePacing {
+public:
+   using Clock = std::chrono::steady_clock;
+
+   explicit FramePacing(int capacity = 600)
+       : intervals_ms_(capacity),
+         next_(0),
+         count_(0),
+         refresh_interval_ms_(0),
+         presents_(0),
+         missed_vblanks_(0),
+         has_last_present_(false) {}
+
+   /// `hz` of 0 means unknown
+   void set_refresh_rate(float hz) {
+      refresh_interval_ms_ = hz > 0 ? 1000.0f / hz : 0.0f;
+   }
+
+   void record_present(Clock::time_point time) {
+      ++presents_;
+      if (has_last_present_) {
+         float interval = std::chrono::duration<float, std::milli>(time - last_present_).count();
+         intervals_ms_[next_] = interval;
+         next_ = (next_ + 1) % intervals_ms_.size();
+         count_ = std::min(count_ + 1, static_cast<int>(intervals_ms_.size()));
+
+         if (refresh_interval_ms_ > 0) {
+            int refreshes = static_cast<int>(std::lround(interval / refresh_interval_ms_));
+            missed_vblanks_ += std::max(refreshes - 1, 0);
+         }
+      }
+      last_present_ = time;
+      has_last_present_ = true;
+   }
+
+   FramePacingStats stats() const {
+      return {
+          .interval_ms = summarize_timings(std::vector<float>(
+              intervals_ms_.begin(), intervals_ms_.begin() + count_
+          )),
+          .refresh_interval_ms = refresh_interval_ms_,
+          .presents = presents_,
+          .missed_vblanks = missed_vblanks_,
+      };
+   }
+
+   /// Forgets every present, for when presenting restarts after a pause such as a resize
+   void reset() {
+      next_ = 0;
+      count_ = 0;
+      presents_ = 0;
+      missed_vblanks_ = 0;
+      has_last_present_ = false;
+   }
+
+   inline int capacity() const {
+      return static_cast<int>(intervals_ms_.size());
+   }
+
+private:
+   /// Until it fills up the first `count_` intervals are used, after that `next_` is the oldest
+   std::vector<float> intervals_ms_;
+   int next_;
+   int count_;
+   float refresh_interval_ms_;
+   int presents_;
+   int missed_vblanks_;
+   bool has_last_present_;
+   Clock::time_point last_present_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_UTIL_FRAME_PACING_H_
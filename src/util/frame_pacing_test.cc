@@ -0,0 +1,45 @@
+#include "frame_pacing.h"
+
+#include "vendor/doctest.h"
+
+#include <chrono>
+
+using namespace vkad;
+
+TEST_CASE("FramePacing measures present intervals and counts missed vblanks") {
+   using namespace std::chrono_literals;
+
+   FramePacing pacing(8);
+   pacing.set_refresh_rate(100);
+
+   FramePacing::Clock::time_point time;
+   pacing.record_present(time);
+   // One refresh, one late frame that was shown a refresh later, one shown two refreshes later
+   pacing.record_present(time += 10ms);
+   pacing.record_present(time += 21ms);
+   pacing.record_present(time += 29ms);
+
+   FramePacingStats stats = pacing.stats();
+   CHECK(stats.presents == 4);
+   CHECK(stats.refresh_interval_ms == doctest::Approx(10));
+   CHECK(stats.interval_ms.min == doctest::Approx(10));
+   CHECK(stats.interval_ms.max == doctest::Approx(29));
+   CHECK(stats.missed_vblanks == 3);
+
+   pacing.reset();
+   pacing.record_present(time += 100ms);
+   CHECK(pacing.stats().presents == 1);
+   CHECK(pacing.stats().missed_vblanks == 0);
+}
+
+TEST_CASE("FramePacing without a refresh rate misses no vblanks") {
+   using namespace std::chrono_literals;
+
+   FramePacing pacing;
+   FramePacing::Clock::time_point time;
+   pacing.record_present(time);
+   pacing.record_present(time += 50ms);
+
+   CHECK(pacing.stats().missed_vblanks == 0);
+   CHECK(pacing.stats().interval_ms.mean == doctest::Approx(50));
+}
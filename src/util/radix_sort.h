@@ -0,0 +1,59 @@
+#ifndef VKAD_UTIL_RADIX_SORT_H_
+#define VKAD_UTIL_RADIX_SORT_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace vkad {
+
+/// Stable LSD radix sort of `items` by a 64-bit key, one byte per pass. `scratch` is resized to
+/// match `items` and can be kept around between calls to avoid allocating. Passes over a byte that
+/// is the same in every key are skipped, so keys that only use a few bits sort in a few passes.
+template <class T, class KeyFn>
+void radix_sort(std::vector<T> &items, std::vector<T> &scratch, KeyFn key) {
+   constexpr int kPasses = sizeof(uint64_t);
+   std::array<std::array<size_t, 256>, kPasses> counts = {};
+
+   for (const T &item : items) {
+      uint64_t k = key(item);
+      for (int pass = 0; pass < kPasses; ++pass) {
+         ++counts[pass][(k >> (pass * 8)) & 0xff];
+      }
+   }
+
+   scratch.resize(items.size());
+
+   for (int pass = 0; pass < kPasses; ++pass) {
+      std::array<size_t, 256> &count = counts[pass];
+      bool all_same = false;
+      for (size_t c : count) {
+         if (c == items.size()) {
+            all_same = true;
+            break;
+         }
+      }
+
+      if (all_same) {
+         continue;
+      }
+
+      size_t offset = 0;
+      for (size_t &c : count) {
+         size_t n = c;
+         c = offset;
+         offset += n;
+      }
+
+      for (T &item : items) {
+         scratch[count[(key(item) >> (pass * 8)) & 0xff]++] = std::move(item);
+      }
+      items.swap(scratch);
+   }
+}
+
+} // namespace vkad
+
+#endif // !VKAD_UTIL_RADIX_SORT_H_
@@ -0,0 +1,47 @@
+#include "radix_sort.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "vendor/doctest.h"
+
+using namespace vkad;
+
+TEST_CASE("radix_sort matches std::stable_sort") {
+   std::mt19937_64 rng(7);
+   std::vector<std::pair<uint64_t, int>> items;
+   for (int i = 0; i < 1000; ++i) {
+      // Few distinct keys so that stability matters
+      items.push_back({rng() % 16 << 40 | rng() % 4, i});
+   }
+
+   auto expected = items;
+   std::stable_sort(expected.begin(), expected.end(), [](const auto &a, const auto &b) {
+      return a.first < b.first;
+   });
+
+   std::vector<std::pair<uint64_t, int>> scratch;
+   radix_sort(items, scratch, [](const auto &item) {
+      return item.first;
+   });
+   CHECK(items == expected);
+}
+
+TEST_CASE("radix_sort handles empty and uniform input") {
+   std::vector<uint64_t> scratch;
+
+   std::vector<uint64_t> empty;
+   radix_sort(empty, scratch, [](uint64_t k) {
+      return k;
+   });
+   CHECK(empty.empty());
+
+   std::vector<uint64_t> same(10, 42);
+   radix_sort(same, scratch, [](uint64_t k) {
+      return k;
+   });
+   CHECK(same == std::vector<uint64_t>(10, 42));
+}
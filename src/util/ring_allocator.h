@@ -0,0 +1,100 @@
+#ifndef VKAD_UTIL_RING_ALLOCATOR_H_
+#define VKAD_UTIL_RING_ALLOCATOR_H_
+
+#include <cstdint>
+#include <deque>
+
+#include "util/memory.h"
+
+namespace vkad {
+
+/// Allocates ranges of a fixed capacity in FIFO order. Allocations are grouped into batches that
+/// are released together once whatever consumed them (e.g. a GPU submission tagged with `serial`)
+/// has completed.
+class RingAllocator {
+public:
+   static constexpr uint64_t kInvalidOffset = UINT64_MAX;
+
+   explicit RingAllocator(uint64_t capacity)
+       : capacity_(capacity), head_(0), tail_(0), used_(0), batch_bytes_(0) {}
+
+   uint64_t allocate(uint64_t size, uint64_t alignment) {
+      if (used_ == 0) {
+         head_ = 0;
+         tail_ = 0;
+      } else if (head_ == tail_) {
+         return kInvalidOffset;
+      }
+
+      uint64_t offset = align_to(head_, alignment);
+      uint64_t new_head;
+
+      if (head_ >= tail_) {
+         if (offset + size <= capacity_) {
+            new_head = offset + size;
+         } else if (size <= tail_) {
+            // Not enough room before the end, skip the remainder and continue at the start
+            offset = 0;
+            new_head = size;
+         } else {
+            return kInvalidOffset;
+         }
+      } else {
+         if (offset + size > tail_) {
+            return kInvalidOffset;
+         }
+         new_head = offset + size;
+      }
+
+      uint64_t consumed = new_head >= head_ ? new_head - head_ : capacity_ - head_ + new_head;
+      used_ += consumed;
+      batch_bytes_ += consumed;
+      head_ = new_head == capacity_ ? 0 : new_head;
+      return offset;
+   }
+
+   /// Assigns everything allocated since the previous call to `serial`. Serials must increase.
+   void close_batch(uint64_t serial) {
+      if (batch_bytes_ == 0) {
+         return;
+      }
+
+      batches_.push_back({.serial = serial, .end = head_, .bytes = batch_bytes_});
+      batch_bytes_ = 0;
+   }
+
+   /// Releases every batch with a serial up to and including `serial`
+   void release_until(uint64_t serial) {
+      while (!batches_.empty() && batches_.front().serial <= serial) {
+         tail_ = batches_.front().end;
+         used_ -= batches_.front().bytes;
+         batches_.pop_front();
+      }
+   }
+
+   inline uint64_t capacity() const {
+      return capacity_;
+   }
+
+   inline uint64_t used() const {
+      return used_;
+   }
+
+private:
+   struct Batch {
+      uint64_t serial;
+      uint64_t end;
+      uint64_t bytes;
+   };
+
+   uint64_t capacity_;
+   uint64_t head_;
+   uint64_t tail_;
+   uint64_t used_;
+   uint64_t batch_bytes_;
+   std::deque<Batch> batches_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_UTIL_RING_ALLOCATOR_H_
@@ -0,0 +1,47 @@
+#include "ring_allocator.h"
+
+#include "vendor/doctest.h"
+
+using namespace vkad;
+
+TEST_CASE("RingAllocator wraps around once batches are released") {
+   RingAllocator ring(256);
+
+   CHECK(ring.allocate(100, 4) == 0);
+   CHECK(ring.allocate(100, 4) == 100);
+   ring.close_batch(1);
+
+   CHECK(ring.allocate(100, 4) == RingAllocator::kInvalidOffset);
+
+   ring.release_until(1);
+   CHECK(ring.used() == 0);
+
+   CHECK(ring.allocate(100, 4) == 0);
+}
+
+TEST_CASE("RingAllocator skips the tail end when an allocation doesn't fit") {
+   RingAllocator ring(256);
+
+   ring.allocate(96, 4);
+   ring.close_batch(1);
+   ring.allocate(96, 4);
+   ring.close_batch(2);
+   ring.release_until(1);
+
+   // 64 bytes are left at the end, so this has to start over at 0
+   CHECK(ring.allocate(80, 4) == 0);
+   CHECK(ring.used() == 96 + 64 + 80);
+   ring.close_batch(3);
+
+   CHECK(ring.allocate(32, 4) == RingAllocator::kInvalidOffset);
+
+   ring.release_until(3);
+   CHECK(ring.used() == 0);
+}
+
+TEST_CASE("RingAllocator aligns offsets") {
+   RingAllocator ring(256);
+
+   ring.allocate(3, 1);
+   CHECK(ring.allocate(8, 16) == 16);
+}
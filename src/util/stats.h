@@ -0,0 +1,93 @@
+#ifndef VKAD_UTIL_STATS_H_
+#define VKAD_UTIL_STATS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+namespace vkad {
+
+struct TimingSummary {
+   float mean;
+   float min;
+   float p50;
+   float p95;
+   float p99;
+   float max;
+};
+
+/// Nearest-rank percentile of already sorted samples. `percent` is in the range [0, 100].
+inline float sorted_percentile(const std::vector<float> &sorted, float percent) {
+   if (sorted.empty()) {
+      return 0;
+   }
+
+   int rank = static_cast<int>(std::ceil(percent / 100.0f * sorted.size()));
+   return sorted[std::clamp(rank - 1, 0, static_cast<int>(sorted.size()) - 1)];
+}
+
+inline TimingSummary summarize_timings(std::vector<float> samples) {
+   if (samples.empty()) {
+      return TimingSummary{};
+   }
+
+   std::sort(samples.begin(), samples.end());
+   float total = std::accumulate(samples.begin(), samples.end(), 0.0f);
+
+   return TimingSummary{
+       .mean = total / samples.size(),
+       .min = samples.front(),
+       .p50 = sorted_percentile(samples, 50),
+       .p95 = sorted_percentile(samples, 95),
+       .p99 = sorted_percentile(samples, 99),
+       .max = samples.back(),
+   };
+}
+
+/// The last `capacity` samples of a value that is measured over and over, like the time a pass
+/// takes every frame
+class RollingStats {
+public:
+   explicit RollingStats(int capacity) : samples_(capacity), next_(0), count_(0) {}
+
+   void push(float sample) {
+      samples_[next_] = sample;
+      next_ = (next_ + 1) % samples_.size();
+      count_ = std::min(count_ + 1, static_cast<int>(samples_.size()));
+   }
+
+   inline int count() const {
+      return count_;
+   }
+
+   /// The most recent sample, 0 if there are none
+   inline float last() const {
+      return count_ == 0 ? 0 : samples_[(next_ + samples_.size() - 1) % samples_.size()];
+   }
+
+   float min() const {
+      return count_ == 0 ? 0 : *std::min_element(samples_.begin(), samples_.begin() + count_);
+   }
+
+   float max() const {
+      return count_ == 0 ? 0 : *std::max_element(samples_.begin(), samples_.begin() + count_);
+   }
+
+   float mean() const {
+      if (count_ == 0) {
+         return 0;
+      }
+      return std::accumulate(samples_.begin(), samples_.begin() + count_, 0.0f) / count_;
+   }
+
+private:
+   /// Until it fills up the first `count_` samples are used, after that `next_` is the oldest
+   std::vector<float> samples_;
+   int next_;
+   int count_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_UTIL_STATS_H_
@@ -0,0 +1,47 @@
+#include "stats.h"
+
+#include "vendor/doctest.h"
+
+#include <vector>
+
+using namespace vkad;
+
+TEST_CASE("sorted_percentile") {
+   std::vector<float> samples = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+
+   CHECK(sorted_percentile(samples, 0) == 1);
+   CHECK(sorted_percentile(samples, 50) == 5);
+   CHECK(sorted_percentile(samples, 95) == 10);
+   CHECK(sorted_percentile(samples, 100) == 10);
+   CHECK(sorted_percentile({}, 50) == 0);
+}
+
+TEST_CASE("summarize_timings") {
+   TimingSummary summary = summarize_timings({4, 1, 3, 2});
+
+   CHECK(summary.mean == 2.5f);
+   CHECK(summary.min == 1);
+   CHECK(summary.p50 == 2);
+   CHECK(summary.max == 4);
+}
+
+TEST_CASE("RollingStats keeps the most recent samples") {
+   RollingStats stats(3);
+   CHECK(stats.count() == 0);
+   CHECK(stats.mean() == 0);
+
+   stats.push(4);
+   stats.push(1);
+   CHECK(stats.count() == 2);
+   CHECK(stats.min() == 1);
+   CHECK(stats.max() == 4);
+   CHECK(stats.mean() == 2.5f);
+
+   stats.push(7);
+   stats.push(10);
+   CHECK(stats.count() == 3);
+   CHECK(stats.last() == 10);
+   CHECK(stats.min() == 1);
+   CHECK(stats.max() == 10);
+   CHECK(stats.mean() == 6);
+}
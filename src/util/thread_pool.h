@@ -0,0 +1,98 @@
+#ifndef VKAD_UTIL_THREAD_POOL_H_
+#define VKAD_UTIL_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/trace.h"
+
+namespace vkad {
+
+/// A fixed set of worker threads that all run the same job together. run() blocks until every
+/// worker has finished, so the job may reference the caller's stack.
+class ThreadPool {
+public:
+   explicit ThreadPool(int num_workers) : generation_(0), remaining_(0), stopping_(false) {
+      workers_.reserve(num_workers);
+      for (int i = 0; i < num_workers; ++i) {
+         workers_.emplace_back([this, i] { work(i); });
+      }
+   }
+
+   ThreadPool(const ThreadPool &other) = delete;
+
+   ~ThreadPool() {
+      {
+         std::lock_guard lock(mutex_);
+         stopping_ = true;
+      }
+      job_ready_.notify_all();
+
+      for (std::thread &worker : workers_) {
+         worker.join();
+      }
+   }
+
+   ThreadPool &operator=(const ThreadPool &other) = delete;
+
+   /// Calls `job(worker_index)` once on every worker and waits for all of them to return
+   void run(const std::function<void(int)> &job) {
+      std::unique_lock lock(mutex_);
+      job_ = &job;
+      remaining_ = workers_.size();
+      ++generation_;
+      job_ready_.notify_all();
+
+      job_done_.wait(lock, [this] { return remaining_ == 0; });
+      job_ = nullptr;
+   }
+
+   inline int num_workers() const {
+      return workers_.size();
+   }
+
+private:
+   void work(int index) {
+      VKAD_TRACE_THREAD_NAME("worker " + std::to_string(index));
+      uint64_t seen_generation = 0;
+
+      while (true) {
+         const std::function<void(int)> *job;
+         {
+            std::unique_lock lock(mutex_);
+            job_ready_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+            if (stopping_) {
+               return;
+            }
+
+            seen_generation = generation_;
+            job = job_;
+         }
+
+         (*job)(index);
+
+         std::lock_guard lock(mutex_);
+         if (--remaining_ == 0) {
+            job_done_.notify_one();
+         }
+      }
+   }
+
+   std::vector<std::thread> workers_;
+   std::mutex mutex_;
+   std::condition_variable job_ready_;
+   std::condition_variable job_done_;
+   const std::function<void(int)> *job_;
+   uint64_t generation_;
+   int remaining_;
+   bool stopping_;
+};
+
+} // namespace vkad
+
+#endif // !VKAD_UTIL_THREAD_POOL_H_
@@ -0,0 +1,35 @@
+#include "thread_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "vendor/doctest.h"
+
+using namespace vkad;
+
+TEST_CASE("ThreadPool runs the job once on every worker") {
+   ThreadPool pool(4);
+   std::vector<int> calls(4, 0);
+
+   for (int i = 0; i < 100; ++i) {
+      pool.run([&](int worker) { ++calls[worker]; });
+   }
+
+   for (int count : calls) {
+      CHECK(count == 100);
+   }
+}
+
+TEST_CASE("ThreadPool::run waits for every worker to finish") {
+   ThreadPool pool(3);
+   std::atomic<int> finished = 0;
+
+   pool.run([&](int worker) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10 * worker));
+      ++finished;
+   });
+
+   CHECK(finished == 3);
+}
@@ -0,0 +1,334 @@
+#ifndef VKAD_UTIL_TRACE_H_
+#define VKAD_UTIL_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace vkad {
+
+enum class TraceEventType : uint8_t {
+   ZONE,
+   COUNTER,
+   FRAME,
+};
+
+struct TraceEvent {
+   /// Must outlive the trace, zones and counters are named with string literals
+   const char *name;
+   /// Nanoseconds on the steady clock
+   int64_t time_ns;
+   /// Duration in nanoseconds of a zone, value of a counter or number of a frame
+   int64_t value;
+   TraceEventType type;
+};
+
+/// Events recorded by one thread. Only the owning thread writes, and it publishes every event by
+/// bumping the size, so the trace can be exported while the thread keeps recording. A full buffer
+/// drops new events rather than growing on the hot path.
+class TraceBuffer {
+public:
+   static constexpr uint32_t kCapacity = 1 << 18;
+
+   explicit TraceBuffer(int thread_id)
+       : events_(std::make_unique<TraceEvent[]>(kCapacity)),
+         size_(0),
+         dropped_(0),
+         thread_id_(thread_id) {}
+
+   TraceBuffer(const TraceBuffer &other) = delete;
+
+   TraceBuffer &operator=(const TraceBuffer &other) = delete;
+
+   inline void push(const TraceEvent &event) {
+      uint32_t size = size_.load(std::memory_order_relaxed);
+      if (size == kCapacity) {
+         dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+         return;
+      }
+
+      events_[size] = event;
+      size_.store(size + 1, std::memory_order_release);
+   }
+
+   /// Events up to the returned count may be read
+   inline uint32_t size() const {
+      return size_.load(std::memory_order_acquire);
+   }
+
+   inline const TraceEvent &operator[](uint32_t index) const {
+      return events_[index];
+   }
+
+   inline uint32_t dropped() const {
+      return dropped_.load(std::memory_order_relaxed);
+   }
+
+   inline int thread_id() const {
+      return thread_id_;
+   }
+
+   void clear() {
+      size_.store(0, std::memory_order_relaxed);
+      dropped_.store(0, std::memory_order_relaxed);
+   }
+
+   std::string thread_name;
+
+private:
+   std::unique_ptr<TraceEvent[]> events_;
+   std::atomic<uint32_t> size_;
+   std::atomic<uint32_t> dropped_;
+   int thread_id_;
+};
+
+/// Process-wide CPU trace in the Chrome trace event format, which chrome://tracing and Perfetto
+/// open. Nothing is recorded until set_enabled(true), and the VKAD_TRACE_* macros compile to
+/// nothing unless VKAD_TRACING is defined.
+class Trace {
+public:
+   static inline int64_t now_ns() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch()
+      )
+          .count();
+   }
+
+   static inline bool enabled() {
+      return enabled_.load(std::memory_order_relaxed);
+   }
+
+   /// Timestamps are exported relative to the first time the trace is enabled
+   static void set_enabled(bool enabled) {
+      if (enabled && epoch_ns_.load(std::memory_order_relaxed) == 0) {
+         epoch_ns_.store(now_ns(), std::memory_order_relaxed);
+      }
+      enabled_.store(enabled, std::memory_order_relaxed);
+   }
+
+   /// Drops every recorded event. No thread may be recording meanwhile.
+   static void clear() {
+      std::lock_guard lock(mutex_);
+      for (const std::unique_ptr<TraceBuffer> &buffer : buffers_) {
+         buffer->clear();
+      }
+      frame_.store(0, std::memory_order_relaxed);
+      epoch_ns_.store(enabled() ? now_ns() : 0, std::memory_order_relaxed);
+   }
+
+   /// The calling thread's buffer, created the first time the thread records. Buffers outlive
+   /// their threads so that short-lived workers still show up in the export.
+   static inline TraceBuffer &thread_buffer() {
+      TraceBuffer *&buffer = thread_slot();
+      if (buffer == nullptr) {
+         buffer = register_thread();
+      }
+      return *buffer;
+   }
+
+   /// Shown instead of "thread N" in the trace viewer. Threads that never record don't get a
+   /// buffer for it.
+   static void set_thread_name(std::string name) {
+      std::lock_guard lock(mutex_);
+      if (thread_slot() != nullptr) {
+         thread_slot()->thread_name = std::move(name);
+      } else {
+         pending_thread_name() = std::move(name);
+      }
+   }
+
+   static inline void zone(const char *name, int64_t begin_ns, int64_t end_ns) {
+      thread_buffer().push({
+          .name = name,
+          .time_ns = begin_ns,
+          .value = end_ns - begin_ns,
+          .type = TraceEventType::ZONE,
+      });
+   }
+
+   static inline void counter(const char *name, int64_t value) {
+      if (enabled()) {
+         thread_buffer().push({
+             .name = name,
+             .time_ns = now_ns(),
+             .value = value,
+             .type = TraceEventType::COUNTER,
+         });
+      }
+   }
+
+   /// Marks the start of a frame on the timeline of every thread
+   static inline void frame() {
+      int64_t number = frame_.fetch_add(1, std::memory_order_relaxed);
+      if (enabled()) {
+         thread_buffer().push({
+             .name = "frame",
+             .time_ns = now_ns(),
+             .value = number,
+             .type = TraceEventType::FRAME,
+         });
+      }
+   }
+
+   /// Events that didn't fit in their thread's buffer
+   static uint32_t dropped() {
+      std::lock_guard lock(mutex_);
+      uint32_t dropped = 0;
+      for (const std::unique_ptr<TraceBuffer> &buffer : buffers_) {
+         dropped += buffer->dropped();
+      }
+      return dropped;
+   }
+
+   /// Every recorded event as a Chrome trace JSON object. Microsecond timestamps keep three
+   /// decimals, so the nanoseconds survive.
+   static std::string to_json() {
+      std::lock_guard lock(mutex_);
+      int64_t epoch = epoch_ns_.load(std::memory_order_relaxed);
+
+      std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+      bool first = true;
+      auto append = [&](const std::string &event) {
+         json += first ? "" : ",\n";
+         json += event;
+         first = false;
+      };
+
+      for (const std::unique_ptr<TraceBuffer> &buffer : buffers_) {
+         int tid = buffer->thread_id();
+         std::string thread_name = buffer->thread_name.empty()
+                                       ? std::format("thread {}", tid)
+                                       : buffer->thread_name;
+         append(std::format(
+             R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})", tid,
+             escape(thread_name)
+         ));
+
+         uint32_t size = buffer->size();
+         for (uint32_t i = 0; i < size; ++i) {
+            const TraceEvent &event = (*buffer)[i];
+            std::string name = escape(event.name);
+            std::string ts = microseconds(event.time_ns - epoch);
+
+            switch (event.type) {
+            case TraceEventType::ZONE:
+               append(std::format(
+                   R"({{"name":"{}","ph":"X","pid":1,"tid":{},"ts":{},"dur":{}}})", name, tid, ts,
+                   microseconds(event.value)
+               ));
+               break;
+
+            case TraceEventType::COUNTER:
+               append(std::format(
+                   R"({{"name":"{}","ph":"C","pid":1,"tid":{},"ts":{},"args":{{"value":{}}}}})",
+                   name, tid, ts, event.value
+               ));
+               break;
+
+            case TraceEventType::FRAME:
+               append(std::format(
+                   R"({{"name":"{}","ph":"i","s":"g","pid":1,"tid":{},"ts":{},)"
+                   R"("args":{{"frame":{}}}}})",
+                   name, tid, ts, event.value
+               ));
+               break;
+            }
+         }
+      }
+
+      json += "\n]}\n";
+      return json;
+   }
+
+private:
+   static inline TraceBuffer *&thread_slot() {
+      thread_local TraceBuffer *buffer = nullptr;
+      return buffer;
+   }
+
+   static std::string &pending_thread_name() {
+      thread_local std::string name;
+      return name;
+   }
+
+   static TraceBuffer *register_thread() {
+      std::lock_guard lock(mutex_);
+      buffers_.push_back(std::make_unique<TraceBuffer>(static_cast<int>(buffers_.size())));
+      buffers_.back()->thread_name = std::move(pending_thread_name());
+      return buffers_.back().get();
+   }
+
+   static std::string microseconds(int64_t ns) {
+      const char *sign = ns < 0 ? "-" : "";
+      ns = ns < 0 ? -ns : ns;
+      return std::format("{}{}.{:03}", sign, ns / 1000, ns % 1000);
+   }
+
+   static std::string escape(const std::string &text) {
+      std::string escaped;
+      for (char c : text) {
+         if (c == '"' || c == '\\') {
+            escaped.push_back('\\');
+         }
+         escaped.push_back(c);
+      }
+      return escaped;
+   }
+
+   static inline std::atomic<bool> enabled_ = false;
+   static inline std::atomic<int64_t> epoch_ns_ = 0;
+   static inline std::atomic<int64_t> frame_ = 0;
+   /// Guards the list of buffers, never taken while recording
+   static inline std::mutex mutex_;
+   static inline std::vector<std::unique_ptr<TraceBuffer>> buffers_;
+};
+
+/// Records the time from its construction to its destruction as a zone on the current thread
+class TraceZone {
+public:
+   explicit TraceZone(const char *name) : name_(name), begin_ns_(-1) {
+      if (Trace::enabled()) {
+         begin_ns_ = Trace::now_ns();
+      }
+   }
+
+   TraceZone(const TraceZone &other) = delete;
+
+   ~TraceZone() {
+      if (begin_ns_ != -1) {
+         Trace::zone(name_, begin_ns_, Trace::now_ns());
+      }
+   }
+
+   TraceZone &operator=(const TraceZone &other) = delete;
+
+private:
+   const char *name_;
+   int64_t begin_ns_;
+};
+
+} // namespace vkad
+
+#define VKAD_TRACE_CONCAT_IMPL(a, b) a##b
+#define VKAD_TRACE_CONCAT(a, b) VKAD_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef VKAD_TRACING
+/// Times the rest of the enclosing block. `name` must be a string literal.
+#define VKAD_TRACE_ZONE(name)                                                                      \
+   ::vkad::TraceZone VKAD_TRACE_CONCAT(vkad_trace_zone_, __LINE__)(name)
+#define VKAD_TRACE_COUNTER(name, value) ::vkad::Trace::counter(name, value)
+#define VKAD_TRACE_FRAME() ::vkad::Trace::frame()
+#define VKAD_TRACE_THREAD_NAME(name) ::vkad::Trace::set_thread_name(name)
+#else
+#define VKAD_TRACE_ZONE(name)
+#define VKAD_TRACE_COUNTER(name, value)
+#define VKAD_TRACE_FRAME()
+#define VKAD_TRACE_THREAD_NAME(name)
+#endif
+
+#endif // !VKAD_UTIL_TRACE_H_
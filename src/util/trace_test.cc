@@ -0,0 +1,52 @@
+#include "trace.h"
+
+#include "vendor/doctest.h"
+
+#include <string>
+#include <thread>
+
+using namespace vkad;
+
+TEST_CASE("Trace records nothing while disabled") {
+   Trace::set_enabled(false);
+   Trace::clear();
+
+   {
+      TraceZone zone("ignored");
+   }
+   Trace::counter("ignored", 1);
+   Trace::frame();
+
+   CHECK(Trace::to_json().find("ignored") == std::string::npos);
+}
+
+TEST_CASE("Trace exports zones, counters and frames as Chrome trace events") {
+   Trace::set_enabled(true);
+   Trace::clear();
+
+   Trace::frame();
+   {
+      TraceZone zone("outer");
+      Trace::zone("inner", 1000, 3500);
+   }
+   Trace::counter("draws", 42);
+
+   std::thread worker([] {
+      Trace::set_thread_name("worker \"0\"");
+      TraceZone zone("record");
+   });
+   worker.join();
+   Trace::set_enabled(false);
+
+   std::string json = Trace::to_json();
+   CHECK(json.starts_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+   CHECK(json.find(R"("name":"outer","ph":"X")") != std::string::npos);
+   CHECK(json.find(R"("dur":2.500)") != std::string::npos);
+   CHECK(json.find(R"("name":"draws","ph":"C")") != std::string::npos);
+   CHECK(json.find(R"("args":{"value":42})") != std::string::npos);
+   CHECK(json.find(R"("name":"frame","ph":"i","s":"g")") != std::string::npos);
+   CHECK(json.find(R"("args":{"frame":0})") != std::string::npos);
+   CHECK(json.find(R"("name":"record","ph":"X")") != std::string::npos);
+   CHECK(json.find(R"("args":{"name":"worker \"0\""})") != std::string::npos);
+   CHECK(Trace::dropped() == 0);
+}
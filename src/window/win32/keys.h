@@ -10,6 +10,7 @@
 #define VKAD_KEY_P 0x50
 #define VKAD_KEY_S 0x53
 #define VKAD_KEY_Q 0x51
+#define VKAD_KEY_R 0x52
 #define VKAD_KEY_W 0x57
 #define VKAD_KEY_ESC 0x1B
 
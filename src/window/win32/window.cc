@@ -87,8 +87,9 @@ LRESULT CALLBACK vkad::window_proc(HWND window, UINT msg, WPARAM w_param, LPARAM
 
       if (input.header.dwType == RIM_TYPEMOUSE) {
          Window *window_cls = get_window_class(window);
-         window_cls->delta_mouse_x_ = input.data.mouse.lLastX;
-         window_cls->delta_mouse_y_ = -input.data.mouse.lLastY; // Negate so positive is up
+         // Several movements may arrive between polls
+         window_cls->delta_mouse_x_ += input.data.mouse.lLastX;
+         window_cls->delta_mouse_y_ -= input.data.mouse.lLastY; // Negate so positive is up
          USHORT flags = input.data.mouse.usFlags;
       }
       return 0;
@@ -204,6 +205,29 @@ bool Window::poll() {
    return open_;
 }
 
+void Window::poll_mouse() {
+   MSG msg;
+   while (PeekMessage(&msg, window_, WM_INPUT, WM_INPUT, PM_REMOVE) != 0) {
+      DispatchMessage(&msg);
+   }
+}
+
+int Window::refresh_rate() const {
+   MONITORINFOEX monitor = {};
+   monitor.cbSize = sizeof(monitor);
+   if (GetMonitorInfo(MonitorFromWindow(window_, MONITOR_DEFAULTTONEAREST), &monitor) == 0) {
+      return 0;
+   }
+
+   DEVMODE mode = {};
+   mode.dmSize = sizeof(mode);
+   if (EnumDisplaySettings(monitor.szDevice, ENUM_CURRENT_SETTINGS, &mode) == 0) {
+      return 0;
+   }
+   // 0 and 1 stand for the hardware's default rate
+   return mode.dmDisplayFrequency > 1 ? static_cast<int>(mode.dmDisplayFrequency) : 0;
+}
+
 void Window::set_capture_mouse(bool capture) {
    cursor_captured_ = capture;
 
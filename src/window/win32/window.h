@@ -25,6 +25,10 @@ public:
 
    bool poll();
 
+   /// Handles the raw mouse input that arrived since the last poll() or poll_mouse(), adding it to
+   /// delta_mouse_x() and delta_mouse_y(). Other messages wait for the next poll().
+   void poll_mouse();
+
    void set_capture_mouse(bool capture);
 
    void request_close();
@@ -73,6 +77,9 @@ public:
       return std::string_view(typed_chars_, next_typed_letter_);
    }
 
+   /// Refresh rate in Hz of the monitor the window is mostly on, 0 if it's unknown
+   int refresh_rate() const;
+
 private:
    const Instance &vk_instance_;
    HWND window_;